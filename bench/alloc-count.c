@@ -0,0 +1,112 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* LD_PRELOAD shim that counts the daemon's heap traffic for bench-daemon.
+ * It forwards to glibc's own entry points, so it needs no dlsym (which
+ * allocates itself), and writes "allocations bytes frees" to the file
+ * named by GROUP_BENCH_ALLOC_OUT when the process exits. */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+extern void  __libc_free (void *ptr);
+
+static unsigned long long allocations;
+static unsigned long long bytes;
+static unsigned long long frees;
+
+static void Count (size_t size)
+{
+    __atomic_fetch_add (&allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc (size_t size)
+{
+    Count (size);
+    return __libc_malloc (size);
+}
+
+void *calloc (size_t nmemb, size_t size)
+{
+    Count (nmemb * size);
+    return __libc_calloc (nmemb, size);
+}
+
+/* Growing a buffer in place still costs a call, so every realloc counts */
+void *realloc (void *ptr, size_t size)
+{
+    Count (size);
+    return __libc_realloc (ptr, size);
+}
+
+int posix_memalign (void **memptr, size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if (alignment < sizeof (void *) || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    Count (size);
+    ptr = __libc_memalign (alignment, size);
+    if (ptr == NULL)
+        return ENOMEM;
+    *memptr = ptr;
+
+    return 0;
+}
+
+void *aligned_alloc (size_t alignment, size_t size)
+{
+    Count (size);
+    return __libc_memalign (alignment, size);
+}
+
+void free (void *ptr)
+{
+    if (ptr != NULL)
+        __atomic_fetch_add (&frees, 1, __ATOMIC_RELAXED);
+    __libc_free (ptr);
+}
+
+__attribute__((destructor))
+static void WriteCounts (void)
+{
+    const char *path = getenv ("GROUP_BENCH_ALLOC_OUT");
+    char line[96];
+    int fd, n;
+
+    if (path == NULL)
+        return;
+    fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return;
+    n = snprintf (line, sizeof (line), "%llu %llu %llu\n",
+                  __atomic_load_n (&allocations, __ATOMIC_RELAXED),
+                  __atomic_load_n (&bytes, __ATOMIC_RELAXED),
+                  __atomic_load_n (&frees, __ATOMIC_RELAXED));
+    if (write (fd, line, n) != n)
+    {
+        /* nowhere left to report it */
+    }
+    close (fd);
+}
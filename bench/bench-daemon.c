@@ -0,0 +1,721 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Runs group-admin-daemon against a generated fixture tree on a private
+ * bus and reports cold start, reload, per-method latency over the bus and
+ * over the daemon's peer socket, and the restart from the daemon's group
+ * cache as JSON. Peak RSS comes from the daemon's VmHWM; with
+ * --alloc-shim the daemon also runs with alloc-count.c preloaded and its
+ * heap calls are reported per run. */
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <glib/gstdio.h>
+#include "bench-util.h"
+#include "fixture.h"
+#include "snapshot-reader.h"
+
+typedef enum
+{
+    BENCH_LIST_CACHED_GROUPS,
+    BENCH_LIST_CACHED_GROUPS_IF_CHANGED,
+    BENCH_FIND_GROUP_BY_NAME,
+    BENCH_FIND_GROUP_BY_ID,
+    BENCH_GET_GROUP_IF_MODIFIED,
+    BENCH_GET_ALL_PROPERTIES,
+    BENCH_GET_STATISTICS,
+    BENCH_N_METHODS
+} BenchMethod;
+
+static const gchar *bench_method_names[BENCH_N_METHODS] =
+{
+    "ListCachedGroups",
+    "ListCachedGroupsIfChanged",
+    "FindGroupByName",
+    "FindGroupById",
+    "GetGroupIfModified",
+    "GetAll",
+    "GetStatistics",
+};
+
+typedef struct
+{
+    FixtureConfig    config;
+    GDBusConnection *clients[64];
+    guint            n_clients;
+    GDBusConnection *peers[64];
+    guint            n_peers;
+    gboolean         peer;
+    GRand           *rand;
+    guint64          generation;
+    BenchMethod      method;
+    GArray          *latencies;
+    guint            errors;
+    guint            outstanding;
+    gint64           deadline;
+    GMainLoop       *loop;
+} Bench;
+
+typedef struct
+{
+    Bench           *bench;
+    GDBusConnection *connection;
+    gint64           start;
+} BenchClient;
+
+static gchar *RandomGroupPath (Bench *bench)
+{
+    guint index = g_rand_int_range (bench->rand, 0, bench->config.n_groups);
+
+    return g_strdup_printf (BENCH_PATH "/Group%u", FIXTURE_FIRST_GID + index);
+}
+
+static void ClientIssue (BenchClient *client);
+
+static void ClientDone (GObject      *source,
+                        GAsyncResult *res,
+                        gpointer      data)
+{
+    BenchClient *client = data;
+    Bench       *bench = client->bench;
+    GVariant    *reply;
+    gint64       latency;
+
+    reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, NULL);
+    latency = bench_elapsed_since (client->start);
+    if (reply != NULL)
+    {
+        g_array_append_val (bench->latencies, latency);
+        g_variant_unref (reply);
+    }
+    else
+    {
+        bench->errors++;
+    }
+
+    if (g_get_monotonic_time () < bench->deadline)
+    {
+        ClientIssue (client);
+        return;
+    }
+    g_free (client);
+    if (--bench->outstanding == 0)
+    {
+        g_main_loop_quit (bench->loop);
+    }
+}
+
+static void ClientIssue (BenchClient *client)
+{
+    Bench            *bench = client->bench;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *name = NULL;
+    const gchar      *object_path = BENCH_PATH;
+    const gchar      *interface = BENCH_NAME;
+    GVariant         *parameters = NULL;
+
+    switch (bench->method)
+    {
+        case BENCH_LIST_CACHED_GROUPS:
+            break;
+        case BENCH_LIST_CACHED_GROUPS_IF_CHANGED:
+            parameters = g_variant_new ("(t)", bench->generation);
+            break;
+        case BENCH_FIND_GROUP_BY_NAME:
+            name = fixture_group_name (g_rand_int_range (bench->rand, 0, bench->config.n_groups));
+            parameters = g_variant_new ("(s)", name);
+            break;
+        case BENCH_FIND_GROUP_BY_ID:
+            parameters = g_variant_new ("(x)", (gint64) FIXTURE_FIRST_GID +
+                                        g_rand_int_range (bench->rand, 0, bench->config.n_groups));
+            break;
+        case BENCH_GET_GROUP_IF_MODIFIED:
+            path = RandomGroupPath (bench);
+            parameters = g_variant_new ("(ot)", path, (guint64) 0);
+            break;
+        case BENCH_GET_ALL_PROPERTIES:
+            path = RandomGroupPath (bench);
+            object_path = path;
+            interface = "org.freedesktop.DBus.Properties";
+            parameters = g_variant_new ("(s)", "org.group.admin.list");
+            break;
+        case BENCH_GET_STATISTICS:
+            interface = "org.group.admin.Stats";
+            break;
+        default:
+            g_assert_not_reached ();
+    }
+
+    client->start = g_get_monotonic_time ();
+    g_dbus_connection_call (client->connection,
+                            bench->peer ? NULL : BENCH_NAME,
+                            object_path,
+                            interface,
+                            bench_method_names[bench->method],
+                            parameters,
+                            NULL,
+                            G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                            -1,
+                            NULL,
+                            ClientDone,
+                            client);
+}
+
+static void RunMethod (Bench       *bench,
+                       BenchMethod  method,
+                       guint        concurrency,
+                       gdouble      duration,
+                       GString     *out)
+{
+    gint64 start, elapsed;
+    guint  i;
+
+    bench->method = method;
+    bench->latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+    bench->errors = 0;
+    bench->outstanding = concurrency;
+    start = g_get_monotonic_time ();
+    bench->deadline = start + (gint64) (duration * G_USEC_PER_SEC);
+    for (i = 0; i < concurrency; i++)
+    {
+        BenchClient *client = g_new0 (BenchClient, 1);
+
+        client->bench = bench;
+        client->connection = bench->peer ? bench->peers[i] : bench->clients[i];
+        ClientIssue (client);
+    }
+    g_main_loop_run (bench->loop);
+    elapsed = bench_elapsed_since (start);
+
+    bench_latency_sort (bench->latencies);
+    g_string_append_printf (out,
+                            "%s    {\"method\": \"%s\", \"clients\": %u, \"calls\": %u, "
+                            "\"errors\": %u, \"calls_per_sec\": %.1f, \"p50_usec\": %" G_GINT64_FORMAT
+                            ", \"p99_usec\": %" G_GINT64_FORMAT ", \"max_usec\": %" G_GINT64_FORMAT "}",
+                            out->str[out->len - 1] == '[' ? "\n" : ",\n",
+                            bench_method_names[method],
+                            concurrency,
+                            bench->latencies->len,
+                            bench->errors,
+                            bench->latencies->len * (gdouble) G_USEC_PER_SEC / elapsed,
+                            bench_percentile (bench->latencies, 0.50),
+                            bench_percentile (bench->latencies, 0.99),
+                            bench_percentile (bench->latencies, 1.0));
+    g_array_unref (bench->latencies);
+    bench->latencies = NULL;
+}
+
+static guint64 GetGeneration (GDBusConnection *connection)
+{
+    g_autoptr(GVariant) reply = NULL;
+    g_autoptr(GVariant) value = NULL;
+
+    reply = g_dbus_connection_call_sync (connection,
+                                         BENCH_NAME,
+                                         BENCH_PATH,
+                                         "org.freedesktop.DBus.Properties",
+                                         "Get",
+                                         g_variant_new ("(ss)", BENCH_NAME, "Generation"),
+                                         G_VARIANT_TYPE ("(v)"),
+                                         G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                         -1,
+                                         NULL,
+                                         NULL);
+    if (reply == NULL)
+    {
+        return 0;
+    }
+    g_variant_get (reply, "(v)", &value);
+    return g_variant_get_uint64 (value);
+}
+
+static void GroupAdded (GDBusConnection *connection,
+                        const gchar     *sender,
+                        const gchar     *path,
+                        const gchar     *interface,
+                        const gchar     *signal,
+                        GVariant        *parameters,
+                        gpointer         data)
+{
+    g_main_loop_quit (data);
+}
+
+static gboolean ReloadTimeout (gpointer data)
+{
+    g_main_loop_quit (data);
+    return G_SOURCE_REMOVE;
+}
+
+/* Time from a one-line append to /etc/group until GroupAdded, which
+ * includes the daemon's change debounce. */
+static gint64 MeasureReload (Bench *bench, const gchar *root, GError **error)
+{
+    g_autofree gchar *name = NULL;
+    gint64 start, elapsed;
+    guint  subscription, timeout;
+
+    subscription = g_dbus_connection_signal_subscribe (bench->clients[0],
+                                                       BENCH_NAME,
+                                                       BENCH_NAME,
+                                                       "GroupAdded",
+                                                       BENCH_PATH,
+                                                       NULL,
+                                                       G_DBUS_SIGNAL_FLAGS_NONE,
+                                                       GroupAdded,
+                                                       bench->loop,
+                                                       NULL);
+    name = fixture_group_name (bench->config.n_groups);
+    start = g_get_monotonic_time ();
+    if (!fixture_append_group (root, name, FIXTURE_FIRST_GID + bench->config.n_groups, error))
+    {
+        g_dbus_connection_signal_unsubscribe (bench->clients[0], subscription);
+        return -1;
+    }
+    timeout = g_timeout_add_seconds (BENCH_TIMEOUT / G_USEC_PER_SEC, ReloadTimeout, bench->loop);
+    g_main_loop_run (bench->loop);
+    elapsed = bench_elapsed_since (start);
+    g_dbus_connection_signal_unsubscribe (bench->clients[0], subscription);
+    if (elapsed >= BENCH_TIMEOUT)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "No GroupAdded after appending %s", name);
+        return -1;
+    }
+    g_source_remove (timeout);
+
+    return elapsed;
+}
+
+/* Name lookups against the OpenSnapshot mapping, the zero-IPC
+ * counterpart of FindGroupByName */
+static gboolean MeasureSnapshot (Bench *bench, gdouble duration, GString *out, GError **error)
+{
+    g_autoptr(GVariant) reply = NULL;
+    g_autoptr(GUnixFDList) fd_list = NULL;
+    g_autoptr(GPtrArray) names = NULL;
+    GsSnapshot map;
+    gint64 start, elapsed;
+    guint64 lookups = 0, misses = 0;
+    guint i;
+    gint32 index;
+    gint fd, ret;
+
+    reply = g_dbus_connection_call_with_unix_fd_list_sync (bench->clients[0],
+                                                           BENCH_NAME,
+                                                           BENCH_PATH,
+                                                           BENCH_NAME,
+                                                           "OpenSnapshot",
+                                                           NULL,
+                                                           G_VARIANT_TYPE ("(h)"),
+                                                           G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                           -1,
+                                                           NULL,
+                                                           &fd_list,
+                                                           NULL,
+                                                           error);
+    if (reply == NULL)
+    {
+        return FALSE;
+    }
+    g_variant_get (reply, "(h)", &index);
+    fd = g_unix_fd_list_get (fd_list, index, error);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+    ret = gs_snapshot_map (fd, &map);
+    close (fd);
+    if (ret < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (-ret),
+                     "Unable to map snapshot: %s", g_strerror (-ret));
+        return FALSE;
+    }
+
+    /* Names are drawn up front so formatting them stays out of the loop */
+    names = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; i < 4096; i++)
+    {
+        g_ptr_array_add (names, fixture_group_name (g_rand_int_range (bench->rand, 0, bench->config.n_groups)));
+    }
+    start = g_get_monotonic_time ();
+    do
+    {
+        for (i = 0; i < names->len; i++)
+        {
+            if (gs_snapshot_find_name (&map, g_ptr_array_index (names, i)) == NULL)
+            {
+                misses++;
+            }
+        }
+        lookups += names->len;
+        elapsed = bench_elapsed_since (start);
+    }
+    while (elapsed < duration * G_USEC_PER_SEC);
+
+    g_string_append_printf (out,
+                            "  \"snapshot\": {\"bytes\": %" G_GSIZE_FORMAT ", \"groups\": %u, "
+                            "\"lookups_per_sec\": %.1f, \"misses\": %" G_GUINT64_FORMAT "},\n",
+                            map.size,
+                            map.header->n_groups,
+                            lookups * (gdouble) G_USEC_PER_SEC / elapsed,
+                            misses);
+    gs_snapshot_unmap (&map);
+
+    return TRUE;
+}
+
+/* Whether the running daemon loaded its groups from the cache */
+static gboolean GetWarmStart (GDBusConnection *connection)
+{
+    g_autoptr(GVariant) reply = NULL;
+    g_autoptr(GVariant) stats = NULL;
+    gboolean warm = FALSE;
+
+    reply = g_dbus_connection_call_sync (connection,
+                                         BENCH_NAME,
+                                         BENCH_PATH,
+                                         "org.group.admin.Stats",
+                                         "GetStatistics",
+                                         NULL,
+                                         G_VARIANT_TYPE ("(a{sv})"),
+                                         G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                         -1,
+                                         NULL,
+                                         NULL);
+    if (reply == NULL)
+    {
+        return FALSE;
+    }
+    stats = g_variant_get_child_value (reply, 0);
+    g_variant_lookup (stats, "warm-start", "b", &warm);
+
+    return warm;
+}
+
+/* The "allocations bytes frees" line the shim leaves behind on exit */
+static void AppendAllocations (GString *out, const gchar *key, const gchar *path)
+{
+    g_autofree gchar *contents = NULL;
+    g_auto(GStrv) fields = NULL;
+
+    g_string_append_printf (out, "  \"%s\": ", key);
+    if (!g_file_get_contents (path, &contents, NULL, NULL) ||
+        g_strv_length (fields = g_strsplit (g_strstrip (contents), " ", 3)) != 3)
+    {
+        g_string_append (out, "null");
+        return;
+    }
+    g_string_append_printf (out, "{\"calls\": %s, \"bytes\": %s, \"frees\": %s}",
+                            fields[0], fields[1], fields[2]);
+}
+
+static gboolean ParseClients (const gchar *spec, GArray *levels, GError **error)
+{
+    g_auto(GStrv) fields = g_strsplit (spec, ",", -1);
+    guint i;
+
+    for (i = 0; fields[i] != NULL; i++)
+    {
+        guint64 value;
+
+        if (!g_ascii_string_to_unsigned (fields[i], 10, 1, 64, &value, error))
+        {
+            return FALSE;
+        }
+        g_array_append_val (levels, value);
+    }
+
+    return levels->len > 0;
+}
+
+int main (int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GTestDBus) bus = NULL;
+    g_autoptr(GString) out = NULL;
+    g_autoptr(GArray) levels = NULL;
+    g_autofree gchar *root = NULL;
+    g_autofree gchar *cache = NULL;
+    g_autofree gchar *snapshot = NULL;
+    g_autofree gchar *peer = NULL;
+    g_autofree gchar *peer_address = NULL;
+    g_autofree gchar *cold_allocs = NULL;
+    g_autofree gchar *warm_allocs = NULL;
+    g_auto(GStrv) envp = NULL;
+    gchar   *daemon_path = NULL;
+    gchar   *output = NULL;
+    gchar   *clients = NULL;
+    gchar   *alloc_shim = NULL;
+    gdouble  duration = 1.0;
+    gint     groups, users, members;
+    gchar   *daemon_argv[10];
+    const gchar *address;
+    GPid     pid = 0;
+    Bench    bench = { 0 };
+    gint64   start, cold_start, reload, warm_start;
+    guint    i, j;
+    int      ret = EXIT_FAILURE;
+
+    fixture_config_init (&bench.config);
+    groups  = bench.config.n_groups;
+    users   = bench.config.n_users;
+    members = bench.config.n_members;
+    {
+        GOptionEntry entries[] =
+        {
+            { "daemon",   'd', 0, G_OPTION_ARG_FILENAME, &daemon_path,        "group-admin-daemon to run", "PATH" },
+            { "groups",   'g', 0, G_OPTION_ARG_INT,      &groups,             "Number of groups", "N" },
+            { "users",    'u', 0, G_OPTION_ARG_INT,      &users,              "Number of users", "N" },
+            { "members",  'm', 0, G_OPTION_ARG_INT,      &members,            "Members per group", "N" },
+            { "skew",     's', 0, G_OPTION_ARG_DOUBLE,   &bench.config.skew,  "Zipf exponent of membership", "S" },
+            { "clients",  'c', 0, G_OPTION_ARG_STRING,   &clients,            "Concurrent clients per run, default 1,8,64", "LIST" },
+            { "duration", 't', 0, G_OPTION_ARG_DOUBLE,   &duration,           "Seconds per method and client count", "SEC" },
+            { "output",   'o', 0, G_OPTION_ARG_FILENAME, &output,             "Write JSON here instead of stdout", "FILE" },
+            { "alloc-shim", 0, 0, G_OPTION_ARG_FILENAME, &alloc_shim,        "Preload this malloc counter into the daemon", "PATH" },
+            { NULL }
+        };
+
+        context = g_option_context_new ("- benchmark group-admin-daemon");
+        g_option_context_add_main_entries (context, entries, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            return EXIT_FAILURE;
+        }
+    }
+    if (daemon_path == NULL || groups <= 0 || users < 0 || members < 0)
+    {
+        g_printerr ("--daemon and a positive --groups are required\n");
+        return EXIT_FAILURE;
+    }
+    bench.config.n_groups  = groups;
+    bench.config.n_users   = users;
+    bench.config.n_members = members;
+
+    levels = g_array_new (FALSE, FALSE, sizeof (guint64));
+    if (!ParseClients (clients ? clients : "1,8,64", levels, &error))
+    {
+        g_printerr ("Invalid --clients: %s\n", error ? error->message : "empty");
+        return EXIT_FAILURE;
+    }
+
+    root = g_dir_make_tmp ("group-bench-XXXXXX", &error);
+    if (root == NULL || !fixture_write (&bench.config, root, &error))
+    {
+        g_printerr ("Unable to write fixture: %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    /* The daemon talks to "the system bus", so point that at our own */
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+    address = g_test_dbus_get_bus_address (bus);
+    envp = g_get_environ ();
+    envp = g_environ_setenv (envp, "DBUS_SYSTEM_BUS_ADDRESS", address, TRUE);
+    if (alloc_shim != NULL)
+    {
+        cold_allocs = g_build_filename (root, "allocs-cold", NULL);
+        warm_allocs = g_build_filename (root, "allocs-warm", NULL);
+        envp = g_environ_setenv (envp, "LD_PRELOAD", alloc_shim, TRUE);
+        envp = g_environ_setenv (envp, "GROUP_BENCH_ALLOC_OUT", cold_allocs, TRUE);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (bench.clients); i++)
+    {
+        bench.clients[i] = g_dbus_connection_new_for_address_sync (address,
+                                                                  G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                                  G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                                  NULL, NULL, &error);
+        if (bench.clients[i] == NULL)
+        {
+            g_printerr ("Unable to connect to the private bus: %s\n", error->message);
+            goto out;
+        }
+        bench.n_clients++;
+    }
+
+    daemon_argv[0] = daemon_path;
+    daemon_argv[1] = (gchar *) "--root";
+    daemon_argv[2] = root;
+    daemon_argv[3] = (gchar *) "--cache";
+    daemon_argv[4] = cache = g_build_filename (root, "groups.cache", NULL);
+    daemon_argv[5] = (gchar *) "--snapshot-path";
+    daemon_argv[6] = snapshot = g_build_filename (root, "snapshot", NULL);
+    daemon_argv[7] = (gchar *) "--peer-socket";
+    daemon_argv[8] = peer = g_build_filename (root, "peer", NULL);
+    daemon_argv[9] = NULL;
+    start = g_get_monotonic_time ();
+    if (!g_spawn_async (NULL, daemon_argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error))
+    {
+        g_printerr ("Unable to start %s: %s\n", daemon_path, error->message);
+        goto out;
+    }
+
+    cold_start = bench_wait_for_daemon (bench.clients[0], start, &error);
+    if (cold_start < 0)
+    {
+        g_printerr ("Daemon did not come up: %s\n", error ? error->message : "timeout");
+        goto stop;
+    }
+
+    bench.loop = g_main_loop_new (NULL, FALSE);
+    bench.rand = g_rand_new_with_seed (bench.config.seed);
+    reload = MeasureReload (&bench, root, &error);
+    if (reload < 0)
+    {
+        g_printerr ("Reload failed: %s\n", error->message);
+        goto stop;
+    }
+    bench.generation = GetGeneration (bench.clients[0]);
+
+    out = g_string_new ("{\n");
+    g_string_append_printf (out,
+                            "  \"fixture\": {\"groups\": %u, \"users\": %u, \"members\": %u, \"skew\": %.2f},\n",
+                            bench.config.n_groups, bench.config.n_users,
+                            bench.config.n_members, bench.config.skew);
+    g_string_append_printf (out, "  \"cold_start_usec\": %" G_GINT64_FORMAT ",\n", cold_start);
+    g_string_append_printf (out, "  \"reload_usec\": %" G_GINT64_FORMAT ",\n", reload);
+    g_string_append_printf (out, "  \"startup_peak_rss_bytes\": %" G_GUINT64_FORMAT ",\n",
+                            bench_get_peak_rss (pid));
+    g_string_append (out, "  \"methods\": [");
+    for (i = 0; i < BENCH_N_METHODS; i++)
+    {
+        for (j = 0; j < levels->len; j++)
+        {
+            RunMethod (&bench, i, g_array_index (levels, guint64, j), duration, out);
+        }
+    }
+    g_string_append (out, "\n  ],\n");
+
+    /* The same lookups without the bus daemon in between */
+    peer_address = g_strdup_printf ("unix:path=%s", peer);
+    for (i = 0; i < G_N_ELEMENTS (bench.peers); i++)
+    {
+        bench.peers[i] = g_dbus_connection_new_for_address_sync (peer_address,
+                                                                G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                                NULL, NULL, &error);
+        if (bench.peers[i] == NULL)
+        {
+            g_printerr ("Unable to connect to the peer socket: %s\n", error->message);
+            goto stop;
+        }
+        bench.n_peers++;
+    }
+    bench.peer = TRUE;
+    g_string_append (out, "  \"peer_methods\": [");
+    for (i = BENCH_FIND_GROUP_BY_NAME; i <= BENCH_GET_ALL_PROPERTIES; i++)
+    {
+        for (j = 0; j < levels->len; j++)
+        {
+            RunMethod (&bench, i, g_array_index (levels, guint64, j), duration, out);
+        }
+    }
+    g_string_append (out, "\n  ],\n");
+    bench.peer = FALSE;
+
+    if (!MeasureSnapshot (&bench, duration, out, &error))
+    {
+        g_printerr ("Snapshot lookups failed: %s\n", error->message);
+        goto stop;
+    }
+
+    g_string_append_printf (out, "  \"peak_rss_bytes\": %" G_GUINT64_FORMAT ",\n",
+                            bench_get_peak_rss (pid));
+
+    /* A clean exit writes the cache, the next start should come from it */
+    bench_stop (pid);
+    pid = 0;
+    if (alloc_shim != NULL)
+    {
+        AppendAllocations (out, "allocations", cold_allocs);
+        g_string_append (out, ",\n");
+        envp = g_environ_setenv (envp, "GROUP_BENCH_ALLOC_OUT", warm_allocs, TRUE);
+    }
+    start = g_get_monotonic_time ();
+    if (!g_spawn_async (NULL, daemon_argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error))
+    {
+        g_printerr ("Unable to restart %s: %s\n", daemon_path, error->message);
+        goto out;
+    }
+    warm_start = bench_wait_for_daemon (bench.clients[0], start, &error);
+    if (warm_start < 0)
+    {
+        g_printerr ("Daemon did not come back: %s\n", error ? error->message : "timeout");
+        goto stop;
+    }
+    g_string_append_printf (out, "  \"warm_start_usec\": %" G_GINT64_FORMAT ",\n", warm_start);
+    g_string_append_printf (out, "  \"warm_start_peak_rss_bytes\": %" G_GUINT64_FORMAT ",\n",
+                            bench_get_peak_rss (pid));
+    g_string_append_printf (out, "  \"warm_start_cached\": %s",
+                            GetWarmStart (bench.clients[0]) ? "true" : "false");
+    if (alloc_shim != NULL)
+    {
+        /* The counts are written as the daemon exits */
+        bench_stop (pid);
+        pid = 0;
+        g_string_append (out, ",\n");
+        AppendAllocations (out, "warm_start_allocations", warm_allocs);
+    }
+    g_string_append (out, "\n}\n");
+
+    if (output != NULL)
+    {
+        if (!g_file_set_contents (output, out->str, out->len, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            goto stop;
+        }
+    }
+    else
+    {
+        fputs (out->str, stdout);
+    }
+    ret = EXIT_SUCCESS;
+
+stop:
+    if (pid > 0)
+    {
+        bench_stop (pid);
+    }
+out:
+    for (i = 0; i < bench.n_clients; i++)
+    {
+        g_object_unref (bench.clients[i]);
+    }
+    for (i = 0; i < bench.n_peers; i++)
+    {
+        g_object_unref (bench.peers[i]);
+    }
+    if (bench.rand != NULL)
+    {
+        g_rand_free (bench.rand);
+    }
+    if (bench.loop != NULL)
+    {
+        g_main_loop_unref (bench.loop);
+    }
+    g_test_dbus_down (bus);
+    if (alloc_shim != NULL)
+    {
+        g_unlink (cold_allocs);
+        g_unlink (warm_allocs);
+    }
+    bench_remove_tree (root);
+
+    return ret;
+}
@@ -0,0 +1,379 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Drives CreateGroup, AddUserToGroup and DeleteGroup with many calls in
+ * flight against a daemon that authorizes through mock-polkit and edits
+ * the fixture tree through the fake helpers. */
+#include <stdlib.h>
+#include <stdio.h>
+#include <gio/gio.h>
+#include "bench-util.h"
+#include "fixture.h"
+
+#define BENCH_MEMBER "root"   /* AddUserToGroup checks getpwnam () */
+
+typedef enum
+{
+    OP_CREATE_GROUP,
+    OP_ADD_USER_TO_GROUP,
+    OP_DELETE_GROUP,
+    OP_N
+} Op;
+
+static const gchar *op_names[OP_N] =
+{
+    "CreateGroup",
+    "AddUserToGroup",
+    "DeleteGroup",
+};
+
+typedef struct
+{
+    FixtureConfig    config;
+    GDBusConnection *connections[64];
+    guint            n_connections;
+    GMainLoop       *loop;
+    Op               op;
+    guint            n_operations;
+    guint            next;
+    guint            outstanding;
+    GArray          *latencies;
+    guint            errors;
+    gchar          **paths;
+} Bench;
+
+typedef struct
+{
+    Bench  *bench;
+    guint   index;
+    gint64  start;
+} Call;
+
+static gchar *TargetPath (Bench *bench, guint index)
+{
+    if (bench->paths[index] != NULL)
+    {
+        return g_strdup (bench->paths[index]);
+    }
+    /* Creation was refused, aim at an existing fixture group instead */
+    return g_strdup_printf (BENCH_PATH "/Group%u",
+                            FIXTURE_FIRST_GID + index % bench->config.n_groups);
+}
+
+static void Issue (Bench *bench);
+
+static void CallDone (GObject      *source,
+                      GAsyncResult *res,
+                      gpointer      data)
+{
+    Call     *call = data;
+    Bench    *bench = call->bench;
+    GVariant *reply;
+    gint64    latency;
+
+    reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, NULL);
+    latency = bench_elapsed_since (call->start);
+    if (reply != NULL)
+    {
+        g_array_append_val (bench->latencies, latency);
+        if (bench->op == OP_CREATE_GROUP)
+        {
+            g_variant_get (reply, "(o)", &bench->paths[call->index]);
+        }
+        g_variant_unref (reply);
+    }
+    else
+    {
+        bench->errors++;
+    }
+    g_free (call);
+
+    bench->outstanding--;
+    if (bench->next < bench->n_operations)
+    {
+        Issue (bench);
+    }
+    else if (bench->outstanding == 0)
+    {
+        g_main_loop_quit (bench->loop);
+    }
+}
+
+static void Issue (Bench *bench)
+{
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *name = NULL;
+    const gchar *object_path = BENCH_PATH;
+    const gchar *interface = BENCH_NAME;
+    GVariant    *parameters = NULL;
+    Call        *call;
+    gint64       gid = 0;
+
+    call = g_new0 (Call, 1);
+    call->bench = bench;
+    call->index = bench->next++;
+    switch (bench->op)
+    {
+        case OP_CREATE_GROUP:
+            name = g_strdup_printf ("load%06u", call->index);
+            parameters = g_variant_new ("(s)", name);
+            break;
+        case OP_ADD_USER_TO_GROUP:
+            path = TargetPath (bench, call->index);
+            object_path = path;
+            interface = "org.group.admin.list";
+            parameters = g_variant_new ("(s)", BENCH_MEMBER);
+            break;
+        case OP_DELETE_GROUP:
+            path = TargetPath (bench, call->index);
+            sscanf (path, BENCH_PATH "/Group%" G_GINT64_FORMAT, &gid);
+            parameters = g_variant_new ("(x)", gid);
+            break;
+        default:
+            g_assert_not_reached ();
+    }
+
+    bench->outstanding++;
+    call->start = g_get_monotonic_time ();
+    g_dbus_connection_call (bench->connections[call->index % bench->n_connections],
+                            BENCH_NAME,
+                            object_path,
+                            interface,
+                            op_names[bench->op],
+                            parameters,
+                            NULL,
+                            G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                            G_MAXINT,
+                            NULL,
+                            CallDone,
+                            call);
+}
+
+static void RunOp (Bench *bench, Op op, guint concurrency, GString *out)
+{
+    gint64 start, elapsed;
+    guint  i;
+
+    bench->op = op;
+    bench->next = 0;
+    bench->errors = 0;
+    bench->latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+    start = g_get_monotonic_time ();
+    for (i = 0; i < concurrency && bench->next < bench->n_operations; i++)
+    {
+        Issue (bench);
+    }
+    g_main_loop_run (bench->loop);
+    elapsed = bench_elapsed_since (start);
+
+    bench_latency_sort (bench->latencies);
+    g_string_append_printf (out,
+                            "%s    {\"method\": \"%s\", \"in_flight\": %u, \"calls\": %u, "
+                            "\"errors\": %u, \"calls_per_sec\": %.1f, \"p50_usec\": %" G_GINT64_FORMAT
+                            ", \"p99_usec\": %" G_GINT64_FORMAT ", \"p999_usec\": %" G_GINT64_FORMAT
+                            ", \"max_usec\": %" G_GINT64_FORMAT "}",
+                            op == 0 ? "\n" : ",\n",
+                            op_names[op],
+                            concurrency,
+                            bench->latencies->len,
+                            bench->errors,
+                            bench->n_operations * (gdouble) G_USEC_PER_SEC / elapsed,
+                            bench_percentile (bench->latencies, 0.50),
+                            bench_percentile (bench->latencies, 0.99),
+                            bench_percentile (bench->latencies, 0.999),
+                            bench_percentile (bench->latencies, 1.0));
+    g_array_unref (bench->latencies);
+    bench->latencies = NULL;
+}
+
+int main (int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GTestDBus) bus = NULL;
+    g_autoptr(GString) out = NULL;
+    g_autofree gchar *root = NULL;
+    g_autofree gchar *cache = NULL;
+    g_autofree gchar *snapshot = NULL;
+    g_auto(GStrv) envp = NULL;
+    gchar   *daemon_path = NULL;
+    gchar   *polkit_path = NULL;
+    gchar   *helper_dir = NULL;
+    gchar   *answer = NULL;
+    gchar   *output = NULL;
+    gchar   *latency = NULL;
+    gint     groups, operations = 1000, concurrency = 1000;
+    gchar   *polkit_argv[6];
+    gchar   *daemon_argv[10];
+    const gchar *address;
+    GPid     polkit_pid = 0, daemon_pid = 0;
+    Bench    bench = { 0 };
+    gint64   start;
+    guint    i;
+    int      ret = EXIT_FAILURE;
+
+    fixture_config_init (&bench.config);
+    bench.config.n_groups = 1000;
+    groups = bench.config.n_groups;
+    {
+        GOptionEntry entries[] =
+        {
+            { "daemon",      'd', 0, G_OPTION_ARG_FILENAME, &daemon_path, "group-admin-daemon to run", "PATH" },
+            { "mock-polkit", 'p', 0, G_OPTION_ARG_FILENAME, &polkit_path, "mock-polkit to run", "PATH" },
+            { "helper-dir",  'H', 0, G_OPTION_ARG_FILENAME, &helper_dir,  "Directory with the fake group helpers", "DIR" },
+            { "answer",      'a', 0, G_OPTION_ARG_STRING,   &answer,      "Authority answer: allow, deny or challenge", "ANSWER" },
+            { "latency",     'l', 0, G_OPTION_ARG_STRING,   &latency,     "Authority latency", "MS" },
+            { "groups",      'g', 0, G_OPTION_ARG_INT,      &groups,      "Number of fixture groups", "N" },
+            { "operations",  'n', 0, G_OPTION_ARG_INT,      &operations,  "Calls per method", "N" },
+            { "in-flight",   'c', 0, G_OPTION_ARG_INT,      &concurrency, "Calls kept in flight", "N" },
+            { "output",      'o', 0, G_OPTION_ARG_FILENAME, &output,      "Write JSON here instead of stdout", "FILE" },
+            { NULL }
+        };
+
+        context = g_option_context_new ("- load test group-admin-daemon mutations");
+        g_option_context_add_main_entries (context, entries, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            return EXIT_FAILURE;
+        }
+    }
+    if (daemon_path == NULL || polkit_path == NULL || helper_dir == NULL ||
+        groups <= 0 || operations <= 0 || concurrency <= 0)
+    {
+        g_printerr ("--daemon, --mock-polkit and --helper-dir are required\n");
+        return EXIT_FAILURE;
+    }
+    bench.config.n_groups = groups;
+    bench.n_operations = operations;
+
+    root = g_dir_make_tmp ("group-bench-XXXXXX", &error);
+    if (root == NULL || !fixture_write (&bench.config, root, &error))
+    {
+        g_printerr ("Unable to write fixture: %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+    address = g_test_dbus_get_bus_address (bus);
+    envp = g_get_environ ();
+    envp = g_environ_setenv (envp, "DBUS_SYSTEM_BUS_ADDRESS", address, TRUE);
+    envp = g_environ_setenv (envp, "GROUP_BENCH_ROOT", root, TRUE);
+
+    for (i = 0; i < G_N_ELEMENTS (bench.connections); i++)
+    {
+        bench.connections[i] = g_dbus_connection_new_for_address_sync (address,
+                                                                      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                                      G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                                      NULL, NULL, &error);
+        if (bench.connections[i] == NULL)
+        {
+            g_printerr ("Unable to connect to the private bus: %s\n", error->message);
+            goto out;
+        }
+        bench.n_connections++;
+    }
+
+    polkit_argv[0] = polkit_path;
+    polkit_argv[1] = (gchar *) "--answer";
+    polkit_argv[2] = answer ? answer : (gchar *) "allow";
+    polkit_argv[3] = (gchar *) "--latency";
+    polkit_argv[4] = latency ? latency : (gchar *) "0";
+    polkit_argv[5] = NULL;
+    start = g_get_monotonic_time ();
+    if (!g_spawn_async (NULL, polkit_argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &polkit_pid, &error) ||
+        !bench_wait_for_name (bench.connections[0], "org.freedesktop.PolicyKit1", start, &error))
+    {
+        g_printerr ("Unable to start %s: %s\n", polkit_path, error->message);
+        goto stop;
+    }
+
+    daemon_argv[0] = daemon_path;
+    daemon_argv[1] = (gchar *) "--root";
+    daemon_argv[2] = root;
+    daemon_argv[3] = (gchar *) "--helper-dir";
+    daemon_argv[4] = helper_dir;
+    daemon_argv[5] = (gchar *) "--cache";
+    daemon_argv[6] = cache = g_build_filename (root, "groups.cache", NULL);
+    daemon_argv[7] = (gchar *) "--snapshot-path";
+    daemon_argv[8] = snapshot = g_build_filename (root, "snapshot", NULL);
+    daemon_argv[9] = NULL;
+    start = g_get_monotonic_time ();
+    if (!g_spawn_async (NULL, daemon_argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &daemon_pid, &error) ||
+        bench_wait_for_daemon (bench.connections[0], start, &error) < 0)
+    {
+        g_printerr ("Unable to start %s: %s\n", daemon_path, error ? error->message : "timeout");
+        goto stop;
+    }
+
+    bench.loop = g_main_loop_new (NULL, FALSE);
+    bench.paths = g_new0 (gchar *, bench.n_operations);
+    out = g_string_new ("{\n");
+    g_string_append_printf (out,
+                            "  \"fixture\": {\"groups\": %u, \"users\": %u, \"members\": %u, \"skew\": %.2f},\n",
+                            bench.config.n_groups, bench.config.n_users,
+                            bench.config.n_members, bench.config.skew);
+    g_string_append_printf (out, "  \"authority\": {\"answer\": \"%s\", \"latency_ms\": %s},\n",
+                            answer ? answer : "allow", latency ? latency : "0");
+    g_string_append (out, "  \"methods\": [");
+    for (i = 0; i < OP_N; i++)
+    {
+        RunOp (&bench, i, concurrency, out);
+    }
+    g_string_append (out, "\n  ]\n}\n");
+
+    if (output != NULL)
+    {
+        if (!g_file_set_contents (output, out->str, out->len, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            goto stop;
+        }
+    }
+    else
+    {
+        fputs (out->str, stdout);
+    }
+    ret = EXIT_SUCCESS;
+
+stop:
+    if (daemon_pid != 0)
+    {
+        bench_stop (daemon_pid);
+    }
+    if (polkit_pid != 0)
+    {
+        bench_stop (polkit_pid);
+    }
+out:
+    for (i = 0; i < bench.n_connections; i++)
+    {
+        g_object_unref (bench.connections[i]);
+    }
+    for (i = 0; bench.paths != NULL && i < bench.n_operations; i++)
+    {
+        g_free (bench.paths[i]);
+    }
+    g_free (bench.paths);
+    if (bench.loop != NULL)
+    {
+        g_main_loop_unref (bench.loop);
+    }
+    g_test_dbus_down (bus);
+    bench_remove_tree (root);
+
+    return ret;
+}
@@ -0,0 +1,391 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Compares `id -G`-style lookups through libnss_groupservice, answering
+ * from the table the daemon publishes, with the linear scan nss_files
+ * does. nss_files always reads /etc/group, so the baseline is the same
+ * fgetgrent pass over the fixture's group file. Both answers are checked
+ * against each other. */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <grp.h>
+#include <nss.h>
+#include <gio/gio.h>
+#include "bench-util.h"
+#include "fixture.h"
+
+typedef enum nss_status (*GetgrnamFunc)    (const char *, struct group *, char *, size_t, int *);
+typedef enum nss_status (*InitgroupsFunc)  (const char *, gid_t, long int *, long int *,
+                                            gid_t **, long int, int *);
+
+typedef struct
+{
+    GetgrnamFunc   getgrnam_r;
+    InitgroupsFunc initgroups_dyn;
+    gchar         *group_path;
+    gchar          buffer[64 * 1024];
+} BenchNss;
+
+/* Supplementary gids of user, as nss_files' initgroups finds them */
+static GArray *FilesInitgroups (BenchNss *bench, const gchar *user)
+{
+    GArray *gids = g_array_new (FALSE, FALSE, sizeof (gid_t));
+    struct group *grent;
+    FILE *fp;
+
+    fp = fopen (bench->group_path, "r");
+    if (fp == NULL)
+    {
+        return gids;
+    }
+    while ((grent = fgetgrent (fp)) != NULL)
+    {
+        gchar **member;
+
+        for (member = grent->gr_mem; *member != NULL; member++)
+        {
+            if (strcmp (*member, user) == 0)
+            {
+                g_array_append_val (gids, grent->gr_gid);
+                break;
+            }
+        }
+    }
+    fclose (fp);
+
+    return gids;
+}
+
+static gboolean FilesGetgrnam (BenchNss *bench, const gchar *name, gid_t *gid)
+{
+    struct group *grent;
+    gboolean found = FALSE;
+    FILE *fp;
+
+    fp = fopen (bench->group_path, "r");
+    if (fp == NULL)
+    {
+        return FALSE;
+    }
+    while ((grent = fgetgrent (fp)) != NULL)
+    {
+        if (strcmp (grent->gr_name, name) == 0)
+        {
+            *gid = grent->gr_gid;
+            found = TRUE;
+            break;
+        }
+    }
+    fclose (fp);
+
+    return found;
+}
+
+static GArray *ModuleInitgroups (BenchNss *bench, const gchar *user)
+{
+    long int start = 0, size = 16;
+    /* realloc()ed by the module, so this has to be the libc allocator */
+    gid_t *groups = malloc (size * sizeof (gid_t));
+    GArray *gids;
+    int err = 0;
+
+    bench->initgroups_dyn (user, FIXTURE_USERS_GID, &start, &size, &groups, 0, &err);
+    gids = g_array_sized_new (FALSE, FALSE, sizeof (gid_t), start);
+    g_array_append_vals (gids, groups, start);
+    free (groups);
+
+    return gids;
+}
+
+static gboolean ModuleGetgrnam (BenchNss *bench, const gchar *name, gid_t *gid)
+{
+    struct group result;
+    int err = 0;
+
+    if (bench->getgrnam_r (name, &result, bench->buffer, sizeof (bench->buffer), &err) != NSS_STATUS_SUCCESS)
+    {
+        return FALSE;
+    }
+    *gid = result.gr_gid;
+
+    return TRUE;
+}
+
+static gint CompareGid (gconstpointer a, gconstpointer b)
+{
+    gid_t ga = *(const gid_t *) a;
+    gid_t gb = *(const gid_t *) b;
+
+    return ga < gb ? -1 : ga > gb;
+}
+
+static gboolean SameGids (GArray *a, GArray *b)
+{
+    g_array_sort (a, CompareGid);
+    g_array_sort (b, CompareGid);
+
+    return a->len == b->len &&
+           memcmp (a->data, b->data, a->len * sizeof (gid_t)) == 0;
+}
+
+static void AppendLatencies (GString *out, const gchar *name, GArray *latencies, gboolean last)
+{
+    bench_latency_sort (latencies);
+    g_string_append_printf (out,
+                            "    \"%s\": {\"p50_usec\": %" G_GINT64_FORMAT ", \"p99_usec\": %" G_GINT64_FORMAT
+                            ", \"max_usec\": %" G_GINT64_FORMAT "}%s\n",
+                            name,
+                            bench_percentile (latencies, 0.50),
+                            bench_percentile (latencies, 0.99),
+                            bench_percentile (latencies, 1.0),
+                            last ? "" : ",");
+}
+
+static gboolean WaitForFile (const gchar *path)
+{
+    gint64 start = g_get_monotonic_time ();
+
+    while (!g_file_test (path, G_FILE_TEST_EXISTS))
+    {
+        if (bench_elapsed_since (start) > BENCH_TIMEOUT)
+        {
+            return FALSE;
+        }
+        g_usleep (1000);
+    }
+
+    return TRUE;
+}
+
+int main (int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GTestDBus) bus = NULL;
+    g_autoptr(GDBusConnection) connection = NULL;
+    g_autoptr(GString) out = NULL;
+    g_autofree gchar *root = NULL;
+    g_autofree gchar *cache = NULL;
+    g_autofree gchar *snapshot = NULL;
+    g_auto(GStrv) envp = NULL;
+    g_autoptr(GArray) files_initgroups = NULL;
+    g_autoptr(GArray) module_initgroups = NULL;
+    g_autoptr(GArray) files_getgrnam = NULL;
+    g_autoptr(GArray) module_getgrnam = NULL;
+    BenchNss *bench = NULL;
+    FixtureConfig config;
+    gchar   *daemon_path = NULL;
+    gchar   *module_path = NULL;
+    gchar   *output = NULL;
+    gint     groups, users, members, lookups = 2000;
+    gchar   *daemon_argv[8];
+    const gchar *address;
+    gpointer module = NULL;
+    GRand   *rand = NULL;
+    GPid     pid = 0;
+    guint    mismatches = 0;
+    gint     i;
+    int      ret = EXIT_FAILURE;
+
+    fixture_config_init (&config);
+    groups  = config.n_groups;
+    users   = config.n_users;
+    members = config.n_members;
+    {
+        GOptionEntry entries[] =
+        {
+            { "daemon",     'd', 0, G_OPTION_ARG_FILENAME, &daemon_path,  "group-admin-daemon to run", "PATH" },
+            { "nss-module", 'n', 0, G_OPTION_ARG_FILENAME, &module_path,  "libnss_groupservice.so.2 to load", "PATH" },
+            { "groups",     'g', 0, G_OPTION_ARG_INT,      &groups,       "Number of groups", "N" },
+            { "users",      'u', 0, G_OPTION_ARG_INT,      &users,        "Number of users", "N" },
+            { "members",    'm', 0, G_OPTION_ARG_INT,      &members,      "Members per group", "N" },
+            { "skew",       's', 0, G_OPTION_ARG_DOUBLE,   &config.skew,  "Zipf exponent of membership", "S" },
+            { "lookups",    'l', 0, G_OPTION_ARG_INT,      &lookups,      "Lookups of each kind", "N" },
+            { "output",     'o', 0, G_OPTION_ARG_FILENAME, &output,       "Write JSON here instead of stdout", "FILE" },
+            { NULL }
+        };
+
+        context = g_option_context_new ("- compare libnss_groupservice with nss_files");
+        g_option_context_add_main_entries (context, entries, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            return EXIT_FAILURE;
+        }
+    }
+    if (daemon_path == NULL || module_path == NULL || groups <= 0 || users <= 0 || lookups <= 0)
+    {
+        g_printerr ("--daemon, --nss-module and positive --groups, --users and --lookups are required\n");
+        return EXIT_FAILURE;
+    }
+    config.n_groups  = groups;
+    config.n_users   = users;
+    config.n_members = members;
+
+    root = g_dir_make_tmp ("group-bench-XXXXXX", &error);
+    if (root == NULL || !fixture_write (&config, root, &error))
+    {
+        g_printerr ("Unable to write fixture: %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    cache = g_build_filename (root, "groups.cache", NULL);
+    snapshot = g_build_filename (root, "snapshot", NULL);
+
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+    address = g_test_dbus_get_bus_address (bus);
+    envp = g_get_environ ();
+    envp = g_environ_setenv (envp, "DBUS_SYSTEM_BUS_ADDRESS", address, TRUE);
+    connection = g_dbus_connection_new_for_address_sync (address,
+                                                         G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                         G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                         NULL, NULL, &error);
+    if (connection == NULL)
+    {
+        g_printerr ("Unable to connect to the private bus: %s\n", error->message);
+        goto out;
+    }
+
+    daemon_argv[0] = daemon_path;
+    daemon_argv[1] = (gchar *) "--root";
+    daemon_argv[2] = root;
+    daemon_argv[3] = (gchar *) "--cache";
+    daemon_argv[4] = cache;
+    daemon_argv[5] = (gchar *) "--snapshot-path";
+    daemon_argv[6] = snapshot;
+    daemon_argv[7] = NULL;
+    if (!g_spawn_async (NULL, daemon_argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error))
+    {
+        g_printerr ("Unable to start %s: %s\n", daemon_path, error->message);
+        goto out;
+    }
+    if (bench_wait_for_daemon (connection, g_get_monotonic_time (), &error) < 0 ||
+        !WaitForFile (snapshot))
+    {
+        g_printerr ("Daemon did not publish its table\n");
+        goto stop;
+    }
+
+    /* Read by the module on its first lookup */
+    g_setenv ("GROUP_SERVICE_SNAPSHOT", snapshot, TRUE);
+    module = dlopen (module_path, RTLD_NOW | RTLD_LOCAL);
+    if (module == NULL)
+    {
+        g_printerr ("Unable to load %s: %s\n", module_path, dlerror ());
+        goto stop;
+    }
+    bench = g_new0 (BenchNss, 1);
+    bench->getgrnam_r = (GetgrnamFunc) dlsym (module, "_nss_groupservice_getgrnam_r");
+    bench->initgroups_dyn = (InitgroupsFunc) dlsym (module, "_nss_groupservice_initgroups_dyn");
+    bench->group_path = g_build_filename (root, "etc", "group", NULL);
+    if (bench->getgrnam_r == NULL || bench->initgroups_dyn == NULL)
+    {
+        g_printerr ("%s does not look like an NSS group module\n", module_path);
+        goto stop;
+    }
+
+    files_initgroups = g_array_new (FALSE, FALSE, sizeof (gint64));
+    module_initgroups = g_array_new (FALSE, FALSE, sizeof (gint64));
+    files_getgrnam = g_array_new (FALSE, FALSE, sizeof (gint64));
+    module_getgrnam = g_array_new (FALSE, FALSE, sizeof (gint64));
+    rand = g_rand_new_with_seed (config.seed);
+    for (i = 0; i < lookups; i++)
+    {
+        g_autofree gchar *user = fixture_user_name (g_rand_int_range (rand, 0, config.n_users));
+        g_autofree gchar *group = fixture_group_name (g_rand_int_range (rand, 0, config.n_groups));
+        g_autoptr(GArray) expected = NULL;
+        g_autoptr(GArray) actual = NULL;
+        gid_t expected_gid = 0, actual_gid = 0;
+        gboolean expected_found, actual_found;
+        gint64 start, elapsed;
+
+        start = g_get_monotonic_time ();
+        expected = FilesInitgroups (bench, user);
+        elapsed = bench_elapsed_since (start);
+        g_array_append_val (files_initgroups, elapsed);
+
+        start = g_get_monotonic_time ();
+        actual = ModuleInitgroups (bench, user);
+        elapsed = bench_elapsed_since (start);
+        g_array_append_val (module_initgroups, elapsed);
+
+        start = g_get_monotonic_time ();
+        expected_found = FilesGetgrnam (bench, group, &expected_gid);
+        elapsed = bench_elapsed_since (start);
+        g_array_append_val (files_getgrnam, elapsed);
+
+        start = g_get_monotonic_time ();
+        actual_found = ModuleGetgrnam (bench, group, &actual_gid);
+        elapsed = bench_elapsed_since (start);
+        g_array_append_val (module_getgrnam, elapsed);
+
+        if (!SameGids (expected, actual) ||
+            expected_found != actual_found ||
+            expected_gid != actual_gid)
+        {
+            mismatches++;
+        }
+    }
+
+    out = g_string_new ("{\n");
+    g_string_append_printf (out,
+                            "  \"fixture\": {\"groups\": %u, \"users\": %u, \"members\": %u, \"skew\": %.2f},\n",
+                            config.n_groups, config.n_users, config.n_members, config.skew);
+    g_string_append_printf (out, "  \"lookups\": %d,\n  \"mismatches\": %u,\n", lookups, mismatches);
+    g_string_append (out, "  \"initgroups\": {\n");
+    AppendLatencies (out, "files", files_initgroups, FALSE);
+    AppendLatencies (out, "groupservice", module_initgroups, TRUE);
+    g_string_append (out, "  },\n  \"getgrnam\": {\n");
+    AppendLatencies (out, "files", files_getgrnam, FALSE);
+    AppendLatencies (out, "groupservice", module_getgrnam, TRUE);
+    g_string_append (out, "  }\n}\n");
+
+    if (output != NULL)
+    {
+        if (!g_file_set_contents (output, out->str, out->len, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            goto stop;
+        }
+    }
+    else
+    {
+        fputs (out->str, stdout);
+    }
+    ret = mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+stop:
+    bench_stop (pid);
+out:
+    if (rand != NULL)
+    {
+        g_rand_free (rand);
+    }
+    if (bench != NULL)
+    {
+        g_free (bench->group_path);
+        g_free (bench);
+    }
+    if (module != NULL)
+    {
+        dlclose (module);
+    }
+    g_test_dbus_down (bus);
+    bench_remove_tree (root);
+
+    return ret;
+}
@@ -0,0 +1,235 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Times field_scan on a generated /etc/group against a scanner built on
+ * memchr, the way a line-at-a-time parser finds its separators: one
+ * memchr for the newline, then one each for the next ':' and ','. Every
+ * implementation the CPU supports is run and its offsets are checked
+ * against the memchr ones before the timings are trusted.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "bench-util.h"
+#include "field-scan.h"
+#include "fixture.h"
+
+#define SCAN_BATCH 4096
+
+static void AddOffset (GArray *offsets, const gchar *data, const gchar *p)
+{
+    guint32 offset = p - data;
+
+    g_array_append_val (offsets, offset);
+}
+
+/* The baseline: the same offsets as field_scan, found with memchr */
+static void ScanMemchr (const gchar *data, gsize length, GArray *offsets)
+{
+    const gchar *p = data;
+    const gchar *end = data + length;
+
+    while (p < end)
+    {
+        const gchar *eol = memchr (p, '\n', end - p);
+        const gchar *colon, *comma;
+
+        if (eol == NULL)
+            eol = end;
+        colon = memchr (p, ':', eol - p);
+        comma = memchr (p, ',', eol - p);
+        while (colon != NULL || comma != NULL)
+        {
+            if (comma == NULL || (colon != NULL && colon < comma))
+            {
+                AddOffset (offsets, data, colon);
+                colon = memchr (colon + 1, ':', eol - colon - 1);
+            }
+            else
+            {
+                AddOffset (offsets, data, comma);
+                comma = memchr (comma + 1, ',', eol - comma - 1);
+            }
+        }
+        if (eol < end)
+            AddOffset (offsets, data, eol);
+        p = eol + 1;
+    }
+}
+
+/* Scans the whole text in batches the way the parser does */
+static void ScanFieldScan (FieldScanImpl impl, const gchar *data, gsize length, GArray *offsets)
+{
+    guint32 batch[SCAN_BATCH];
+    gsize pos = 0;
+
+    while (pos < length)
+    {
+        gsize scanned, n, i;
+
+        n = field_scan_with (impl, data + pos, length - pos, batch, SCAN_BATCH, &scanned);
+        g_assert (scanned > 0);
+        for (i = 0; i < n; i++)
+            batch[i] += pos;
+        g_array_append_vals (offsets, batch, n);
+        pos += scanned;
+    }
+}
+
+static void Scan (gint impl, const gchar *data, gsize length, GArray *offsets)
+{
+    g_array_set_size (offsets, 0);
+    if (impl < 0)
+        ScanMemchr (data, length, offsets);
+    else
+        ScanFieldScan (impl, data, length, offsets);
+}
+
+static void Report (GString     *out,
+                    const gchar *name,
+                    gint         impl,
+                    const gchar *data,
+                    gsize        length,
+                    guint        iterations,
+                    GArray      *offsets,
+                    GArray      *reference)
+{
+    gint64 start, best = G_MAXINT64;
+    gboolean same;
+    guint i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        start = g_get_monotonic_time ();
+        Scan (impl, data, length, offsets);
+        best = MIN (best, bench_elapsed_since (start));
+    }
+    same = offsets->len == reference->len &&
+           memcmp (offsets->data, reference->data, reference->len * sizeof (guint32)) == 0;
+
+    g_string_append_printf (out,
+                            "%s    {\"scanner\": \"%s\", \"best_usec\": %" G_GINT64_FORMAT
+                            ", \"mb_per_sec\": %.1f, \"matches_memchr\": %s}",
+                            impl < 0 ? "" : ",\n", name, best,
+                            best > 0 ? length / (gdouble) best : 0.0,
+                            same ? "true" : "false");
+}
+
+int main (int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GString) out = NULL;
+    g_autoptr(GArray) reference = NULL;
+    g_autoptr(GArray) offsets = NULL;
+    g_autofree gchar *root = NULL;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *contents = NULL;
+    gchar   *output = NULL;
+    FixtureConfig config;
+    gint     groups, users, members, iterations = 20;
+    gsize    length;
+    gint     impl;
+    int      ret = EXIT_FAILURE;
+
+    fixture_config_init (&config);
+    config.n_groups = 1000000;
+    groups  = config.n_groups;
+    users   = config.n_users;
+    members = config.n_members;
+    {
+        GOptionEntry entries[] =
+        {
+            { "groups",     'g', 0, G_OPTION_ARG_INT,      &groups,      "Number of groups", "N" },
+            { "users",      'u', 0, G_OPTION_ARG_INT,      &users,       "Number of users", "N" },
+            { "members",    'm', 0, G_OPTION_ARG_INT,      &members,     "Members per group", "N" },
+            { "skew",       's', 0, G_OPTION_ARG_DOUBLE,   &config.skew, "Zipf exponent of membership", "S" },
+            { "iterations", 'i', 0, G_OPTION_ARG_INT,      &iterations,  "Runs per scanner, the best is kept", "N" },
+            { "output",     'o', 0, G_OPTION_ARG_FILENAME, &output,      "Write JSON here instead of stdout", "FILE" },
+            { NULL }
+        };
+
+        context = g_option_context_new ("- benchmark the group file separator scanner");
+        g_option_context_add_main_entries (context, entries, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            return EXIT_FAILURE;
+        }
+    }
+    if (groups < 0 || users < 0 || members < 0 || iterations < 1)
+    {
+        g_printerr ("Counts must not be negative\n");
+        return EXIT_FAILURE;
+    }
+    config.n_groups  = groups;
+    config.n_users   = users;
+    config.n_members = members;
+
+    root = g_dir_make_tmp ("group-bench-XXXXXX", &error);
+    if (root == NULL)
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    path = g_build_filename (root, "etc", "group", NULL);
+    if (!fixture_write (&config, root, &error) ||
+        !g_file_get_contents (path, &contents, &length, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        goto out;
+    }
+
+    reference = g_array_new (FALSE, FALSE, sizeof (guint32));
+    offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+    ScanMemchr (contents, length, reference);
+
+    out = g_string_new ("{\n");
+    g_string_append_printf (out,
+                            "  \"fixture\": {\"groups\": %u, \"users\": %u, \"members\": %u, \"skew\": %.2f, \"bytes\": %"
+                            G_GSIZE_FORMAT "},\n",
+                            config.n_groups, config.n_users, config.n_members, config.skew, length);
+    g_string_append_printf (out, "  \"auto\": \"%s\",\n", field_scan_impl_name (FIELD_SCAN_AUTO));
+    g_string_append (out, "  \"scanners\": [\n");
+    Report (out, "memchr", -1, contents, length, iterations, offsets, reference);
+    for (impl = FIELD_SCAN_SCALAR; impl < FIELD_SCAN_N_IMPLS; impl++)
+    {
+        if (field_scan_is_supported (impl))
+            Report (out, field_scan_impl_name (impl), impl, contents, length,
+                    iterations, offsets, reference);
+    }
+    g_string_append (out, "\n  ]\n}\n");
+
+    if (output != NULL)
+    {
+        if (!g_file_set_contents (output, out->str, out->len, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            goto out;
+        }
+    }
+    else
+    {
+        fputs (out->str, stdout);
+    }
+    ret = EXIT_SUCCESS;
+
+out:
+    bench_remove_tree (root);
+    g_free (output);
+    return ret;
+}
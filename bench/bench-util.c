@@ -0,0 +1,180 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <glib/gstdio.h>
+#include "bench-util.h"
+
+gint64 bench_elapsed_since (gint64 start)
+{
+    return g_get_monotonic_time () - start;
+}
+
+static gint CompareLatency (gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64 *) a;
+    gint64 y = *(const gint64 *) b;
+
+    return (x > y) - (x < y);
+}
+
+void bench_latency_sort (GArray *latencies)
+{
+    g_array_sort (latencies, CompareLatency);
+}
+
+gint64 bench_percentile (GArray *sorted, gdouble p)
+{
+    if (sorted->len == 0)
+    {
+        return 0;
+    }
+    return g_array_index (sorted, gint64, (guint) ((sorted->len - 1) * p));
+}
+
+gboolean bench_wait_for_name (GDBusConnection *connection,
+                              const gchar     *name,
+                              gint64           start,
+                              GError         **error)
+{
+    while (TRUE)
+    {
+        g_autoptr(GVariant) reply = NULL;
+        gboolean owned = FALSE;
+
+        reply = g_dbus_connection_call_sync (connection,
+                                             "org.freedesktop.DBus",
+                                             "/org/freedesktop/DBus",
+                                             "org.freedesktop.DBus",
+                                             "NameHasOwner",
+                                             g_variant_new ("(s)", name),
+                                             G_VARIANT_TYPE ("(b)"),
+                                             G_DBUS_CALL_FLAGS_NONE,
+                                             -1,
+                                             NULL,
+                                             error);
+        if (reply == NULL)
+        {
+            return FALSE;
+        }
+        g_variant_get (reply, "(b)", &owned);
+        if (owned)
+        {
+            return TRUE;
+        }
+        if (bench_elapsed_since (start) > BENCH_TIMEOUT)
+        {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "%s never appeared", name);
+            return FALSE;
+        }
+        g_usleep (1000);
+    }
+}
+
+/* Polls until the daemon owns its name, has exported the manager and
+ * answers ListCachedGroups, which is what a client waits for at boot. */
+gint64 bench_wait_for_daemon (GDBusConnection *connection, gint64 start, GError **error)
+{
+    GVariant *reply;
+
+    while (TRUE)
+    {
+        g_clear_error (error);
+        reply = g_dbus_connection_call_sync (connection,
+                                             BENCH_NAME,
+                                             BENCH_PATH,
+                                             BENCH_NAME,
+                                             "ListCachedGroups",
+                                             NULL,
+                                             NULL,
+                                             G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                             -1,
+                                             NULL,
+                                             error);
+        if (reply != NULL)
+        {
+            g_variant_unref (reply);
+            return bench_elapsed_since (start);
+        }
+        if (bench_elapsed_since (start) > BENCH_TIMEOUT)
+        {
+            return -1;
+        }
+        g_usleep (1000);
+    }
+}
+
+/* VmHWM of a running process in bytes, 0 if it cannot be read */
+guint64 bench_get_peak_rss (GPid pid)
+{
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *status = NULL;
+    const gchar *line;
+
+    path = g_strdup_printf ("/proc/%d/status", (int) pid);
+    if (!g_file_get_contents (path, &status, NULL, NULL))
+        return 0;
+    line = strstr (status, "\nVmHWM:");
+    if (line == NULL)
+        return 0;
+
+    return g_ascii_strtoull (line + strlen ("\nVmHWM:"), NULL, 10) * 1024;
+}
+
+void bench_stop (GPid pid)
+{
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+    g_spawn_close_pid (pid);
+}
+
+void bench_remove_tree (const gchar *root)
+{
+    static const gchar *files[] = { "passwd", "shadow", "group", "group-", "group+", "passwd-" };
+    g_autofree gchar *etc = NULL;
+    g_autofree gchar *cache = NULL;
+    g_autofree gchar *snapshot = NULL;
+    g_autofree gchar *peer = NULL;
+    g_autofree gchar *userdb = NULL;
+    guint i;
+
+    etc = g_build_filename (root, "etc", NULL);
+    for (i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+        g_autofree gchar *path = g_build_filename (etc, files[i], NULL);
+
+        g_unlink (path);
+    }
+    g_rmdir (etc);
+    cache = g_build_filename (root, "groups.cache", NULL);
+    g_unlink (cache);
+    snapshot = g_build_filename (root, "snapshot", NULL);
+    g_unlink (snapshot);
+    peer = g_build_filename (root, "peer", NULL);
+    g_unlink (peer);
+    /* The daemon's Varlink socket, which --root also relocates */
+    userdb = g_build_filename (root, "run", "systemd", "userdb", "org.group.admin", NULL);
+    g_unlink (userdb);
+    for (i = 0; i < 3; i++)
+    {
+        g_autofree gchar *dir = g_path_get_dirname (userdb);
+
+        g_rmdir (dir);
+        g_free (userdb);
+        userdb = g_steal_pointer (&dir);
+    }
+    g_rmdir (root);
+}
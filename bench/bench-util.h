@@ -0,0 +1,43 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define BENCH_NAME       "org.group.admin"
+#define BENCH_PATH       "/org/group/admin"
+#define BENCH_TIMEOUT    (30 * G_USEC_PER_SEC)
+
+gint64   bench_elapsed_since     (gint64            start);
+void     bench_latency_sort      (GArray           *latencies);
+gint64   bench_percentile        (GArray           *sorted,
+                                  gdouble           p);
+gboolean bench_wait_for_name     (GDBusConnection  *connection,
+                                  const gchar      *name,
+                                  gint64            start,
+                                  GError          **error);
+gint64   bench_wait_for_daemon   (GDBusConnection  *connection,
+                                  gint64            start,
+                                  GError          **error);
+guint64  bench_get_peak_rss      (GPid              pid);
+void     bench_stop              (GPid              pid);
+void     bench_remove_tree       (const gchar      *root);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,199 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+#include "fixture.h"
+
+void fixture_config_init (FixtureConfig *config)
+{
+    config->n_groups  = 10000;
+    config->n_users   = 5000;
+    config->n_members = 20;
+    config->skew      = 1.0;
+    config->seed      = 1;
+}
+
+gchar *fixture_group_name (guint index)
+{
+    return g_strdup_printf ("grp%06u", index);
+}
+
+gchar *fixture_user_name (guint index)
+{
+    return g_strdup_printf ("user%06u", index);
+}
+
+/* Cumulative Zipf weights over the users, searched with a random draw */
+static gdouble *BuildZipfTable (guint n, gdouble skew)
+{
+    gdouble *cdf;
+    gdouble  total = 0;
+    guint    i;
+
+    cdf = g_new (gdouble, n);
+    for (i = 0; i < n; i++)
+    {
+        total += 1.0 / pow (i + 1, skew);
+        cdf[i] = total;
+    }
+
+    return cdf;
+}
+
+static guint DrawZipf (GRand *rand, const gdouble *cdf, guint n)
+{
+    gdouble target;
+    guint   low = 0, high = n - 1;
+
+    target = g_rand_double (rand) * cdf[n - 1];
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (cdf[mid] < target)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+static void AppendMembers (GString      *out,
+                           GRand        *rand,
+                           const gdouble *cdf,
+                           guint         n_users,
+                           guint         n_members,
+                           GHashTable   *seen)
+{
+    guint attempts = 0;
+    guint added = 0;
+
+    g_hash_table_remove_all (seen);
+    n_members = MIN (n_members, n_users);
+    /* Skewed draws repeat often, give up rather than spin on the tail */
+    while (added < n_members && attempts < n_members * 8)
+    {
+        guint user = DrawZipf (rand, cdf, n_users);
+
+        attempts++;
+        if (!g_hash_table_add (seen, GUINT_TO_POINTER (user + 1)))
+        {
+            continue;
+        }
+        g_string_append_printf (out, "%suser%06u", added ? "," : "", user);
+        added++;
+    }
+}
+
+static gboolean WriteFile (const gchar *root,
+                           const gchar *name,
+                           GString     *contents,
+                           GError     **error)
+{
+    g_autofree gchar *path = NULL;
+
+    path = g_build_filename (root, "etc", name, NULL);
+    return g_file_set_contents (path, contents->str, contents->len, error);
+}
+
+gboolean fixture_write (const FixtureConfig *config,
+                        const gchar         *root,
+                        GError             **error)
+{
+    g_autofree gchar *etc = NULL;
+    g_autofree gdouble *cdf = NULL;
+    g_autoptr(GString) passwd = NULL;
+    g_autoptr(GString) shadow = NULL;
+    g_autoptr(GString) group = NULL;
+    g_autoptr(GHashTable) seen = NULL;
+    GRand   *rand;
+    gboolean ret;
+    guint    i;
+
+    etc = g_build_filename (root, "etc", NULL);
+    if (g_mkdir_with_parents (etc, 0755) < 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to create %s: %s", etc, g_strerror (errno));
+        return FALSE;
+    }
+
+    passwd = g_string_new ("root:x:0:0:root:/root:/bin/sh\n");
+    shadow = g_string_new ("root:*:19000:0:99999:7:::\n");
+    for (i = 0; i < config->n_users; i++)
+    {
+        g_string_append_printf (passwd,
+                                "user%06u:x:%u:%u:User %u:/home/user%06u:/bin/sh\n",
+                                i, FIXTURE_FIRST_UID + i, FIXTURE_USERS_GID, i, i);
+        g_string_append_printf (shadow, "user%06u:!:19000:0:99999:7:::\n", i);
+    }
+
+    group = g_string_new ("root:x:0:\n");
+    g_string_append_printf (group, "users:x:%u:\n", FIXTURE_USERS_GID);
+    if (config->n_users > 0)
+    {
+        cdf = BuildZipfTable (config->n_users, config->skew);
+    }
+    seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+    rand = g_rand_new_with_seed (config->seed);
+    for (i = 0; i < config->n_groups; i++)
+    {
+        g_string_append_printf (group, "grp%06u:x:%u:", i, FIXTURE_FIRST_GID + i);
+        if (cdf != NULL)
+        {
+            AppendMembers (group, rand, cdf, config->n_users, config->n_members, seen);
+        }
+        g_string_append_c (group, '\n');
+    }
+    g_rand_free (rand);
+
+    ret = WriteFile (root, "passwd", passwd, error) &&
+          WriteFile (root, "shadow", shadow, error) &&
+          WriteFile (root, "group", group, error);
+
+    return ret;
+}
+
+/* Appends in place like useradd does, so the daemon sees a single change
+ * event on the existing file rather than a replaced inode. */
+gboolean fixture_append_group (const gchar *root,
+                               const gchar *name,
+                               gid_t        gid,
+                               GError     **error)
+{
+    g_autofree gchar *path = NULL;
+    FILE *fp;
+
+    path = g_build_filename (root, "etc", "group", NULL);
+    fp = fopen (path, "a");
+    if (fp == NULL)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to open %s: %s", path, g_strerror (errno));
+        return FALSE;
+    }
+    fprintf (fp, "%s:x:%u:\n", name, (guint) gid);
+    if (fclose (fp) != 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to write %s: %s", path, g_strerror (errno));
+        return FALSE;
+    }
+
+    return TRUE;
+}
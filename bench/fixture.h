@@ -0,0 +1,52 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __FIXTURE_H__
+#define __FIXTURE_H__
+
+#include <sys/types.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define FIXTURE_FIRST_UID 10000
+#define FIXTURE_FIRST_GID 20000
+#define FIXTURE_USERS_GID 100
+
+/* Shape of a synthetic passwd/shadow/group tree. Members are drawn from
+ * the users with a Zipf distribution of exponent skew, so a few users end
+ * up in most groups when skew is large; 0 is uniform. */
+typedef struct
+{
+    guint   n_groups;
+    guint   n_users;
+    guint   n_members;
+    gdouble skew;
+    guint32 seed;
+} FixtureConfig;
+
+void     fixture_config_init  (FixtureConfig       *config);
+gchar   *fixture_group_name   (guint                index);
+gchar   *fixture_user_name    (guint                index);
+gboolean fixture_write        (const FixtureConfig *config,
+                               const gchar         *root,
+                               GError             **error);
+gboolean fixture_append_group (const gchar         *root,
+                               const gchar         *name,
+                               gid_t                gid,
+                               GError             **error);
+
+G_END_DECLS
+
+#endif
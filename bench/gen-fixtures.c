@@ -0,0 +1,67 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include "fixture.h"
+
+/* Writes DIR/etc/{passwd,shadow,group} for group-admin-daemon --root DIR */
+int main (int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    FixtureConfig config;
+    gint groups, users, members, seed;
+
+    fixture_config_init (&config);
+    groups  = config.n_groups;
+    users   = config.n_users;
+    members = config.n_members;
+    seed    = config.seed;
+    {
+        GOptionEntry entries[] =
+        {
+            { "groups",  'g', 0, G_OPTION_ARG_INT,    &groups,      "Number of groups", "N" },
+            { "users",   'u', 0, G_OPTION_ARG_INT,    &users,       "Number of users", "N" },
+            { "members", 'm', 0, G_OPTION_ARG_INT,    &members,     "Members per group", "N" },
+            { "skew",    's', 0, G_OPTION_ARG_DOUBLE, &config.skew, "Zipf exponent of membership, 0 is uniform", "S" },
+            { "seed",    0,   0, G_OPTION_ARG_INT,    &seed,        "Random seed", "N" },
+            { NULL }
+        };
+
+        context = g_option_context_new ("DIR - generate a synthetic account tree");
+        g_option_context_add_main_entries (context, entries, NULL);
+        if (!g_option_context_parse (context, &argc, &argv, &error))
+        {
+            g_printerr ("%s\n", error->message);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc != 2 || groups < 0 || users < 0 || members < 0)
+    {
+        g_printerr ("Usage: %s [OPTION...] DIR\n", g_get_prgname ());
+        return EXIT_FAILURE;
+    }
+
+    config.n_groups  = groups;
+    config.n_users   = users;
+    config.n_members = members;
+    config.seed      = seed;
+    if (!fixture_write (&config, argv[1], &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
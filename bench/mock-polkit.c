@@ -0,0 +1,208 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Stands in for polkitd on a private "system" bus. libpolkit in the daemon
+ * talks to whatever owns org.freedesktop.PolicyKit1, so pointing
+ * DBUS_SYSTEM_BUS_ADDRESS at the private bus is all the daemon needs. */
+#include <stdlib.h>
+#include <string.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#define POLKIT_NAME      "org.freedesktop.PolicyKit1"
+#define POLKIT_PATH      "/org/freedesktop/PolicyKit1/Authority"
+#define POLKIT_INTERFACE "org.freedesktop.PolicyKit1.Authority"
+
+static const gchar introspection_xml[] =
+    "<node>"
+    "  <interface name='" POLKIT_INTERFACE "'>"
+    "    <method name='CheckAuthorization'>"
+    "      <arg type='(sa{sv})' name='subject' direction='in'/>"
+    "      <arg type='s' name='action_id' direction='in'/>"
+    "      <arg type='a{ss}' name='details' direction='in'/>"
+    "      <arg type='u' name='flags' direction='in'/>"
+    "      <arg type='s' name='cancellation_id' direction='in'/>"
+    "      <arg type='(bba{ss})' name='result' direction='out'/>"
+    "    </method>"
+    "    <method name='CancelCheckAuthorization'>"
+    "      <arg type='s' name='cancellation_id' direction='in'/>"
+    "    </method>"
+    "    <property type='s' name='BackendName' access='read'/>"
+    "    <property type='s' name='BackendVersion' access='read'/>"
+    "    <property type='u' name='BackendFeatures' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+typedef enum
+{
+    ANSWER_ALLOW,
+    ANSWER_DENY,
+    ANSWER_CHALLENGE
+} Answer;
+
+static Answer answer = ANSWER_ALLOW;
+static gint   latency_ms = 0;
+static guint  checks = 0;
+
+static gboolean ReplyCheck (gpointer data)
+{
+    GDBusMethodInvocation *invocation = data;
+
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("((bb@a{ss}))",
+                                                          answer == ANSWER_ALLOW,
+                                                          answer == ANSWER_CHALLENGE,
+                                                          g_variant_new_array (G_VARIANT_TYPE ("{ss}"), NULL, 0)));
+    return G_SOURCE_REMOVE;
+}
+
+static void HandleMethodCall (GDBusConnection       *connection,
+                              const gchar           *sender,
+                              const gchar           *object_path,
+                              const gchar           *interface_name,
+                              const gchar           *method_name,
+                              GVariant              *parameters,
+                              GDBusMethodInvocation *invocation,
+                              gpointer               user_data)
+{
+    if (g_strcmp0 (method_name, "CheckAuthorization") == 0)
+    {
+        checks++;
+        if (latency_ms > 0)
+        {
+            g_timeout_add (latency_ms, ReplyCheck, invocation);
+        }
+        else
+        {
+            ReplyCheck (invocation);
+        }
+        return;
+    }
+
+    g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static GVariant *HandleGetProperty (GDBusConnection *connection,
+                                    const gchar     *sender,
+                                    const gchar     *object_path,
+                                    const gchar     *interface_name,
+                                    const gchar     *property_name,
+                                    GError         **error,
+                                    gpointer         user_data)
+{
+    if (g_strcmp0 (property_name, "BackendName") == 0)
+        return g_variant_new_string ("mock");
+    if (g_strcmp0 (property_name, "BackendVersion") == 0)
+        return g_variant_new_string ("0");
+    return g_variant_new_uint32 (0);
+}
+
+static const GDBusInterfaceVTable vtable =
+{
+    HandleMethodCall,
+    HandleGetProperty,
+    NULL
+};
+
+static void BusAcquired (GDBusConnection *connection,
+                         const gchar     *name,
+                         gpointer         data)
+{
+    GDBusNodeInfo *info = data;
+    g_autoptr(GError) error = NULL;
+
+    if (g_dbus_connection_register_object (connection,
+                                           POLKIT_PATH,
+                                           info->interfaces[0],
+                                           &vtable,
+                                           NULL,
+                                           NULL,
+                                           &error) == 0)
+    {
+        g_printerr ("Unable to export the authority: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+}
+
+static void NameLost (GDBusConnection *connection,
+                      const gchar     *name,
+                      gpointer         data)
+{
+    g_printerr ("Unable to own %s\n", name);
+    exit (EXIT_FAILURE);
+}
+
+static gboolean Quit (gpointer data)
+{
+    g_main_loop_quit (data);
+    return G_SOURCE_REMOVE;
+}
+
+int main (int argc, char *argv[])
+{
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *mode = NULL;
+    GDBusNodeInfo *info;
+    GMainLoop *loop;
+    guint owner;
+    GOptionEntry entries[] =
+    {
+        { "answer",  'a', 0, G_OPTION_ARG_STRING, &mode,       "allow, deny or challenge", "ANSWER" },
+        { "latency", 'l', 0, G_OPTION_ARG_INT,    &latency_ms, "Delay every answer by MS", "MS" },
+        { NULL }
+    };
+
+    context = g_option_context_new ("- mock polkit authority");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    if (mode == NULL || strcmp (mode, "allow") == 0)
+        answer = ANSWER_ALLOW;
+    else if (strcmp (mode, "deny") == 0)
+        answer = ANSWER_DENY;
+    else if (strcmp (mode, "challenge") == 0)
+        answer = ANSWER_CHALLENGE;
+    else
+    {
+        g_printerr ("Unknown answer '%s'\n", mode);
+        return EXIT_FAILURE;
+    }
+
+    info = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+    owner = g_bus_own_name (G_BUS_TYPE_SYSTEM,
+                            POLKIT_NAME,
+                            G_BUS_NAME_OWNER_FLAGS_NONE,
+                            BusAcquired,
+                            NULL,
+                            NameLost,
+                            info,
+                            NULL);
+
+    loop = g_main_loop_new (NULL, FALSE);
+    g_unix_signal_add (SIGINT,  Quit, loop);
+    g_unix_signal_add (SIGTERM, Quit, loop);
+    g_main_loop_run (loop);
+
+    g_print ("%u checks answered\n", checks);
+    g_bus_unown_name (owner);
+    g_main_loop_unref (loop);
+    g_dbus_node_info_unref (info);
+
+    return EXIT_SUCCESS;
+}
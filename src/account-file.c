@@ -0,0 +1,412 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+
+#include "account-file.h"
+#include "field-scan.h"
+#include "probes.h"
+
+/*
+ * /etc/group and /etc/passwd read into memory and split into entries with
+ * the same rules as fgetgrent and fgetpwent: leading blanks, empty lines,
+ * comments and malformed lines are skipped. Separators are found with
+ * field_scan. Large files are cut at line
+ * boundaries into one chunk per processor and the chunks are parsed on a
+ * shared thread pool, each in place in its own part of the buffer; the
+ * entries then appear in file order as if read by a single pass. The
+ * strings in the entries point into the buffer and live as long as the
+ * AccountFile.
+ */
+
+/* Smaller files are not worth the threads */
+#define ACCOUNT_CHUNK_MIN  (1024 * 1024)
+/* Separators found per field_scan call */
+#define ACCOUNT_SCAN_BATCH 4096
+
+struct AccountFile
+{
+    AccountFileKind kind;
+    gchar          *contents;
+    GArray         *entries;
+    GPtrArray      *members;    /* per chunk vectors that gr_mem points into */
+};
+
+typedef struct
+{
+    GMutex lock;
+    GCond  done;
+    guint  pending;
+} ChunkSet;
+
+typedef struct
+{
+    AccountFileKind kind;
+    gchar          *start;
+    gchar          *end;
+    GArray         *entries;
+    GPtrArray      *members;
+    ChunkSet       *set;
+} Chunk;
+
+/* Cuts line at its first n - 1 colons into n fields, the last taking the
+ * rest of the line and missing ones left empty. Returns how many fields
+ * the line has, *used how many of seps were looked at. */
+static guint CutFields (gchar          *line,
+                        gchar          *eol,
+                        gchar          *base,
+                        const guint32  *seps,
+                        gsize           n_seps,
+                        gchar         **fields,
+                        guint           n,
+                        gsize          *used)
+{
+    guint field = 1;
+    guint found;
+    gsize i;
+
+    fields[0] = line;
+    for (i = 0; i < n_seps && field < n; i++)
+    {
+        gchar *sep = base + seps[i];
+
+        if (*sep != ':')
+            continue;
+        *sep = '\0';
+        fields[field++] = sep + 1;
+    }
+    *used = i;
+    for (found = field; field < n; field++)
+        fields[field] = eol;
+
+    return found;
+}
+
+static gboolean ParseId (const gchar *text, guint32 *id)
+{
+    guint64 value = 0;
+
+    if (*text == '\0')
+        return FALSE;
+    for (; *text != '\0'; text++)
+    {
+        if (!g_ascii_isdigit (*text))
+            return FALSE;
+        value = value * 10 + (*text - '0');
+        if (value > G_MAXUINT32)
+            return FALSE;
+    }
+    *id = value;
+
+    return TRUE;
+}
+
+static void ParseGroupLine (Chunk         *chunk,
+                            gchar         *line,
+                            gchar         *eol,
+                            gchar         *base,
+                            const guint32 *seps,
+                            gsize          n_seps)
+{
+    struct group entry;
+    gchar *fields[4];
+    gchar *member;
+    gsize used, i;
+    guint32 id;
+
+    /* The member list may be missing altogether */
+    if (CutFields (line, eol, base, seps, n_seps, fields, G_N_ELEMENTS (fields), &used) < 3 ||
+        fields[0][0] == '\0' || !ParseId (fields[2], &id))
+        return;
+    entry.gr_name = fields[0];
+    entry.gr_passwd = fields[1];
+    entry.gr_gid = id;
+
+    /* An offset until the vector stops growing, see FixMembers */
+    entry.gr_mem = GSIZE_TO_POINTER ((gsize) chunk->members->len);
+    member = fields[3];
+    for (i = used; i < n_seps; i++)
+    {
+        gchar *sep = base + seps[i];
+
+        if (*sep != ',')
+            continue;
+        *sep = '\0';
+        if (*member != '\0')
+            g_ptr_array_add (chunk->members, member);
+        member = sep + 1;
+    }
+    if (*member != '\0')
+        g_ptr_array_add (chunk->members, member);
+    g_ptr_array_add (chunk->members, NULL);
+    g_array_append_val (chunk->entries, entry);
+}
+
+static void ParsePasswdLine (Chunk         *chunk,
+                             gchar         *line,
+                             gchar         *eol,
+                             gchar         *base,
+                             const guint32 *seps,
+                             gsize          n_seps)
+{
+    struct passwd entry;
+    gchar *fields[7];
+    guint32 uid, gid;
+    gsize used;
+
+    /* Like fgetpwent, gecos, home and shell may be left off */
+    if (CutFields (line, eol, base, seps, n_seps, fields, G_N_ELEMENTS (fields), &used) < 4 ||
+        fields[0][0] == '\0' || !ParseId (fields[2], &uid) || !ParseId (fields[3], &gid))
+        return;
+    entry.pw_name = fields[0];
+    entry.pw_passwd = fields[1];
+    entry.pw_uid = uid;
+    entry.pw_gid = gid;
+    entry.pw_gecos = fields[4];
+    entry.pw_dir = fields[5];
+    entry.pw_shell = fields[6];
+    g_array_append_val (chunk->entries, entry);
+}
+
+/* seps are the ':' and ',' offsets from base that fall inside the line */
+static void ParseLine (Chunk         *chunk,
+                       gchar         *line,
+                       gchar         *eol,
+                       gchar         *base,
+                       const guint32 *seps,
+                       gsize          n_seps)
+{
+    *eol = '\0';
+    while (*line == ' ' || *line == '\t')
+        line++;
+    if (*line == '\0' || *line == '#')
+        return;
+    if (chunk->kind == ACCOUNT_FILE_GROUP)
+        ParseGroupLine (chunk, line, eol, base, seps, n_seps);
+    else
+        ParsePasswdLine (chunk, line, eol, base, seps, n_seps);
+}
+
+static void FixMembers (Chunk *chunk)
+{
+    guint i;
+
+    for (i = 0; i < chunk->entries->len; i++)
+    {
+        struct group *entry = &g_array_index (chunk->entries, struct group, i);
+
+        entry->gr_mem = (gchar **) chunk->members->pdata + GPOINTER_TO_SIZE (entry->gr_mem);
+    }
+}
+
+/* field_scan finds the separators of a batch of lines in one pass, the
+ * lines are then cut at those offsets */
+static void ParseChunk (Chunk *chunk)
+{
+    gsize capacity = ACCOUNT_SCAN_BATCH;
+    guint32 *offsets = g_new (guint32, capacity);
+    gchar *base = chunk->start;
+    gsize length = chunk->end - chunk->start;
+    gint64 start = g_get_monotonic_time ();
+
+    while (length > 0)
+    {
+        gchar *line = base;
+        gsize scanned, n, i, first = 0;
+
+        n = field_scan (base, length, offsets, capacity, &scanned);
+        if (scanned == 0)
+        {
+            /* One line has more separators than a whole batch */
+            capacity *= 2;
+            offsets = g_renew (guint32, offsets, capacity);
+            continue;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (base[offsets[i]] != '\n')
+                continue;
+            ParseLine (chunk, line, base + offsets[i], base, offsets + first, i - first);
+            line = base + offsets[i] + 1;
+            first = i + 1;
+        }
+        /* The file ends without a newline */
+        if (line < base + scanned)
+            ParseLine (chunk, line, base + scanned, base, offsets + first, n - first);
+        base += scanned;
+        length -= scanned;
+    }
+    g_free (offsets);
+
+    if (chunk->kind == ACCOUNT_FILE_GROUP)
+        FixMembers (chunk);
+    GS_PROBE3 (parse__chunk,
+               chunk->kind == ACCOUNT_FILE_GROUP ? "group" : "passwd",
+               chunk->end - chunk->start,
+               g_get_monotonic_time () - start);
+}
+
+static void RunChunk (gpointer data, gpointer user_data)
+{
+    Chunk *chunk = data;
+    ChunkSet *set = chunk->set;
+
+    ParseChunk (chunk);
+    g_mutex_lock (&set->lock);
+    if (--set->pending == 0)
+        g_cond_signal (&set->done);
+    g_mutex_unlock (&set->lock);
+}
+
+static GThreadPool *ChunkPool (void)
+{
+    static gsize pool = 0;
+
+    if (g_once_init_enter (&pool))
+    {
+        GThreadPool *created;
+
+        created = g_thread_pool_new (RunChunk, NULL, g_get_num_processors (), FALSE, NULL);
+        g_once_init_leave (&pool, (gsize) created);
+    }
+
+    return (GThreadPool *) pool;
+}
+
+AccountFile *account_file_load (const gchar *path, AccountFileKind kind)
+{
+    AccountFile *file;
+    ChunkSet set;
+    Chunk *chunks;
+    gchar *p, *end;
+    gsize length;
+    guint n, i;
+    gint64 start = g_get_monotonic_time ();
+
+    GS_PROBE1 (parse__start, path);
+    file = g_new0 (AccountFile, 1);
+    file->kind = kind;
+    file->entries = g_array_new (FALSE, FALSE, kind == ACCOUNT_FILE_GROUP ?
+                                 sizeof (struct group) : sizeof (struct passwd));
+    file->members = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+    /* A missing file reads as an empty one */
+    if (!g_file_get_contents (path, &file->contents, &length, NULL))
+    {
+        GS_PROBE3 (parse__done, path, 0, g_get_monotonic_time () - start);
+        return file;
+    }
+
+    n = CLAMP (length / ACCOUNT_CHUNK_MIN, 1, g_get_num_processors ());
+    chunks = g_new0 (Chunk, n);
+    g_mutex_init (&set.lock);
+    g_cond_init (&set.done);
+    set.pending = 0;
+    p = file->contents;
+    end = file->contents + length;
+    for (i = 0; i < n; i++)
+    {
+        gchar *cut = i + 1 == n ? end : file->contents + length / n * (i + 1);
+
+        /* Every chunk but the last ends just after a newline */
+        if (cut < p)
+            cut = p;
+        else if (cut < end)
+        {
+            cut = memchr (cut, '\n', end - cut);
+            cut = cut != NULL ? cut + 1 : end;
+        }
+        chunks[i].kind = kind;
+        chunks[i].start = p;
+        chunks[i].end = cut;
+        chunks[i].entries = g_array_new (FALSE, FALSE, g_array_get_element_size (file->entries));
+        chunks[i].members = g_ptr_array_new ();
+        chunks[i].set = &set;
+        p = cut;
+    }
+
+    /* The first chunk is parsed here while the pool takes the others */
+    for (i = 1; i < n; i++)
+    {
+        g_mutex_lock (&set.lock);
+        set.pending++;
+        g_mutex_unlock (&set.lock);
+        if (!g_thread_pool_push (ChunkPool (), &chunks[i], NULL))
+            RunChunk (&chunks[i], NULL);
+    }
+    ParseChunk (&chunks[0]);
+    g_mutex_lock (&set.lock);
+    while (set.pending > 0)
+        g_cond_wait (&set.done, &set.lock);
+    g_mutex_unlock (&set.lock);
+
+    for (i = 0; i < n; i++)
+    {
+        g_array_append_vals (file->entries, chunks[i].entries->data, chunks[i].entries->len);
+        g_array_free (chunks[i].entries, TRUE);
+        g_ptr_array_add (file->members, chunks[i].members);
+    }
+    g_mutex_clear (&set.lock);
+    g_cond_clear (&set.done);
+    g_free (chunks);
+    GS_PROBE3 (parse__done, path, file->entries->len, g_get_monotonic_time () - start);
+
+    return file;
+}
+
+static gpointer LoadPasswd (gpointer path)
+{
+    return account_file_load (path, ACCOUNT_FILE_PASSWD);
+}
+
+/* Reads both files at once, passwd on a thread of its own */
+void account_file_load_pair (const gchar  *group_path,
+                             const gchar  *passwd_path,
+                             AccountFile **groups,
+                             AccountFile **passwd)
+{
+    GThread *thread;
+
+    thread = g_thread_try_new ("load-passwd", LoadPasswd, (gpointer) passwd_path, NULL);
+    *groups = account_file_load (group_path, ACCOUNT_FILE_GROUP);
+    *passwd = thread != NULL ? g_thread_join (thread) : LoadPasswd ((gpointer) passwd_path);
+}
+
+void account_file_free (AccountFile *file)
+{
+    g_array_free (file->entries, TRUE);
+    g_ptr_array_unref (file->members);
+    g_free (file->contents);
+    g_free (file);
+}
+
+guint account_file_get_size (AccountFile *file)
+{
+    return file->entries->len;
+}
+
+struct group *account_file_get_group (AccountFile *file, guint index)
+{
+    g_return_val_if_fail (file->kind == ACCOUNT_FILE_GROUP, NULL);
+
+    return &g_array_index (file->entries, struct group, index);
+}
+
+struct passwd *account_file_get_passwd (AccountFile *file, guint index)
+{
+    g_return_val_if_fail (file->kind == ACCOUNT_FILE_PASSWD, NULL);
+
+    return &g_array_index (file->entries, struct passwd, index);
+}
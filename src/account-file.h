@@ -0,0 +1,48 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __ACCOUNT_FILE_H__
+#define __ACCOUNT_FILE_H__
+
+#include <sys/types.h>
+#include <grp.h>
+#include <pwd.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    ACCOUNT_FILE_GROUP,
+    ACCOUNT_FILE_PASSWD,
+} AccountFileKind;
+
+typedef struct AccountFile AccountFile;
+
+AccountFile *   account_file_load        (const gchar     *path,
+                                          AccountFileKind  kind);
+void            account_file_load_pair   (const gchar     *group_path,
+                                          const gchar     *passwd_path,
+                                          AccountFile    **groups,
+                                          AccountFile    **passwd);
+void            account_file_free        (AccountFile     *file);
+guint           account_file_get_size    (AccountFile     *file);
+struct group *  account_file_get_group   (AccountFile     *file,
+                                          guint            index);
+struct passwd * account_file_get_passwd  (AccountFile     *file,
+                                          guint            index);
+
+G_END_DECLS
+
+#endif /* __ACCOUNT_FILE_H__ */
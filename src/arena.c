@@ -0,0 +1,121 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+
+#include "arena.h"
+
+/*
+ * Bump allocator for data that shares one lifetime, such as everything
+ * parsed during a single reload. Individual allocations are never freed;
+ * the whole arena goes away with arena_free(), which costs one free()
+ * per block instead of one per string.
+ */
+
+#define ARENA_ALIGN 8
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    gsize              size;
+    gsize              used;
+    guint8             data[];
+} ArenaBlock;
+
+struct Arena
+{
+    ArenaBlock *blocks;
+    gsize       block_size;
+    gsize       total;
+    guint       n_blocks;
+};
+
+Arena *arena_new (gsize block_size)
+{
+    Arena *arena;
+
+    arena = g_new0 (Arena, 1);
+    arena->block_size = block_size;
+
+    return arena;
+}
+
+void arena_free (Arena *arena)
+{
+    ArenaBlock *block;
+    ArenaBlock *next;
+
+    if (arena == NULL)
+        return;
+
+    for (block = arena->blocks; block != NULL; block = next)
+    {
+        next = block->next;
+        g_free (block);
+    }
+    g_free (arena);
+}
+
+gpointer arena_alloc (Arena *arena, gsize size)
+{
+    ArenaBlock *block;
+    gpointer    ret;
+
+    size = (size + ARENA_ALIGN - 1) & ~((gsize) ARENA_ALIGN - 1);
+    block = arena->blocks;
+    if (block == NULL || block->size - block->used < size)
+    {
+        gsize block_size = MAX (arena->block_size, size);
+
+        block = g_malloc (sizeof (ArenaBlock) + block_size);
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->total += block_size;
+        arena->n_blocks++;
+    }
+
+    ret = block->data + block->used;
+    block->used += size;
+
+    return ret;
+}
+
+gchar *arena_strdup (Arena *arena, const gchar *str)
+{
+    gchar *ret;
+    gsize  len;
+
+    if (str == NULL)
+        return NULL;
+
+    len = strlen (str) + 1;
+    ret = arena_alloc (arena, len);
+    memcpy (ret, str, len);
+
+    return ret;
+}
+
+gsize arena_get_size (Arena *arena)
+{
+    return arena->total;
+}
+
+guint arena_get_n_blocks (Arena *arena)
+{
+    return arena->n_blocks;
+}
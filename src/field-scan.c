@@ -0,0 +1,245 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+
+#include "field-scan.h"
+
+/*
+ * Stage one of the account file parser: the offsets of every ':', ','
+ * and '\n' in a run of text, for as many whole lines as fit in the
+ * caller's array. The parser then cuts fields from those offsets without
+ * looking at the text again. The SSE2 and AVX2 versions compare 16 or 32
+ * bytes at a time against the three separators and turn the matches into
+ * a bit mask; which one runs is decided from the CPU on first use.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIELD_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef struct
+{
+    const char *data;
+    uint32_t   *offsets;
+    size_t      max;
+    size_t      n;
+    size_t      n_lines;    /* offsets up to and including the last '\n' */
+    size_t      line_end;   /* bytes up to and including the last '\n' */
+} Sink;
+
+static const unsigned char is_separator[256] =
+{
+    ['\n'] = 1,
+    [','] = 1,
+    [':'] = 1,
+};
+
+/* Returns 0 once the array is full */
+static inline int EmitOne (Sink *sink, size_t pos)
+{
+    if (sink->n == sink->max)
+        return 0;
+    sink->offsets[sink->n++] = (uint32_t) pos;
+    if (sink->data[pos] == '\n')
+    {
+        sink->n_lines = sink->n;
+        sink->line_end = pos + 1;
+    }
+
+    return 1;
+}
+
+static int ScanScalar (Sink *sink, size_t start, size_t length)
+{
+    size_t i;
+
+    for (i = start; i < length; i++)
+    {
+        if (is_separator[(unsigned char) sink->data[i]] && !EmitOne (sink, i))
+            return 0;
+    }
+
+    return 1;
+}
+
+#ifdef FIELD_SCAN_X86
+static inline int EmitMask (Sink *sink, uint32_t mask, size_t base)
+{
+    while (mask != 0)
+    {
+        if (!EmitOne (sink, base + __builtin_ctz (mask)))
+            return 0;
+        mask &= mask - 1;
+    }
+
+    return 1;
+}
+
+__attribute__ ((target ("sse2")))
+static int ScanSse2 (Sink *sink, size_t length)
+{
+    const __m128i colon = _mm_set1_epi8 (':');
+    const __m128i comma = _mm_set1_epi8 (',');
+    const __m128i newline = _mm_set1_epi8 ('\n');
+    size_t i;
+
+    for (i = 0; i + 16 <= length; i += 16)
+    {
+        __m128i block = _mm_loadu_si128 ((const __m128i *) (sink->data + i));
+        __m128i hits = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (block, colon),
+                                                   _mm_cmpeq_epi8 (block, comma)),
+                                     _mm_cmpeq_epi8 (block, newline));
+
+        if (!EmitMask (sink, (uint32_t) _mm_movemask_epi8 (hits), i))
+            return 0;
+    }
+
+    return ScanScalar (sink, i, length);
+}
+
+__attribute__ ((target ("avx2")))
+static int ScanAvx2 (Sink *sink, size_t length)
+{
+    const __m256i colon = _mm256_set1_epi8 (':');
+    const __m256i comma = _mm256_set1_epi8 (',');
+    const __m256i newline = _mm256_set1_epi8 ('\n');
+    size_t i;
+
+    for (i = 0; i + 32 <= length; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256 ((const __m256i *) (sink->data + i));
+        __m256i hits = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (block, colon),
+                                                         _mm256_cmpeq_epi8 (block, comma)),
+                                        _mm256_cmpeq_epi8 (block, newline));
+
+        if (!EmitMask (sink, (uint32_t) _mm256_movemask_epi8 (hits), i))
+            return 0;
+    }
+
+    return ScanScalar (sink, i, length);
+}
+#endif
+
+int field_scan_is_supported (FieldScanImpl impl)
+{
+    switch (impl)
+    {
+    case FIELD_SCAN_AUTO:
+    case FIELD_SCAN_SCALAR:
+        return 1;
+#ifdef FIELD_SCAN_X86
+    case FIELD_SCAN_SSE2:
+        __builtin_cpu_init ();
+        return __builtin_cpu_supports ("sse2");
+    case FIELD_SCAN_AVX2:
+        __builtin_cpu_init ();
+        return __builtin_cpu_supports ("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+const char *field_scan_impl_name (FieldScanImpl impl)
+{
+    static const char *names[FIELD_SCAN_N_IMPLS] = { "auto", "scalar", "sse2", "avx2" };
+
+    return impl < FIELD_SCAN_N_IMPLS ? names[impl] : "unknown";
+}
+
+static FieldScanImpl ResolveAuto (void)
+{
+#ifdef FIELD_SCAN_X86
+    static int resolved = -1;
+    int impl = __atomic_load_n (&resolved, __ATOMIC_RELAXED);
+
+    if (impl < 0)
+    {
+        if (field_scan_is_supported (FIELD_SCAN_AVX2))
+            impl = FIELD_SCAN_AVX2;
+        else if (field_scan_is_supported (FIELD_SCAN_SSE2))
+            impl = FIELD_SCAN_SSE2;
+        else
+            impl = FIELD_SCAN_SCALAR;
+        __atomic_store_n (&resolved, impl, __ATOMIC_RELAXED);
+    }
+
+    return (FieldScanImpl) impl;
+#else
+    return FIELD_SCAN_SCALAR;
+#endif
+}
+
+/*
+ * Stores the offsets of the separators in data[0..length) in order and
+ * returns how many. If they do not all fit in max_offsets, stops after
+ * the last whole line that does; *scanned says how many bytes the
+ * offsets cover, so the next call starts there. A first line with more
+ * separators than max_offsets gives 0 and *scanned 0.
+ */
+size_t field_scan_with (FieldScanImpl  impl,
+                        const char    *data,
+                        size_t         length,
+                        uint32_t      *offsets,
+                        size_t         max_offsets,
+                        size_t        *scanned)
+{
+    Sink sink = { data, offsets, max_offsets, 0, 0, 0 };
+    int complete;
+    int clamped = 0;
+
+    /* Offsets are 32 bits wide */
+    if (length > UINT32_MAX)
+    {
+        length = UINT32_MAX;
+        clamped = 1;
+    }
+    if (impl == FIELD_SCAN_AUTO)
+        impl = ResolveAuto ();
+
+    switch (impl)
+    {
+#ifdef FIELD_SCAN_X86
+    case FIELD_SCAN_SSE2:
+        complete = ScanSse2 (&sink, length);
+        break;
+    case FIELD_SCAN_AVX2:
+        complete = ScanAvx2 (&sink, length);
+        break;
+#endif
+    default:
+        complete = ScanScalar (&sink, 0, length);
+        break;
+    }
+
+    if (complete && !clamped)
+    {
+        *scanned = length;
+        return sink.n;
+    }
+    *scanned = sink.line_end;
+
+    return sink.n_lines;
+}
+
+size_t field_scan (const char *data,
+                   size_t      length,
+                   uint32_t   *offsets,
+                   size_t      max_offsets,
+                   size_t     *scanned)
+{
+    return field_scan_with (FIELD_SCAN_AUTO, data, length, offsets, max_offsets, scanned);
+}
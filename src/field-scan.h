@@ -0,0 +1,47 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __FIELD_SCAN_H__
+#define __FIELD_SCAN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Finds the ':', ',' and '\n' bytes that delimit fields in passwd and
+ * group files. Plain C so the benchmarks can link it on its own. */
+
+typedef enum
+{
+    FIELD_SCAN_AUTO,
+    FIELD_SCAN_SCALAR,
+    FIELD_SCAN_SSE2,
+    FIELD_SCAN_AVX2,
+    FIELD_SCAN_N_IMPLS
+} FieldScanImpl;
+
+size_t       field_scan                (const char    *data,
+                                        size_t         length,
+                                        uint32_t      *offsets,
+                                        size_t         max_offsets,
+                                        size_t        *scanned);
+size_t       field_scan_with           (FieldScanImpl  impl,
+                                        const char    *data,
+                                        size_t         length,
+                                        uint32_t      *offsets,
+                                        size_t         max_offsets,
+                                        size_t        *scanned);
+int          field_scan_is_supported   (FieldScanImpl  impl);
+const char * field_scan_impl_name      (FieldScanImpl  impl);
+
+#endif /* __FIELD_SCAN_H__ */
@@ -0,0 +1,170 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+
+#include "gid-map.h"
+
+/*
+ * Occupancy bitmap over the 32-bit gid space. Gids cluster (system range,
+ * user range, a directory's block), so the bitmap is split into pages of
+ * GID_PAGE_BITS that only exist once a gid in them is taken. A missing
+ * page is entirely free and a full page is skipped by its count, so a
+ * search only scans words of partially used pages.
+ */
+
+#define GID_PAGE_BITS  4096
+#define GID_PAGE_WORDS (GID_PAGE_BITS / 64)
+
+typedef struct
+{
+    guint   used;
+    guint64 words[GID_PAGE_WORDS];
+} GidPage;
+
+struct GidMap
+{
+    GHashTable *pages;      /* page index -> GidPage */
+    guint       size;
+};
+
+GidMap *gid_map_new (void)
+{
+    GidMap *map;
+
+    map = g_new0 (GidMap, 1);
+    map->pages = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+    return map;
+}
+
+void gid_map_free (GidMap *map)
+{
+    g_hash_table_destroy (map->pages);
+    g_free (map);
+}
+
+static GidPage *gid_map_get_page (GidMap *map, guint index)
+{
+    return g_hash_table_lookup (map->pages, GUINT_TO_POINTER (index));
+}
+
+void gid_map_set (GidMap *map, gid_t gid)
+{
+    guint    index = gid / GID_PAGE_BITS;
+    guint    bit = gid % GID_PAGE_BITS;
+    guint64  mask = G_GUINT64_CONSTANT (1) << (bit % 64);
+    GidPage *page;
+
+    page = gid_map_get_page (map, index);
+    if (page == NULL)
+    {
+        page = g_new0 (GidPage, 1);
+        g_hash_table_insert (map->pages, GUINT_TO_POINTER (index), page);
+    }
+    if ((page->words[bit / 64] & mask) == 0)
+    {
+        page->words[bit / 64] |= mask;
+        page->used++;
+        map->size++;
+    }
+}
+
+void gid_map_clear (GidMap *map, gid_t gid)
+{
+    guint    index = gid / GID_PAGE_BITS;
+    guint    bit = gid % GID_PAGE_BITS;
+    guint64  mask = G_GUINT64_CONSTANT (1) << (bit % 64);
+    GidPage *page;
+
+    page = gid_map_get_page (map, index);
+    if (page == NULL || (page->words[bit / 64] & mask) == 0)
+    {
+        return;
+    }
+    page->words[bit / 64] &= ~mask;
+    page->used--;
+    map->size--;
+    if (page->used == 0)
+    {
+        g_hash_table_remove (map->pages, GUINT_TO_POINTER (index));
+    }
+}
+
+gboolean gid_map_test (GidMap *map, gid_t gid)
+{
+    guint    bit = gid % GID_PAGE_BITS;
+    GidPage *page;
+
+    page = gid_map_get_page (map, gid / GID_PAGE_BITS);
+    return page != NULL &&
+           (page->words[bit / 64] & (G_GUINT64_CONSTANT (1) << (bit % 64))) != 0;
+}
+
+/* Lowest free gid in [first, last], if any */
+gboolean gid_map_find_free (GidMap *map,
+                            gid_t   first,
+                            gid_t   last,
+                            gid_t  *gid)
+{
+    guint64 next = first;
+
+    while (next <= last)
+    {
+        guint    index = next / GID_PAGE_BITS;
+        guint    word = (next % GID_PAGE_BITS) / 64;
+        guint64  base = (guint64) index * GID_PAGE_BITS;
+        GidPage *page;
+        guint64  free_bits;
+
+        page = gid_map_get_page (map, index);
+        if (page == NULL)
+        {
+            *gid = next;
+            return TRUE;
+        }
+        if (page->used == GID_PAGE_BITS)
+        {
+            next = base + GID_PAGE_BITS;
+            continue;
+        }
+
+        free_bits = ~page->words[word] & (G_MAXUINT64 << (next % 64));
+        while (free_bits == 0 && ++word < GID_PAGE_WORDS)
+        {
+            free_bits = ~page->words[word];
+        }
+        if (free_bits == 0)
+        {
+            next = base + GID_PAGE_BITS;
+            continue;
+        }
+        next = base + word * 64 + __builtin_ctzll (free_bits);
+        if (next > last)
+        {
+            return FALSE;
+        }
+        *gid = next;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+guint gid_map_size (GidMap *map)
+{
+    return map->size;
+}
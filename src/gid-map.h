@@ -0,0 +1,41 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __GID_MAP_H__
+#define __GID_MAP_H__
+
+#include <sys/types.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct GidMap GidMap;
+
+GidMap *      gid_map_new            (void);
+void          gid_map_free           (GidMap      *map);
+void          gid_map_set            (GidMap      *map,
+                                      gid_t        gid);
+void          gid_map_clear          (GidMap      *map,
+                                      gid_t        gid);
+gboolean      gid_map_test           (GidMap      *map,
+                                      gid_t        gid);
+gboolean      gid_map_find_free      (GidMap      *map,
+                                      gid_t        first,
+                                      gid_t        last,
+                                      gid_t       *gid);
+guint         gid_map_size           (GidMap      *map);
+
+G_END_DECLS
+
+#endif /* __GID_MAP_H__ */
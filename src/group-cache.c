@@ -0,0 +1,131 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "group-cache.h"
+
+/*
+ * On-disk copy of the parsed local groups, written when the daemon exits
+ * so the next activation can skip parsing passwd and group. The file is a
+ * serialized GVariant:
+ *
+ *   (u version, a(ttt) source stamps, t generation, a(subsas) entries)
+ *
+ * A stamp is (mtime in usec, size, inode) of each source file. The
+ * daemon takes the stamps before it parses, so an edit racing with the
+ * parse leaves an older stamp behind and the next start parses again.
+ * Entries are only trusted if every stamp still matches; the generation
+ * is returned either way so it never goes backwards across restarts.
+ */
+
+#define GROUP_CACHE_VERSION 2
+#define GROUP_CACHE_TYPE    "(ua(ttt)t" GROUP_CACHE_ENTRIES_TYPE ")"
+
+GVariant *group_cache_stamp (const gchar * const *sources)
+{
+    GVariantBuilder builder;
+    guint i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ttt)"));
+    for (i = 0; sources[i] != NULL; i++)
+    {
+        GStatBuf st;
+
+        if (g_stat (sources[i], &st) < 0)
+        {
+            memset (&st, 0, sizeof (st));
+        }
+        g_variant_builder_add (&builder, "(ttt)",
+                               (guint64) st.st_mtim.tv_sec * G_USEC_PER_SEC +
+                               st.st_mtim.tv_nsec / 1000,
+                               (guint64) st.st_size,
+                               (guint64) st.st_ino);
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+/* Returns the cached entries if they are still current, otherwise NULL.
+ * generation is set whenever a cache of this version could be read. */
+GVariant *group_cache_load (const gchar *path,
+                            GVariant    *stamps,
+                            guint64     *generation)
+{
+    g_autoptr(GMappedFile) file = NULL;
+    g_autoptr(GVariant) cache = NULL;
+    g_autoptr(GVariant) cached_stamps = NULL;
+    g_autoptr(GBytes) bytes = NULL;
+    GVariant *entries;
+    guint32 version;
+
+    file = g_mapped_file_new (path, FALSE, NULL);
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    bytes = g_mapped_file_get_bytes (file);
+    cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (GROUP_CACHE_TYPE),
+                                                          bytes, FALSE));
+    g_variant_get (cache, "(u@a(ttt)t@" GROUP_CACHE_ENTRIES_TYPE ")",
+                   &version, &cached_stamps, generation, &entries);
+    if (version != GROUP_CACHE_VERSION)
+    {
+        *generation = 0;
+        g_variant_unref (entries);
+        return NULL;
+    }
+
+    if (!g_variant_equal (stamps, cached_stamps))
+    {
+        g_variant_unref (entries);
+        return NULL;
+    }
+
+    return entries;
+}
+
+gboolean group_cache_save (const gchar *path,
+                           GVariant    *stamps,
+                           guint64      generation,
+                           GVariant    *entries,
+                           GError     **error)
+{
+    g_autoptr(GVariant) cache = NULL;
+    g_autofree gchar *dir = NULL;
+
+    dir = g_path_get_dirname (path);
+    if (g_mkdir_with_parents (dir, 0755) < 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to create %s: %s", dir, g_strerror (errno));
+        return FALSE;
+    }
+
+    cache = g_variant_ref_sink (g_variant_new ("(u@a(ttt)t@" GROUP_CACHE_ENTRIES_TYPE ")",
+                                               GROUP_CACHE_VERSION,
+                                               stamps,
+                                               generation,
+                                               entries));
+
+    return g_file_set_contents (path,
+                                g_variant_get_data (cache),
+                                g_variant_get_size (cache),
+                                error);
+}
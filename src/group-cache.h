@@ -0,0 +1,38 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __GROUP_CACHE_H__
+#define __GROUP_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* One entry per cached group: name, gid, primary, the primary user standing
+ * in for an empty member list or "", members */
+#define GROUP_CACHE_ENTRIES_TYPE "a(subsas)"
+
+GVariant *   group_cache_stamp     (const gchar * const *sources);
+GVariant *   group_cache_load      (const gchar         *path,
+                                    GVariant            *stamps,
+                                    guint64             *generation);
+gboolean     group_cache_save      (const gchar         *path,
+                                    GVariant            *stamps,
+                                    guint64              generation,
+                                    GVariant            *entries,
+                                    GError             **error);
+
+G_END_DECLS
+
+#endif /* __GROUP_CACHE_H__ */
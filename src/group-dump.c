@@ -0,0 +1,293 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "group-dump.h"
+#include "json-variant.h"
+#include "snapshot-reader.h"
+
+/*
+ * Writes the whole group table into a file descriptor the caller passed
+ * in. The work happens on a GTask worker against a private mapping of
+ * the table, so the main loop neither serializes a huge message nor
+ * blocks on a slow pipe, and changes made meanwhile do not tear the
+ * output. Both descriptors belong to the task and are closed when it
+ * finishes. The caller's descriptor is never switched to blocking: the
+ * worker writes without waiting and polls between writes, so a reader
+ * that stalls or a cancel ends the dump instead of pinning a thread.
+ */
+
+#define GROUP_DUMP_CHUNK (64 * 1024)
+/* Longest a reader may leave the pipe full */
+#define GROUP_DUMP_STALL_MSEC (30 * 1000)
+
+typedef struct
+{
+    gint            table_fd;
+    gint            out_fd;
+    gboolean        is_socket;
+    GroupDumpFormat format;
+    guint           n_groups;
+} GroupDump;
+
+static void GroupDumpFree (GroupDump *dump)
+{
+    if (dump->table_fd >= 0)
+        close (dump->table_fd);
+    if (dump->out_fd >= 0)
+        close (dump->out_fd);
+    g_free (dump);
+}
+
+gboolean group_dump_parse_format (const gchar *name, GroupDumpFormat *format)
+{
+    if (g_strcmp0 (name, "binary") == 0)
+        *format = GROUP_DUMP_BINARY;
+    else if (g_strcmp0 (name, "json") == 0)
+        *format = GROUP_DUMP_JSON;
+    else
+        return FALSE;
+
+    return TRUE;
+}
+
+/* O_NONBLOCK belongs to the open file the caller shares with us, so a
+ * blocking pipe or terminal is reopened through /proc for a description
+ * of our own and a socket is written with MSG_DONTWAIT. Regular files
+ * never wait for a reader and are written as they are. */
+static gboolean PrepareOutput (GroupDump *dump, GError **error)
+{
+    g_autofree gchar *Path = NULL;
+    struct stat st;
+    gint flags, fd;
+
+    flags = fcntl (dump->out_fd, F_GETFL);
+    if (flags < 0 || fstat (dump->out_fd, &st) < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Unable to inspect the dump descriptor: %s", g_strerror (errno));
+        return FALSE;
+    }
+    if (S_ISSOCK (st.st_mode))
+    {
+        dump->is_socket = TRUE;
+        return TRUE;
+    }
+    if ((flags & O_NONBLOCK) || S_ISREG (st.st_mode))
+    {
+        return TRUE;
+    }
+    Path = g_strdup_printf ("/proc/self/fd/%d", dump->out_fd);
+    fd = open (Path, O_WRONLY | O_NONBLOCK | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Unable to reopen the dump descriptor: %s", g_strerror (errno));
+        return FALSE;
+    }
+    close (dump->out_fd);
+    dump->out_fd = fd;
+
+    return TRUE;
+}
+
+/* Waits until fd takes more data, the task is cancelled or the reader
+ * has stalled for too long */
+static gboolean WaitWritable (gint fd, GCancellable *cancellable, GError **error)
+{
+    struct pollfd fds[2];
+    nfds_t n = 1;
+    int ret;
+
+    fds[0].fd = fd;
+    fds[0].events = POLLOUT;
+    if (g_cancellable_make_pollfd (cancellable, &fds[1]))
+    {
+        n = 2;
+    }
+    do
+    {
+        ret = poll (fds, n, GROUP_DUMP_STALL_MSEC);
+    } while (ret < 0 && errno == EINTR);
+    if (n == 2)
+    {
+        g_cancellable_release_fd (cancellable);
+    }
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return FALSE;
+    if (ret == 0)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                     "The reader took nothing for %d seconds", GROUP_DUMP_STALL_MSEC / 1000);
+        return FALSE;
+    }
+    if (ret < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Unable to wait for the reader: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean WriteAll (GroupDump    *dump,
+                          const guint8 *data,
+                          gsize         length,
+                          GCancellable *cancellable,
+                          GError      **error)
+{
+    while (length > 0)
+    {
+        gssize n;
+
+        if (dump->is_socket)
+            n = send (dump->out_fd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        else
+            n = write (dump->out_fd, data, length);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (!WaitWritable (dump->out_fd, cancellable, error))
+                    return FALSE;
+                continue;
+            }
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                         "Unable to write the dump: %s", g_strerror (errno));
+            return FALSE;
+        }
+        data += n;
+        length -= n;
+    }
+
+    return TRUE;
+}
+
+static gboolean WriteJson (GroupDump *dump, const GsSnapshot *map, GCancellable *cancellable, GError **error)
+{
+    g_autoptr(GString) out = g_string_sized_new (GROUP_DUMP_CHUNK + 4096);
+    const GsSnapshotGroup *group;
+    guint32 i, j;
+
+    for (i = 0; (group = gs_snapshot_get_group (map, i)) != NULL; i++)
+    {
+        g_string_append (out, "{\"name\":");
+        json_append_string (out, gs_snapshot_group_name (map, group));
+        g_string_append_printf (out, ",\"gid\":%u,\"members\":[", group->gid);
+        for (j = 0; j < group->n_members; j++)
+        {
+            if (j > 0)
+                g_string_append_c (out, ',');
+            json_append_string (out, gs_snapshot_group_member (map, group, j));
+        }
+        g_string_append (out, "]}\n");
+        dump->n_groups++;
+
+        if (out->len >= GROUP_DUMP_CHUNK)
+        {
+            if (g_cancellable_set_error_if_cancelled (cancellable, error) ||
+                !WriteAll (dump, (const guint8 *) out->str, out->len, cancellable, error))
+                return FALSE;
+            g_string_truncate (out, 0);
+        }
+    }
+
+    return WriteAll (dump, (const guint8 *) out->str, out->len, cancellable, error);
+}
+
+static void DumpThread (GTask        *task,
+                        gpointer      source,
+                        gpointer      data,
+                        GCancellable *cancellable)
+{
+    GroupDump *dump = data;
+    GError *error = NULL;
+    GsSnapshot map;
+    gboolean ok;
+    int ret;
+
+    if (!PrepareOutput (dump, &error))
+    {
+        g_task_return_error (task, error);
+        return;
+    }
+    ret = gs_snapshot_map (dump->table_fd, &map);
+    if (ret < 0)
+    {
+        g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (-ret),
+                                 "Unable to map the group table: %s", g_strerror (-ret));
+        return;
+    }
+    if (dump->format == GROUP_DUMP_BINARY)
+    {
+        ok = WriteAll (dump, map.base, map.header->size, cancellable, &error);
+        dump->n_groups = map.header->n_groups;
+    }
+    else
+    {
+        ok = WriteJson (dump, &map, cancellable, &error);
+    }
+    gs_snapshot_unmap (&map);
+
+    if (!ok)
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+}
+
+void group_dump_async (gint                table_fd,
+                       gint                out_fd,
+                       GroupDumpFormat     format,
+                       GCancellable       *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer            user_data)
+{
+    g_autoptr(GTask) task = NULL;
+    GroupDump *dump;
+
+    dump = g_new0 (GroupDump, 1);
+    dump->table_fd = table_fd;
+    dump->out_fd = out_fd;
+    dump->format = format;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_task_data (task, dump, (GDestroyNotify) GroupDumpFree);
+    g_task_run_in_thread (task, DumpThread);
+}
+
+gboolean group_dump_finish (GAsyncResult *result, guint *n_groups, GError **error)
+{
+    GroupDump *dump = g_task_get_task_data (G_TASK (result));
+
+    if (!g_task_propagate_boolean (G_TASK (result), error))
+    {
+        return FALSE;
+    }
+    *n_groups = dump->n_groups;
+
+    return TRUE;
+}
@@ -0,0 +1,42 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __GROUP_DUMP_H__
+#define __GROUP_DUMP_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    GROUP_DUMP_BINARY,      /* the table itself, see snapshot-format.h */
+    GROUP_DUMP_JSON,        /* one JSON object per line */
+} GroupDumpFormat;
+
+gboolean group_dump_parse_format (const gchar         *name,
+                                  GroupDumpFormat     *format);
+void     group_dump_async        (gint                 table_fd,
+                                  gint                 out_fd,
+                                  GroupDumpFormat      format,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data);
+gboolean group_dump_finish       (GAsyncResult        *result,
+                                  guint               *n_groups,
+                                  GError             **error);
+
+G_END_DECLS
+
+#endif /* __GROUP_DUMP_H__ */
@@ -25,13 +25,36 @@
 #include <grp.h>
 #include <stdio.h>
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <polkit/polkit.h>
 #include "group-server.h"
+#include "account-file.h"
+#include "group-stats-generated.h"
+#include "gid-map.h"
+#include "member-matrix.h"
+#include "group-dump.h"
+#include "group-watch.h"
+#include "group-cache.h"
+#include "negative-cache.h"
+#include "nss-enumerator.h"
+#include "peer-server.h"
+#include "probes.h"
+#include "scheduler.h"
+#include "snapshot-file.h"
+#include "snapshot-format.h"
+#include "stats.h"
+#include "userdb-server.h"
 
 #define PATH_PASSWD "/etc/passwd"
 #define PATH_SHADOW "/etc/shadow"
 #define PATH_GROUP  "/etc/group"
+#define PATH_LOGIN_DEFS "/etc/login.defs"
+#define PATH_GROUP_CACHE LOCALSTATEDIR "/cache/group-service/groups.cache"
+
+#define NSS_MAX_PAGES 4
+#define NEGATIVE_CACHE_SIZE 4096
 
 enum
 {
@@ -43,20 +66,70 @@ struct ManagePrivate
 {
     GDBusConnection *BusConnection;
     GHashTable   *GroupsHashTable;
+    GHashTable   *GroupsByPath;
     GFileMonitor *PasswdMonitor;
     GFileMonitor *ShadowMonitor;
     GFileMonitor *GroupMonitor;
     guint         ReloadId;
+    guint64       Generation;
+    NamePool     *Names;
+    gsize         SnapshotBytes;
+    UserGroupStats *Stats;
     PolkitAuthority *Authority;
+    gchar        *PathPasswd;
+    gchar        *PathShadow;
+    gchar        *PathGroup;
+    NssEnumerator *Nss;
+    GidMap       *Gids;
+    gid_t         SysGidMin;
+    gid_t         SysGidMax;
+    gid_t         GidMin;
+    gid_t         GidMax;
+    NegativeCache *Missing;
+    guint         NssGroups;
+    gchar        *PathCache;
+    GVariant     *CacheStamps;
+    gboolean      Loaded;
+    gint64        StartTime;
+    SnapshotFile *Published;
+    gchar        *PathSnapshot;
+    guint         PublishId;
+    UserdbServer *Userdb;
+    PeerServer   *Peers;
+    GroupWatches *Watches;
+    Scheduler    *Scheduler;
+    guint         Dumps;
 
 };
 
-typedef struct group * (* GroupEntryGeneratorFunc) (FILE *);
+/* Prefix for the account files, so the daemon can serve a fixture tree */
+static gchar *ConfigRoot = NULL;
+static gchar *ManageBuildPath (const gchar *path);
+/* Mutations between dispatch and reply, and starts per caller per second
+ * with 0 for no limit */
+static guint MaxMutations = 4;
+static guint MutationRate = 0;
+/* Entries per page of the background NSS walk, 0 leaves it off */
+static guint NssPageSize = 0;
+/* How long a failed NSS lookup is trusted, 0 disables the cache */
+static guint NegativeTtl = 30;
+/* Where the parsed groups are kept between runs, NULL for the default */
+static gchar *CachePath = NULL;
+/* Where the table is published for the NSS module, "" turns it off */
+static gchar *SnapshotPath = NULL;
+/* Varlink socket for systemd-userdbd, off unless asked for; NULL path
+ * is the standard one below the root */
+static gboolean UserdbEnabled = FALSE;
+static gchar *UserdbPath = NULL;
+/* Socket for direct D-Bus connections, NULL leaves it off */
+static gchar *PeerPath = NULL;
+
 typedef void  ( FileChangeCallback )(GFileMonitor *,
                                      GFile        *,
                                      GFile        *,
                                      GFileMonitorEvent,
                                      Manage       *);
+
 static void manage_user_group_admin_iface_init (UserGroupAdminIface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (Manage,manage, USER_GROUP_TYPE_ADMIN_SKELETON,
@@ -97,6 +170,8 @@ void DbusPrintf (GDBusMethodInvocation *Invocation,
     va_start (args, format);
     Message = g_strdup_vprintf (format, args);
     va_end (args);
+    stats_method_failed (Invocation);
+    stats_method_reply (Invocation);
     g_dbus_method_invocation_return_error (Invocation, ERROR, ErrorCode, "%s", Message);
 }
 
@@ -108,45 +183,69 @@ static GHashTable * CreateGroupsHashTable (void)
                                   g_object_unref);
 }
 
-static struct group * entry_generator_fgetgrent (FILE *fd)
+/* Borrowed index over GroupsHashTable, rebuilt whenever the table is replaced */
+static GHashTable * CreateGroupsByPath (GHashTable *groups)
 {
-    struct group *grent;
+    GHashTable    *GroupsByPath;
+    GHashTableIter iter;
+    gpointer       value;
 
-    grent = fgetgrent (fd);
-    if (grent != NULL)
+    GroupsByPath = g_hash_table_new (g_str_hash, g_str_equal);
+    g_hash_table_iter_init (&iter, groups);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
     {
-        return grent;
+        g_hash_table_insert (GroupsByPath,
+                             (gpointer) group_get_object_path (value),
+                             value);
     }
-    fclose (fd);
-    return NULL;
+
+    return GroupsByPath;
+}
+
+/* A known group that an outside edit moved to another gid. Its object
+ * path follows the gid, so the reload re-exports it like ManageGroupEdited
+ * does for the daemon's own edits. */
+typedef struct
+{
+    Group *group;
+    gchar *OldPath;
+} MovedGroup;
+
+static void MovedGroupFree (MovedGroup *moved)
+{
+    g_object_unref (moved->group);
+    g_free (moved->OldPath);
+    g_free (moved);
 }
 
-static void LoadGroupEntries (GHashTable *groups,
-                              GroupEntryGeneratorFunc EntryGenerator,
-                              Manage *manage)
+static guint LoadGroupEntries (GHashTable *groups,
+                               GroupSnapshot *snapshot,
+                               AccountFile *GroupFile,
+                               GHashTable *PrimaryUsers,
+                               GPtrArray *Moved,
+                               Manage *manage)
 {
     struct group *grent;
+    const GroupRecord *record;
     Group *group = NULL;
-    FILE *fd;
+    const gchar *PrimaryUser;
+    guint Changes = 0;
+    guint i;
+    gint64 Start;
 
     ManagePrivate *priv = manage_get_instance_private (manage);
-    fd = fopen (PATH_GROUP, "r");
-    if(fd == NULL)
-    {
-        return;
-    }
-
-    while(1)
+    Start = g_get_monotonic_time ();
+    GS_PROBE (load__entries__start);
+    for (i = 0; i < account_file_get_size (GroupFile); i++)
     {
-        grent = EntryGenerator (fd);
-        if (grent == NULL)
-        {
-            break;
-        }
+        grent = account_file_get_group (GroupFile, i);
         group = g_hash_table_lookup (groups, grent->gr_name);
         if(group == NULL)
         {
+            gboolean Known;
+
             group = g_hash_table_lookup(priv->GroupsHashTable,grent->gr_name);
+            Known = group != NULL;
             if(group == NULL)
             {
                 group = group_new (manage,grent->gr_gid);
@@ -156,113 +255,472 @@ static void LoadGroupEntries (GHashTable *groups,
                 g_object_ref (group);
             }
             g_object_freeze_notify (G_OBJECT (group));
-            group_update_from_grent (group, grent);
+            PrimaryUser = g_hash_table_lookup (PrimaryUsers,
+                                               GUINT_TO_POINTER (grent->gr_gid));
+            record = group_snapshot_add_grent (snapshot, grent, PrimaryUser);
+            if (Known && group_get_gid (group) != grent->gr_gid)
+            {
+                MovedGroup *moved = g_new0 (MovedGroup, 1);
+
+                /* Watchers match the removal against the old gid */
+                group_watches_notify (priv->Watches, group, GROUP_WATCH_REMOVED);
+                UnRegisterGroup (manage, group);
+                moved->group = g_object_ref (group);
+                moved->OldPath = g_strdup (group_get_object_path (group));
+                g_ptr_array_add (Moved, moved);
+                group_bind_record (group, snapshot, record);
+                g_free (group->object_path);
+                group->object_path = compute_object_path (group);
+                Changes++;
+            }
+            else if (group_bind_record (group, snapshot, record))
+            {
+                Changes++;
+                /* New groups are announced once the table is swapped */
+                if (Known)
+                {
+                    group_watches_notify (priv->Watches, group, GROUP_WATCH_CHANGED);
+                }
+            }
             g_hash_table_insert (groups, g_strdup (group_get_group_name (group)), group);
         }
     }
+
+    GS_PROBE3 (load__entries__done,
+               group_snapshot_get_n_records (snapshot),
+               Changes,
+               g_get_monotonic_time () - Start);
+    return Changes;
 }
 
-static struct passwd *GetPwent(FILE *fd)
+/* Maps every gid that is some user's primary group to that user's gecos,
+ * so group entries can be resolved in a single pass over /etc/group. */
+static GHashTable *LoadPrimaryUsers (AccountFile *PasswdFile)
 {
+    GHashTable    *PrimaryUsers;
     struct passwd *pwent;
+    gint64         Start;
+    guint          i;
 
-    pwent = fgetpwent (fd);
-    if (pwent != NULL)
+    Start = g_get_monotonic_time ();
+    GS_PROBE (load__primary__start);
+    PrimaryUsers = g_hash_table_new_full (g_direct_hash,
+                                          g_direct_equal,
+                                          NULL,
+                                          g_free);
+    for (i = 0; i < account_file_get_size (PasswdFile); i++)
     {
-        return pwent;
+        pwent = account_file_get_passwd (PasswdFile, i);
+        g_hash_table_replace (PrimaryUsers,
+                              GUINT_TO_POINTER (pwent->pw_gid),
+                              g_strdup (pwent->pw_gecos));
     }
-    fclose (fd);
-    return NULL;
 
+    GS_PROBE2 (load__primary__done,
+               g_hash_table_size (PrimaryUsers),
+               g_get_monotonic_time () - Start);
+    return PrimaryUsers;
 }
-static void LoadPrimaryGroup (GHashTable *groups)
+
+static GidMap *CreateGidMap (GHashTable *groups)
 {
-    struct passwd *pwent;
-    struct group  *grent;
-    Group         *group = NULL;
-    FILE          *fd;
-    const gchar   *users[2];
+    GidMap        *Gids;
+    GHashTableIter iter;
+    gpointer       value;
+
+    Gids = gid_map_new ();
+    g_hash_table_iter_init (&iter, groups);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        gid_map_set (Gids, group_get_gid (value));
+    }
+
+    return Gids;
+}
 
-    fd = fopen (PATH_PASSWD, "r");
-    if(fd == NULL)
+/* The same ranges groupadd would use, so both pick from one pool */
+static void LoadGidRanges (Manage *manage)
+{
+    g_autofree gchar *Path = NULL;
+    g_autofree gchar *Contents = NULL;
+    g_auto(GStrv) Lines = NULL;
+    guint i;
+
+    manage->priv->SysGidMin = 101;
+    manage->priv->SysGidMax = 999;
+    manage->priv->GidMin = 1000;
+    manage->priv->GidMax = 60000;
+
+    Path = ManageBuildPath (PATH_LOGIN_DEFS);
+    if (!g_file_get_contents (Path, &Contents, NULL, NULL))
     {
         return;
     }
-    while(1)
+    Lines = g_strsplit (Contents, "\n", -1);
+    for (i = 0; Lines[i] != NULL; i++)
     {
-        pwent = GetPwent(fd);
-        if (pwent == NULL)
+        gchar   Key[32];
+        guint64 Value;
+
+        if (sscanf (Lines[i], " %31s %" G_GUINT64_FORMAT, Key, &Value) != 2 ||
+            Value > G_MAXUINT32)
         {
-            break;
+            continue;
         }
-        grent = getgrgid (pwent->pw_gid);
-        if(grent == NULL)
+        if (g_str_equal (Key, "SYS_GID_MIN"))
+            manage->priv->SysGidMin = Value;
+        else if (g_str_equal (Key, "SYS_GID_MAX"))
+            manage->priv->SysGidMax = Value;
+        else if (g_str_equal (Key, "GID_MIN"))
+            manage->priv->GidMin = Value;
+        else if (g_str_equal (Key, "GID_MAX"))
+            manage->priv->GidMax = Value;
+    }
+}
+
+NamePool *ManageGetNamePool (Manage *manage)
+{
+    return manage->priv->Names;
+}
+
+guint64 ManageGetGeneration (Manage *manage)
+{
+    return manage->priv->Generation;
+}
+
+/* First load only: takes the groups from the cache written by the last
+ * run if passwd and group are untouched since. The generation is carried
+ * over either way, so clients never see it go backwards. */
+static gboolean LoadCachedEntries (GHashTable    *groups,
+                                   GroupSnapshot *snapshot,
+                                   Manage        *manage)
+{
+    ManagePrivate *priv = manage->priv;
+    g_autoptr(GVariant) Entries = NULL;
+    GVariantIter iter;
+    const gchar *Name;
+    const gchar *PrimaryUser;
+    const gchar **Members;
+    guint32 Gid;
+    gboolean Primary;
+    guint64 Generation = 0;
+
+    Entries = group_cache_load (priv->PathCache, priv->CacheStamps, &Generation);
+    priv->Generation = MAX (priv->Generation, Generation);
+    /* Only a clean exit writes it back, so after a crash the next start
+     * finds none and seeds the generation past anything handed out */
+    g_unlink (priv->PathCache);
+    if (Entries == NULL)
+    {
+        return FALSE;
+    }
+
+    g_variant_iter_init (&iter, Entries);
+    while (g_variant_iter_next (&iter, "(&sub&s^a&s)", &Name, &Gid, &Primary, &PrimaryUser, &Members))
+    {
+        const GroupRecord *record;
+        Group *group;
+
+        if (!g_hash_table_contains (groups, Name))
         {
-            continue;
+            group = group_new (manage, Gid);
+            g_object_freeze_notify (G_OBJECT (group));
+            if (PrimaryUser[0] != '\0')
+            {
+                struct group grent = { (gchar *) Name, NULL, Gid, (gchar **) Members };
+
+                record = group_snapshot_add_grent (snapshot, &grent, PrimaryUser);
+            }
+            else
+            {
+                record = group_snapshot_add (snapshot, Name, Gid, Primary, Members);
+            }
+            group_bind_record (group, snapshot, record);
+            /* Unchanged since the cache was written, at that generation */
+            user_group_list_set_revision (USER_GROUP_LIST (group), priv->Generation);
+            g_hash_table_insert (groups, g_strdup (Name), group);
         }
-        group = g_hash_table_lookup (groups, grent->gr_name);
-        if(group == NULL)
+        g_free (Members);
+    }
+
+    return TRUE;
+}
+
+void ManageSaveCache (Manage *manage)
+{
+    ManagePrivate *priv = manage->priv;
+    g_autoptr(GError) error = NULL;
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer value;
+
+    if (priv->CacheStamps == NULL)
+    {
+        return;
+    }
+    g_variant_builder_init (&builder, G_VARIANT_TYPE (GROUP_CACHE_ENTRIES_TYPE));
+    g_hash_table_iter_init (&iter, priv->GroupsHashTable);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        static const gchar *const NoUsers[] = { NULL };
+        Group *group = value;
+        g_autofree const gchar **Members = NULL;
+        const gchar *const *Users;
+        const gchar *PrimaryUser = "";
+
+        if (!group_get_local_group (group))
         {
             continue;
         }
-        g_object_freeze_notify (G_OBJECT (group));
-        if(grent->gr_mem[0] == NULL)
+
+        Members = group_get_users (group);
+        Users = Members;
+        /* Keep the stand-in apart so a warm start publishes the same
+         * member lists as a cold one */
+        if (group->record->primary_member && Users[0] != NULL)
         {
-            users[0] = g_strdup(pwent->pw_gecos);
-            users[1] = NULL;
-            user_group_list_set_users(USER_GROUP_LIST(group),users);
-            g_free((gpointer)users[0]);
+            PrimaryUser = Users[0];
+            Users = NoUsers;
         }
-        user_group_list_set_primary_group(USER_GROUP_LIST(group), TRUE);
-        g_object_thaw_notify (G_OBJECT (group));
+        g_variant_builder_add (&builder, "(sub&s^as)",
+                               group_get_group_name (group),
+                               (guint32) group->record->gid,
+                               group->record->primary,
+                               PrimaryUser,
+                               Users);
+    }
+
+    if (!group_cache_save (priv->PathCache,
+                           priv->CacheStamps,
+                           priv->Generation,
+                           g_variant_builder_end (&builder),
+                           &error))
+    {
+        g_warning ("Unable to save %s: %s", priv->PathCache, error->message);
+    }
+}
+
+/* Nothing pending, no call in flight and no activity for seconds */
+gboolean ManageIsIdle (Manage *manage, guint seconds)
+{
+    ManagePrivate *priv = manage->priv;
+    gint64 LastActivity;
+
+    if (stats_get_in_flight () > 0 || priv->ReloadId > 0 || priv->Nss != NULL ||
+        (priv->Peers != NULL && peer_server_get_n_peers (priv->Peers) > 0) ||
+        (priv->Userdb != NULL && userdb_server_get_n_clients (priv->Userdb) > 0) ||
+        group_watches_get_n_watches (priv->Watches) > 0)
+    {
+        return FALSE;
+    }
+    LastActivity = MAX (stats_get_last_activity (), priv->StartTime);
+
+    return g_get_monotonic_time () - LastActivity >= (gint64) seconds * G_USEC_PER_SEC;
+}
+
+static void QueuePublishSnapshot (Manage *manage);
+
+void ManageBumpGeneration (Manage *manage)
+{
+    manage->priv->Generation++;
+    /* Mapped clients find out through the header, the next OpenSnapshot
+     * builds a fresh table */
+    if (manage->priv->Published != NULL)
+    {
+        snapshot_file_retire (manage->priv->Published, manage->priv->Generation);
+        g_clear_pointer (&manage->priv->Published, snapshot_file_free);
     }
+    QueuePublishSnapshot (manage);
+    user_group_admin_set_generation (USER_GROUP_ADMIN (manage),
+                                     manage->priv->Generation);
 }
 
 static void ReloadGroups (Manage *manage)
 {
     GHashTable     *GroupsHashTable;
+    GHashTable     *PrimaryUsers;
+    AccountFile    *GroupFile;
+    AccountFile    *PasswdFile;
+    GroupSnapshot  *Snapshot;
     GHashTableIter iter;
     GHashTable    *OldGroups;
+    GPtrArray     *Removed;
+    GPtrArray     *Added;
+    GPtrArray     *Moved;
     gpointer       name,value;
-
+    guint          Changes = 0;
+    guint          i;
+    gint64         Start, PhaseStart, Now;
+    gboolean       Warm = FALSE;
+    const gchar   *Sources[] = { manage->priv->PathGroup, manage->priv->PathPasswd, NULL };
+
+    Start = PhaseStart = g_get_monotonic_time ();
+    GS_PROBE (reload__start);
+    /* Stamped before reading, so an edit during the parse is never cached
+     * as if it had been seen */
+    g_clear_pointer (&manage->priv->CacheStamps, g_variant_unref);
+    manage->priv->CacheStamps = g_variant_ref_sink (group_cache_stamp (Sources));
     GroupsHashTable = CreateGroupsHashTable ();
-    LoadGroupEntries(GroupsHashTable, entry_generator_fgetgrent,manage);
+    Snapshot = group_snapshot_new (manage->priv->Names);
+    Moved = g_ptr_array_new_with_free_func ((GDestroyNotify) MovedGroupFree);
+    if (!manage->priv->Loaded)
+    {
+        Warm = LoadCachedEntries (GroupsHashTable, Snapshot, manage);
+        stats_startup_set_warm (Warm);
+        manage->priv->Loaded = TRUE;
+        if (!Warm)
+        {
+            /* A run that crashed handed out generations its cache never
+             * recorded; move past them on the wall clock */
+            manage->priv->Generation = MAX (manage->priv->Generation,
+                                            (guint64) g_get_real_time ());
+        }
+    }
+    if (!Warm)
+    {
+        /* Both files are split and parsed on worker threads, only the
+         * merge into the table below runs here */
+        account_file_load_pair (manage->priv->PathGroup, manage->priv->PathPasswd,
+                                &GroupFile, &PasswdFile);
+        PrimaryUsers = LoadPrimaryUsers (PasswdFile);
+        Changes = LoadGroupEntries (GroupsHashTable,
+                                    Snapshot,
+                                    GroupFile,
+                                    PrimaryUsers,
+                                    Moved,
+                                    manage);
+        g_hash_table_destroy (PrimaryUsers);
+        account_file_free (PasswdFile);
+        account_file_free (GroupFile);
+    }
+    manage->priv->SnapshotBytes = group_snapshot_get_size (Snapshot);
+    /* Every group now holds its own reference on the new generation */
+    group_snapshot_unref (Snapshot);
+    Now = g_get_monotonic_time ();
+    stats_reload_phase (STATS_RELOAD_PARSE, Now - PhaseStart);
+    PhaseStart = Now;
+
     OldGroups = manage->priv->GroupsHashTable;
     manage->priv->GroupsHashTable = GroupsHashTable;
-    LoadPrimaryGroup(GroupsHashTable);
-
+    g_hash_table_destroy (manage->priv->GroupsByPath);
+    manage->priv->GroupsByPath = CreateGroupsByPath (GroupsHashTable);
+    /* Directory groups never appear in /etc/group, keep them unless a
+     * file entry has taken over their name or gid */
     g_hash_table_iter_init (&iter, OldGroups);
     while (g_hash_table_iter_next (&iter, &name,&value))
     {
-        Group *group = value;
-        Group *refreshed_group;
+        const gchar *ObjectPath = group_get_object_path (value);
 
-        refreshed_group = g_hash_table_lookup (GroupsHashTable,name);
-        if(!refreshed_group)
+        if (group_get_local_group (value) ||
+            g_hash_table_contains (GroupsHashTable, name) ||
+            g_hash_table_contains (manage->priv->GroupsByPath, ObjectPath))
         {
-            user_group_admin_emit_group_deleted (USER_GROUP_ADMIN(manage),
-                                             group_get_object_path (group));
-            UnRegisterGroup (manage,value);
+            continue;
+        }
+        g_object_freeze_notify (G_OBJECT (value));
+        g_hash_table_insert (GroupsHashTable, g_strdup (name), g_object_ref (value));
+        g_hash_table_insert (manage->priv->GroupsByPath, (gpointer) ObjectPath, value);
+    }
+    gid_map_free (manage->priv->Gids);
+    manage->priv->Gids = CreateGidMap (GroupsHashTable);
+    Now = g_get_monotonic_time ();
+    stats_reload_phase (STATS_RELOAD_INDEX, Now - PhaseStart);
+    PhaseStart = Now;
+
+    Removed = g_ptr_array_new ();
+    Added = g_ptr_array_new ();
+    g_hash_table_iter_init (&iter, OldGroups);
+    while (g_hash_table_iter_next (&iter, &name,&value))
+    {
+        if (g_hash_table_lookup (GroupsHashTable, name) == NULL)
+        {
+            g_ptr_array_add (Removed, value);
         }
     }
-
     g_hash_table_iter_init (&iter, GroupsHashTable);
     while (g_hash_table_iter_next (&iter, &name,&value))
     {
-        Group *group = value;
-        Group *stale_group;
-
-        stale_group = g_hash_table_lookup (OldGroups, name);
-
-        if (!stale_group)
+        if (g_hash_table_lookup (OldGroups, name) == NULL)
         {
-            user_group_admin_emit_group_added(USER_GROUP_ADMIN(manage),
-                                              group_get_object_path (group));
-            RegisterGroup (manage,value);
+            g_ptr_array_add (Added, value);
         }
-        g_object_thaw_notify (G_OBJECT (group));
     }
+    /* A warm start serves exactly what the last run published */
+    if (!Warm)
+    {
+        Changes += Removed->len + Added->len;
+    }
+    Now = g_get_monotonic_time ();
+    stats_reload_phase (STATS_RELOAD_DIFF, Now - PhaseStart);
+    PhaseStart = Now;
+
+    for (i = 0; i < Removed->len; i++)
+    {
+        UnRegisterGroup (manage, g_ptr_array_index (Removed, i));
+    }
+    for (i = 0; i < Added->len; i++)
+    {
+        RegisterGroup (manage, g_ptr_array_index (Added, i));
+    }
+    for (i = 0; i < Moved->len; i++)
+    {
+        RegisterGroup (manage, ((MovedGroup *) g_ptr_array_index (Moved, i))->group);
+    }
+    Now = g_get_monotonic_time ();
+    stats_reload_phase (STATS_RELOAD_EXPORT, Now - PhaseStart);
+    PhaseStart = Now;
+
+    for (i = 0; i < Removed->len; i++)
+    {
+        user_group_admin_emit_group_deleted (USER_GROUP_ADMIN(manage),
+                                             group_get_object_path (g_ptr_array_index (Removed, i)));
+        group_watches_notify (manage->priv->Watches, g_ptr_array_index (Removed, i),
+                              GROUP_WATCH_REMOVED);
+    }
+    for (i = 0; i < Added->len; i++)
+    {
+        user_group_admin_emit_group_added (USER_GROUP_ADMIN(manage),
+                                           group_get_object_path (g_ptr_array_index (Added, i)));
+        group_watches_notify (manage->priv->Watches, g_ptr_array_index (Added, i),
+                              GROUP_WATCH_ADDED);
+    }
+    for (i = 0; i < Moved->len; i++)
+    {
+        MovedGroup *moved = g_ptr_array_index (Moved, i);
+
+        user_group_admin_emit_group_deleted (USER_GROUP_ADMIN (manage), moved->OldPath);
+        user_group_admin_emit_group_added (USER_GROUP_ADMIN (manage),
+                                           group_get_object_path (moved->group));
+        group_watches_notify (manage->priv->Watches, moved->group, GROUP_WATCH_ADDED);
+    }
+    g_hash_table_iter_init (&iter, GroupsHashTable);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        g_object_thaw_notify (G_OBJECT (value));
+    }
+    if (Changes > 0)
+    {
+        ManageBumpGeneration (manage);
+    }
+    else if (Warm)
+    {
+        user_group_admin_set_generation (USER_GROUP_ADMIN (manage),
+                                         manage->priv->Generation);
+    }
+    Now = g_get_monotonic_time ();
+    stats_reload_phase (STATS_RELOAD_SIGNAL, Now - PhaseStart);
+
+    g_ptr_array_free (Removed, TRUE);
+    g_ptr_array_free (Added, TRUE);
+    g_ptr_array_free (Moved, TRUE);
     g_hash_table_destroy (OldGroups);
+    negative_cache_clear (manage->priv->Missing);
+    Now = g_get_monotonic_time ();
+    stats_reload_done (Now - Start);
+    GS_PROBE3 (reload__done,
+               g_hash_table_size (GroupsHashTable),
+               Changes,
+               Now - Start);
 }
 
 static gboolean ReloadGroupsTimeout (Manage *manage)
@@ -329,22 +787,186 @@ static GFileMonitor *SetupMonitor (const gchar *FileName,
     return Monitor;
 }
 
+/* Runs on the main loop for every page of the NSS walk. Entries already
+ * known, from /etc/group or an earlier page, keep their existing group. */
+static void MergeNssPage (NssPage *page, gpointer data)
+{
+    Manage        *manage = data;
+    ManagePrivate *priv = manage->priv;
+    GroupSnapshot *Snapshot;
+    GPtrArray     *Added;
+    guint          i;
+
+    Snapshot = group_snapshot_new (priv->Names);
+    Added = g_ptr_array_new ();
+    for (i = 0; i < page->entries->len; i++)
+    {
+        struct group *grent = g_ptr_array_index (page->entries, i);
+        g_autofree gchar *ObjectPath = NULL;
+        const GroupRecord *record;
+        Group *group;
+
+        if (g_hash_table_contains (priv->GroupsHashTable, grent->gr_name))
+        {
+            continue;
+        }
+        ObjectPath = g_strdup_printf ("/org/group/admin/Group%ld", (long) grent->gr_gid);
+        if (g_hash_table_contains (priv->GroupsByPath, ObjectPath))
+        {
+            continue;
+        }
+
+        group = group_new (manage, grent->gr_gid);
+        group_set_local_group (group, FALSE);
+        record = group_snapshot_add_grent (Snapshot, grent, NULL);
+        group_bind_record (group, Snapshot, record);
+        RegisterGroup (manage, group);
+        g_hash_table_insert (priv->GroupsHashTable,
+                             g_strdup (group_get_group_name (group)),
+                             group);
+        g_hash_table_insert (priv->GroupsByPath,
+                             (gpointer) group_get_object_path (group),
+                             group);
+        gid_map_set (priv->Gids, grent->gr_gid);
+        g_ptr_array_add (Added, group);
+    }
+    group_snapshot_unref (Snapshot);
+
+    for (i = 0; i < Added->len; i++)
+    {
+        user_group_admin_emit_group_added (USER_GROUP_ADMIN (manage),
+                                           group_get_object_path (g_ptr_array_index (Added, i)));
+        group_watches_notify (priv->Watches, g_ptr_array_index (Added, i), GROUP_WATCH_ADDED);
+    }
+    if (Added->len > 0)
+    {
+        priv->NssGroups += Added->len;
+        ManageBumpGeneration (manage);
+    }
+    g_ptr_array_free (Added, TRUE);
+}
+
+static void NssWalkDone (guint n_entries, gpointer data)
+{
+    Manage *manage = data;
+
+    g_debug ("NSS walk done: %u entries, %u directory groups",
+             n_entries, manage->priv->NssGroups);
+    manage->priv->Nss = NULL;
+}
+
+void ManageSetCachePath (const gchar *path)
+{
+    g_free (CachePath);
+    CachePath = g_strdup (path);
+}
+
+void ManageSetSnapshotPath (const gchar *path)
+{
+    g_free (SnapshotPath);
+    SnapshotPath = g_strdup (path);
+}
+
+void ManageEnableUserdb (const gchar *path)
+{
+    UserdbEnabled = TRUE;
+    g_free (UserdbPath);
+    UserdbPath = g_strdup (path);
+}
+
+void ManageSetPeerSocket (const gchar *path)
+{
+    g_free (PeerPath);
+    PeerPath = g_strdup (path);
+}
+
+void ManageSetMutationLimits (guint concurrency, guint rate)
+{
+    MaxMutations = concurrency;
+    MutationRate = rate;
+}
+
+void ManageSetNegativeTtl (guint seconds)
+{
+    NegativeTtl = seconds;
+}
+
+void ManageSetNssEnumeration (guint page_size)
+{
+    NssPageSize = page_size;
+}
+
+void ManageSetRoot (const gchar *root)
+{
+    g_free (ConfigRoot);
+    ConfigRoot = g_strdup (root);
+}
+
+static gchar *ManageBuildPath (const gchar *path)
+{
+    if (ConfigRoot == NULL)
+    {
+        return g_strdup (path);
+    }
+    return g_build_filename (ConfigRoot, path, NULL);
+}
+
 static void manage_init (Manage *manage)
 {
     manage->priv = manage_get_instance_private (manage);
     manage->priv->ReloadId = 0;
+    manage->priv->StartTime = g_get_monotonic_time ();
+    manage->priv->Names = name_pool_new ();
+    manage->priv->Missing = negative_cache_new (NEGATIVE_CACHE_SIZE,
+                                                (gint64) NegativeTtl * G_USEC_PER_SEC);
     manage->priv->GroupsHashTable = CreateGroupsHashTable();
-    manage->priv->PasswdMonitor = SetupMonitor (PATH_PASSWD,
+    manage->priv->GroupsByPath = CreateGroupsByPath (manage->priv->GroupsHashTable);
+    manage->priv->Gids = gid_map_new ();
+    manage->priv->Watches = group_watches_new ();
+    manage->priv->Scheduler = scheduler_new (MaxMutations, MutationRate);
+    LoadGidRanges (manage);
+    manage->priv->PathPasswd = ManageBuildPath (PATH_PASSWD);
+    manage->priv->PathShadow = ManageBuildPath (PATH_SHADOW);
+    manage->priv->PathGroup  = ManageBuildPath (PATH_GROUP);
+    manage->priv->PathCache  = CachePath != NULL ? g_strdup (CachePath)
+                                                 : ManageBuildPath (PATH_GROUP_CACHE);
+    if (SnapshotPath == NULL)
+        manage->priv->PathSnapshot = ManageBuildPath (GS_SNAPSHOT_PATH);
+    else if (SnapshotPath[0] != '\0')
+        manage->priv->PathSnapshot = g_strdup (SnapshotPath);
+    manage->priv->PasswdMonitor = SetupMonitor (manage->priv->PathPasswd,
                                                 GroupsMonitorChanged,
                                                 manage);
-    manage->priv->ShadowMonitor = SetupMonitor (PATH_SHADOW,
+    manage->priv->ShadowMonitor = SetupMonitor (manage->priv->PathShadow,
                                                 GroupsMonitorChanged,
                                                 manage);
-    manage->priv->GroupMonitor =  SetupMonitor (PATH_GROUP,
+    manage->priv->GroupMonitor =  SetupMonitor (manage->priv->PathGroup,
                                                 GroupsMonitorChanged,
                                                 manage);
 
     ReloadGroupsTimeout (manage);
+    /* A warm start with nothing changed does not bump the generation */
+    QueuePublishSnapshot (manage);
+    if (UserdbEnabled)
+    {
+        g_autofree gchar *Path = NULL;
+        g_autoptr(GError) error = NULL;
+
+        Path = UserdbPath != NULL ? g_strdup (UserdbPath) : ManageBuildPath (USERDB_SOCKET_PATH);
+        manage->priv->Userdb = userdb_server_new (manage, Path, &error);
+        if (manage->priv->Userdb == NULL)
+        {
+            g_warning ("Unable to listen on %s: %s", Path, error->message);
+        }
+    }
+    if (NssPageSize > 0)
+    {
+        manage->priv->Nss = nss_enumerator_start (NssPageSize,
+                                                  NSS_MAX_PAGES,
+                                                  MergeNssPage,
+                                                  NssWalkDone,
+                                                  manage);
+    }
 }
 
 static void manage_finalize (GObject *object)
@@ -355,9 +977,34 @@ static void manage_finalize (GObject *object)
     manage = MANAGE (object);
     priv = manage_get_instance_private (manage);;
 
+    if (priv->Nss != NULL)
+        nss_enumerator_stop (priv->Nss);
+    if (priv->Userdb != NULL)
+        userdb_server_free (priv->Userdb);
+    if (priv->Peers != NULL)
+        peer_server_free (priv->Peers);
+    group_watches_free (priv->Watches);
+    scheduler_free (priv->Scheduler);
     if (priv->BusConnection != NULL)
         g_object_unref (priv->BusConnection);
+    if (priv->Stats != NULL)
+        g_object_unref (priv->Stats);
+    g_hash_table_destroy (priv->GroupsByPath);
     g_hash_table_destroy (priv->GroupsHashTable);
+    name_pool_free (priv->Names);
+    negative_cache_free (priv->Missing);
+    gid_map_free (priv->Gids);
+    g_free (priv->PathPasswd);
+    g_free (priv->PathShadow);
+    g_free (priv->PathGroup);
+    g_free (priv->PathCache);
+    if (priv->PublishId > 0)
+        g_source_remove (priv->PublishId);
+    if (priv->Published != NULL)
+        snapshot_file_free (priv->Published);
+    g_free (priv->PathSnapshot);
+    if (priv->CacheStamps != NULL)
+        g_variant_unref (priv->CacheStamps);
 
 }
 
@@ -423,19 +1070,52 @@ Manage *manage_new(void)
     return manage;
 }
 
+static gboolean ManageGetStatistics (UserGroupStats        *object,
+                                     GDBusMethodInvocation *Invocation,
+                                     Manage                *manage)
+{
+    GVariantBuilder Builder;
+
+    g_variant_builder_init (&Builder, G_VARIANT_TYPE_VARDICT);
+    stats_add_counters (&Builder);
+    g_variant_builder_add (&Builder, "{sv}", "groups",
+                           g_variant_new_uint32 (g_hash_table_size (manage->priv->GroupsHashTable)));
+    g_variant_builder_add (&Builder, "{sv}", "names",
+                           g_variant_new_uint32 (name_pool_size (manage->priv->Names)));
+    g_variant_builder_add (&Builder, "{sv}", "negative-cache",
+                           negative_cache_get_counters (manage->priv->Missing));
+    g_variant_builder_add (&Builder, "{sv}", "gids-used",
+                           g_variant_new_uint32 (gid_map_size (manage->priv->Gids)));
+    g_variant_builder_add (&Builder, "{sv}", "nss-groups",
+                           g_variant_new_uint32 (manage->priv->NssGroups));
+    g_variant_builder_add (&Builder, "{sv}", "snapshot-bytes",
+                           g_variant_new_uint64 (manage->priv->SnapshotBytes));
+    g_variant_builder_add (&Builder, "{sv}", "mutations",
+                           scheduler_get_counters (manage->priv->Scheduler));
+    g_variant_builder_add (&Builder, "{sv}", "mutation-queues",
+                           scheduler_get_queues (manage->priv->Scheduler));
+    g_variant_builder_add (&Builder, "{sv}", "shared-snapshot-bytes",
+                           g_variant_new_uint64 (manage->priv->Published != NULL ?
+                                                 snapshot_file_get_size (manage->priv->Published) : 0));
+
+    user_group_stats_complete_get_statistics (object, Invocation,
+                                              g_variant_builder_end (&Builder));
+    return TRUE;
+}
+
 int RegisterGroupManage (Manage *manage)
 {
     GError *error = NULL;
 
+    /* Lookups do not need polkit; without it every mutation is refused */
     manage->priv->Authority = polkit_authority_get_sync (NULL, &error);
     if (manage->priv->Authority == NULL)
     {
         if (error != NULL)
         {
-            g_print ("error getting polkit authority: %s", error->message);
-            g_error_free(error);
+            g_warning ("error getting polkit authority: %s", error->message);
+            g_clear_error (&error);
         }
-        return -1;
     }
 
     manage->priv->BusConnection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
@@ -465,43 +1145,207 @@ int RegisterGroupManage (Manage *manage)
         return -1;
     }
 
+    manage->priv->Stats = user_group_stats_skeleton_new ();
+    g_signal_connect (manage->priv->Stats,
+                     "handle-get-statistics",
+                      G_CALLBACK (ManageGetStatistics),
+                      manage);
+    if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (manage->priv->Stats),
+                                           manage->priv->BusConnection,
+                                          "/org/group/admin",
+                                           &error))
+    {
+        g_warning ("error exporting statistics interface: %s", error->message);
+        g_error_free (error);
+        error = NULL;
+    }
+
+    if (PeerPath != NULL)
+    {
+        manage->priv->Peers = peer_server_new (manage, PeerPath, &error);
+        if (manage->priv->Peers == NULL)
+        {
+            g_warning ("Unable to listen on %s: %s", PeerPath, error->message);
+            g_error_free (error);
+        }
+    }
+
     return 0;
 }
 
-typedef struct
-{
-    Manage *manage;
-    Group  *group;
-    AuthorizedCallback Authorized_cb;
-    GDBusMethodInvocation *Invocation;
-    gpointer data;
-    GDestroyNotify DestroyNotify;
-} CheckAuthData;
-
-static void CheckAuthDataFree (CheckAuthData *data)
+/* Gives a new peer connection everything the bus has: the manager, its
+ * statistics and every group object */
+void ManageExportPeer (Manage *manage, GDBusConnection *connection)
 {
-    if(data->manage)
-        g_object_unref (data->manage);
-    if (data->group)
-        g_object_unref (data->group);
+    ManagePrivate *priv = manage->priv;
+    g_autoptr(GError) error = NULL;
+    GHashTableIter iter;
+    gpointer value;
 
-    if (data->DestroyNotify)
-        (*data->DestroyNotify) (data->data);
+    if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (manage),
+                                           connection,
+                                           "/org/group/admin",
+                                           &error) ||
+        (priv->Stats != NULL &&
+         !g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (priv->Stats),
+                                            connection,
+                                            "/org/group/admin",
+                                            &error)))
+    {
+        g_warning ("Unable to export to a peer: %s", error->message);
+        g_dbus_connection_close (connection, NULL, NULL, NULL);
+        return;
+    }
+    g_hash_table_iter_init (&iter, priv->GroupsHashTable);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        GDBusInterfaceSkeleton *skeleton = value;
+        const gchar *ObjectPath = g_dbus_interface_skeleton_get_object_path (skeleton);
 
-    g_free (data);
+        if (ObjectPath != NULL &&
+            !g_dbus_interface_skeleton_export (skeleton, connection, ObjectPath, &error))
+        {
+            g_warning ("Unable to export %s to a peer: %s", ObjectPath, error->message);
+            g_clear_error (&error);
+        }
+    }
 }
 
-static void CheckAuth_cb (PolkitAuthority *Authority,
-                          GAsyncResult    *res,
-                          gpointer         data)
+void ManageUnexportPeer (Manage *manage, GDBusConnection *connection)
 {
-    CheckAuthData *cad = data;
-    PolkitAuthorizationResult *result;
-    GError *error = NULL;
-    gboolean is_authorized = FALSE;
+    ManagePrivate *priv = manage->priv;
+    GHashTableIter iter;
+    gpointer value;
 
-    result = polkit_authority_check_authorization_finish (Authority, res, &error);
-    if (error)
+    group_watches_drop_connection (priv->Watches, connection);
+    g_hash_table_iter_init (&iter, priv->GroupsHashTable);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        if (g_dbus_interface_skeleton_has_connection (value, connection))
+            g_dbus_interface_skeleton_unexport_from_connection (value, connection);
+    }
+    if (priv->Stats != NULL &&
+        g_dbus_interface_skeleton_has_connection (G_DBUS_INTERFACE_SKELETON (priv->Stats), connection))
+        g_dbus_interface_skeleton_unexport_from_connection (G_DBUS_INTERFACE_SKELETON (priv->Stats),
+                                                            connection);
+    if (g_dbus_interface_skeleton_has_connection (G_DBUS_INTERFACE_SKELETON (manage), connection))
+        g_dbus_interface_skeleton_unexport_from_connection (G_DBUS_INTERFACE_SKELETON (manage),
+                                                            connection);
+}
+
+void ManageExportOnPeers (Manage *manage, GDBusInterfaceSkeleton *skeleton, const gchar *ObjectPath)
+{
+    if (manage->priv->Peers != NULL)
+    {
+        peer_server_export (manage->priv->Peers, skeleton, ObjectPath);
+    }
+}
+
+/* Re-keys group after one of the daemon's own edits renamed it or moved
+ * it to another gid. The object path follows the gid, so a new gid is
+ * announced like a removal and an addition. Watchers see either edit as
+ * a removal and an addition; they must have been told of the removal
+ * before the edit, so name and gid filters match the old values. */
+void ManageGroupEdited (Manage *manage, Group *group, const gchar *OldName, gid_t OldGid)
+{
+    ManagePrivate *priv = manage->priv;
+    g_autofree gchar *OldPath = NULL;
+
+    if (g_strcmp0 (OldName, group_get_group_name (group)) != 0)
+    {
+        if (g_hash_table_lookup (priv->GroupsHashTable, OldName) == group)
+        {
+            g_object_ref (group);
+            g_hash_table_remove (priv->GroupsHashTable, OldName);
+            g_hash_table_replace (priv->GroupsHashTable,
+                                  g_strdup (group_get_group_name (group)),
+                                  group);
+        }
+        group_watches_notify (priv->Watches, group, GROUP_WATCH_ADDED);
+    }
+    if (OldGid != group_get_gid (group))
+    {
+        OldPath = g_strdup (group_get_object_path (group));
+        UnRegisterGroup (manage, group);
+        g_hash_table_remove (priv->GroupsByPath, OldPath);
+        g_free (group->object_path);
+        group->object_path = compute_object_path (group);
+        g_hash_table_insert (priv->GroupsByPath, group->object_path, group);
+        gid_map_clear (priv->Gids, OldGid);
+        gid_map_set (priv->Gids, group_get_gid (group));
+        RegisterGroup (manage, group);
+        user_group_admin_emit_group_deleted (USER_GROUP_ADMIN (manage), OldPath);
+        user_group_admin_emit_group_added (USER_GROUP_ADMIN (manage), group->object_path);
+        group_watches_notify (priv->Watches, group, GROUP_WATCH_ADDED);
+    }
+    negative_cache_clear (priv->Missing);
+}
+
+/* Drops group as soon as groupdel succeeds instead of on the reload */
+static void RemoveDeletedGroup (Manage *manage, Group *group)
+{
+    ManagePrivate *priv = manage->priv;
+
+    g_object_ref (group);
+    if (g_hash_table_lookup (priv->GroupsHashTable, group_get_group_name (group)) == group)
+    {
+        g_hash_table_remove (priv->GroupsHashTable, group_get_group_name (group));
+    }
+    g_hash_table_remove (priv->GroupsByPath, group_get_object_path (group));
+    gid_map_clear (priv->Gids, group_get_gid (group));
+    UnRegisterGroup (manage, group);
+    user_group_admin_emit_group_deleted (USER_GROUP_ADMIN (manage), group_get_object_path (group));
+    group_watches_notify (priv->Watches, group, GROUP_WATCH_REMOVED);
+    ManageBumpGeneration (manage);
+    g_object_unref (group);
+}
+
+/* For changes made outside a reload, such as the daemon's own edits */
+void ManageNotifyWatchers (Manage *manage, Group *group, GroupWatchEvent event)
+{
+    group_watches_notify (manage->priv->Watches, group, event);
+}
+
+typedef struct
+{
+    Manage *manage;
+    Group  *group;
+    AuthorizedCallback Authorized_cb;
+    GDBusMethodInvocation *Invocation;
+    gpointer data;
+    GDestroyNotify DestroyNotify;
+    const gchar *ActionFile;
+    gboolean AllowInteraction;
+    gint64 Start;
+} CheckAuthData;
+
+static void CheckAuthDataFree (CheckAuthData *data)
+{
+    if(data->manage)
+        g_object_unref (data->manage);
+    if (data->group)
+        g_object_unref (data->group);
+
+    if (data->DestroyNotify)
+        (*data->DestroyNotify) (data->data);
+
+    g_free (data);
+}
+
+static void CheckAuth_cb (PolkitAuthority *Authority,
+                          GAsyncResult    *res,
+                          gpointer         data)
+{
+    CheckAuthData *cad = data;
+    PolkitAuthorizationResult *result;
+    GError *error = NULL;
+    gboolean is_authorized = FALSE;
+    gint64 Elapsed;
+
+    result = polkit_authority_check_authorization_finish (Authority, res, &error);
+    Elapsed = g_get_monotonic_time () - cad->Start;
+    stats_method_phase (cad->Invocation, STATS_PHASE_POLKIT, Elapsed);
+    if (error)
     {
         DbusPrintf (cad->Invocation, ERROR_PERMISSION_DENIED, "Not authorized: %s", error->message);
         g_error_free(error);
@@ -524,6 +1368,7 @@ static void CheckAuth_cb (PolkitAuthority *Authority,
         g_object_unref (result);
     }
 
+    GS_PROBE3 (auth__done, stats_method_name (cad->Invocation), is_authorized, Elapsed);
     if (is_authorized)
     {
         (* cad->Authorized_cb) (cad->manage,
@@ -535,6 +1380,67 @@ static void CheckAuth_cb (PolkitAuthority *Authority,
     CheckAuthDataFree (data);
 }
 
+/* Callers on a peer connection have no bus name; polkit gets the process
+ * behind the socket instead */
+static PolkitSubject *ManageCallerSubject (GDBusMethodInvocation *Invocation)
+{
+    const gchar *Sender = g_dbus_method_invocation_get_sender (Invocation);
+    GCredentials *Credentials;
+
+    if (Sender == NULL)
+    {
+        Credentials = g_dbus_connection_get_peer_credentials (g_dbus_method_invocation_get_connection (Invocation));
+        if (Credentials != NULL)
+        {
+            return polkit_unix_process_new_for_owner (g_credentials_get_unix_pid (Credentials, NULL),
+                                                      0,
+                                                      g_credentials_get_unix_user (Credentials, NULL));
+        }
+    }
+
+    return polkit_system_bus_name_new (Sender);
+}
+
+/* Runs once the scheduler gives the call its turn */
+static void StartAuthorization (gpointer user_data)
+{
+    CheckAuthData *data = user_data;
+    ManagePrivate *priv = data->manage->priv;
+    PolkitSubject *subject;
+    PolkitCheckAuthorizationFlags flags;
+    gint64 Now;
+
+    Now = g_get_monotonic_time ();
+    stats_method_phase (data->Invocation, STATS_PHASE_QUEUE, Now - data->Start);
+    data->Start = Now;
+    GS_PROBE2 (auth__start, stats_method_name (data->Invocation), data->ActionFile);
+
+    if (priv->Authority == NULL)
+    {
+        DbusPrintf (data->Invocation, ERROR_PERMISSION_DENIED, "No polkit authority available");
+        CheckAuthDataFree (data);
+        return;
+    }
+
+    subject = ManageCallerSubject (data->Invocation);
+
+    flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
+    if (data->AllowInteraction)
+    {
+        flags |= POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION;
+    }
+    polkit_authority_check_authorization (priv->Authority,
+                                          subject,
+                                          data->ActionFile,
+                                          NULL,
+                                          flags,
+                                          NULL,
+                                          (GAsyncReadyCallback) CheckAuth_cb,
+                                          data);
+
+    g_object_unref (subject);
+}
+
 void LocalCheckAuthorization(Manage                *manage,
                              Group                 *group,
                              const gchar           *ActionFile,
@@ -545,9 +1451,8 @@ void LocalCheckAuthorization(Manage                *manage,
                              GDestroyNotify         DestroyNotify)
 {
     ManagePrivate *priv = manage_get_instance_private (manage);
+    g_autoptr(GError) error = NULL;
     CheckAuthData *data;
-    PolkitSubject *subject;
-    PolkitCheckAuthorizationFlags flags;
 
     data = g_new0 (CheckAuthData, 1);
     data->manage = g_object_ref (manage);
@@ -559,38 +1464,40 @@ void LocalCheckAuthorization(Manage                *manage,
     data->Authorized_cb = Authorized_cb;
     data->data = Authorized_cb_data;
     data->DestroyNotify = DestroyNotify;
-
-    subject = polkit_system_bus_name_new (g_dbus_method_invocation_get_sender (Invocation));
-
-    flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
-    if (AllowInteraction)
+    data->ActionFile = ActionFile;
+    data->AllowInteraction = AllowInteraction;
+    data->Start = g_get_monotonic_time ();
+
+    if (!scheduler_submit (priv->Scheduler,
+                           Invocation,
+                           StartAuthorization,
+                           data,
+                           (GDestroyNotify) CheckAuthDataFree,
+                           &error))
     {
-        flags |= POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION;
+        DbusPrintf (Invocation, ERROR_FAILED, "%s", error->message);
+        CheckAuthDataFree (data);
     }
-    polkit_authority_check_authorization (priv->Authority,
-                                          subject,
-                                          ActionFile,
-                                          NULL,
-                                          flags,
-                                          NULL,
-                                          (GAsyncReadyCallback) CheckAuth_cb,
-                                          data);
-
-    g_object_unref (subject);
 }
 
 static Group * AddNewGroupForDus (Manage *manage,struct group *grent)
 {
     Group *group;
     group = group_new (manage,grent->gr_gid);
-    group_update_from_grent (group, grent);
+    group_update_from_grent (group, grent, NULL);
     RegisterGroup (manage, group);
 
     g_hash_table_insert (manage->priv->GroupsHashTable,
                          g_strdup (group_get_group_name (group)),
                          group);
+    g_hash_table_insert (manage->priv->GroupsByPath,
+                         (gpointer) group_get_object_path (group),
+                         group);
+    gid_map_set (manage->priv->Gids, group_get_gid (group));
 
     user_group_admin_emit_group_added (USER_GROUP_ADMIN(manage), group_get_object_path (group));
+    group_watches_notify (manage->priv->Watches, group, GROUP_WATCH_ADDED);
+    ManageBumpGeneration (manage);
 
     return group;
 }
@@ -599,19 +1506,35 @@ static Group *ManageLocalFindGroupByid(Manage *manage,
                                        gid_t gid)
 {
     ManagePrivate *priv = manage_get_instance_private (manage);
+    g_autofree gchar *ObjectPath = NULL;
     Group *group;
     struct group *grent;
 
+    /* Cached groups are answered without a round trip through NSS. Paths
+     * follow the gid, since the reload and ManageGroupEdited re-key any
+     * group that moved. */
+    ObjectPath = g_strdup_printf ("/org/group/admin/Group%ld", (long) gid);
+    group = g_hash_table_lookup (priv->GroupsByPath, ObjectPath);
+    if (group != NULL && group_get_gid (group) == gid)
+    {
+        return group;
+    }
+
+    if (negative_cache_has_gid (priv->Missing, gid))
+    {
+        return NULL;
+    }
     grent = getgrgid(gid);
     if (grent == NULL)
     {
         g_print ("unable to lookup gid %d",(int)gid);
+        negative_cache_add_gid (priv->Missing, gid);
         return NULL;
     }
     group = g_hash_table_lookup (priv->GroupsHashTable, grent->gr_name);
     if(group == NULL)
     {
-        AddNewGroupForDus(manage,grent);
+        group = AddNewGroupForDus(manage,grent);
     }
 
     return group;
@@ -624,9 +1547,11 @@ static gboolean ManageFindGRoupByid (UserGroupAdmin *object,
     Manage *manage = (Manage *)object;
     Group  *group;
 
+    stats_method_begin (invocation, STATS_METHOD_FIND_GROUP_BY_ID);
     group = ManageLocalFindGroupByid (manage, gid);
     if (group)
     {
+        stats_method_reply (invocation);
         user_group_admin_complete_find_group_by_id(NULL,invocation,group_get_object_path (group));
     }
     else
@@ -644,10 +1569,21 @@ static Group *ManageLocalFindGroupByname (Manage *manage,
     Group *group;
     struct group *grent;
 
+    group = g_hash_table_lookup (priv->GroupsHashTable, name);
+    if (group != NULL)
+    {
+        return group;
+    }
+
+    if (negative_cache_has_name (priv->Missing, name))
+    {
+        return NULL;
+    }
     grent = getgrnam (name);
     if (grent == NULL)
     {
         g_print ("unable to lookup name %s: %s", name, g_strerror (errno));
+        negative_cache_add_name (priv->Missing, name);
         return NULL;
     }
 
@@ -666,9 +1602,11 @@ static gboolean ManageFindGroupByname(UserGroupAdmin *object,
     Manage *manage = (Manage *)object;
     Group  *group;
 
+    stats_method_begin (invocation, STATS_METHOD_FIND_GROUP_BY_NAME);
     group = ManageLocalFindGroupByname (manage, name);
     if (group)
     {
+        stats_method_reply (invocation);
         user_group_admin_complete_find_group_by_name(NULL,invocation,group_get_object_path (group));
     }
     else
@@ -687,6 +1625,7 @@ static const gchar * ManageGetDammonVersion (UserGroupAdmin *object)
 typedef struct
 {
     gchar *NewGroupName;
+    gint64 Gid;             /* -1 lets groupadd choose */
 } CreateGroupData;
 
 static void CreateGroupDataFree (gpointer data)
@@ -705,29 +1644,83 @@ static void CreateNewGroup_cb (Manage                *manage,
     CreateGroupData *cd = data;
     GError *error = NULL;
     Group *group;
-    const gchar *argv[4];
+    const gchar *argv[6];
+    g_autofree gchar *StrGid = NULL;
+    guint n = 0;
 
-    if (getgrnam (cd->NewGroupName) != NULL)
+    if (getgrnam (cd->NewGroupName) != NULL ||
+        g_hash_table_contains (manage->priv->GroupsHashTable, cd->NewGroupName))
     {
         DbusPrintf (Invocation, ERROR_GROUP_EXISTS,
                     "A gtoup with name '%s' already exists", cd->NewGroupName);
         return;
     }
+    if (cd->Gid >= 0 && gid_map_test (manage->priv->Gids, cd->Gid))
+    {
+        DbusPrintf (Invocation, ERROR_GROUP_EXISTS,
+                    "Gid %" G_GINT64_FORMAT " is already in use", cd->Gid);
+        return;
+    }
     sys_log (Invocation, "create group '%s'", cd->NewGroupName);
 
-    argv[0] = "/usr/sbin/groupadd";
-    argv[1] = "--";
-    argv[2] = cd->NewGroupName;
-    argv[3] = NULL;
+    argv[n++] = get_helper_path ("groupadd");
+    if (cd->Gid >= 0)
+    {
+        StrGid = g_strdup_printf ("%" G_GINT64_FORMAT, cd->Gid);
+        argv[n++] = "-g";
+        argv[n++] = StrGid;
+        /* Claimed now so AllocateGid skips it while groupadd runs */
+        gid_map_set (manage->priv->Gids, cd->Gid);
+    }
+    argv[n++] = "--";
+    argv[n++] = cd->NewGroupName;
+    argv[n] = NULL;
 
     if (!spawn_with_login_uid (Invocation, argv, &error))
     {
         DbusPrintf(Invocation, ERROR_FAILED,
                    "running '%s' failed: %s", argv[0], error->message);
         g_error_free (error);
+        if (cd->Gid >= 0)
+        {
+            gid_map_clear (manage->priv->Gids, cd->Gid);
+        }
+        return;
+    }
+    /* The new name, and whatever gid groupadd picked, may be cached as missing */
+    negative_cache_clear (manage->priv->Missing);
+    if (cd->Gid >= 0)
+    {
+        /* The entry is exactly what groupadd was told, no need to ask NSS */
+        gchar *NoMembers[] = { NULL };
+        struct group grent = { cd->NewGroupName, (gchar *) "x", cd->Gid, NoMembers };
+
+        group = AddNewGroupForDus (manage, &grent);
+    }
+    else
+    {
+        group = ManageLocalFindGroupByname (manage, cd->NewGroupName);
+    }
+    if (group == NULL)
+    {
+        /* Not visible through NSS, e.g. under --root: read the file back */
+        ReloadGroups (manage);
+        group = g_hash_table_lookup (manage->priv->GroupsHashTable, cd->NewGroupName);
+    }
+    if (group == NULL)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED,
+                    "Group '%s' was not found after running '%s'", cd->NewGroupName, argv[0]);
         return;
     }
-    group = ManageLocalFindGroupByname (manage, cd->NewGroupName);
+    if (cd->Gid >= 0)
+    {
+        stats_method_reply (Invocation);
+        user_group_admin_complete_create_group_with_gid (USER_GROUP_ADMIN(manage), Invocation,
+                                                         group_get_object_path (group));
+        return;
+    }
+    stats_method_reply (Invocation);
     user_group_admin_complete_create_group (USER_GROUP_ADMIN(manage), Invocation, group_get_object_path (group));
 }
 
@@ -738,8 +1731,10 @@ static gboolean ManageCreateGroup (UserGroupAdmin *object,
     Manage *manage = (Manage *)object;
     CreateGroupData *data;
 
+    stats_method_begin (Invocation, STATS_METHOD_CREATE_GROUP);
     data = g_new0 (CreateGroupData, 1);
     data->NewGroupName = g_strdup (name);
+    data->Gid = -1;
     LocalCheckAuthorization(manage,
                             NULL,
                            "org.group.admin.group-administration",
@@ -752,6 +1747,69 @@ static gboolean ManageCreateGroup (UserGroupAdmin *object,
     return TRUE;
 }
 
+static gboolean ManageCreateGroupWithGid (UserGroupAdmin        *object,
+                                          GDBusMethodInvocation *Invocation,
+                                          const gchar           *name,
+                                          guint64                gid)
+{
+    Manage *manage = (Manage *)object;
+    CreateGroupData *data;
+
+    stats_method_begin (Invocation, STATS_METHOD_CREATE_GROUP_WITH_GID);
+    if (gid >= G_MAXUINT32)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "Invalid gid %" G_GUINT64_FORMAT, gid);
+        return TRUE;
+    }
+    data = g_new0 (CreateGroupData, 1);
+    data->NewGroupName = g_strdup (name);
+    data->Gid = gid;
+    LocalCheckAuthorization(manage,
+                            NULL,
+                           "org.group.admin.group-administration",
+                            TRUE,
+                            CreateNewGroup_cb,
+                            Invocation,
+                            data,
+                            (GDestroyNotify)CreateGroupDataFree);
+
+    return TRUE;
+}
+
+/* Answers from the occupancy bitmap; nothing is reserved until
+ * CreateGroupWithGid, which refuses a gid taken in the meantime. */
+static gboolean ManageAllocateGid (UserGroupAdmin        *object,
+                                   GDBusMethodInvocation *Invocation,
+                                   GVariant              *Constraints)
+{
+    Manage  *manage = (Manage *)object;
+    gboolean System = FALSE;
+    guint32  First, Last;
+    gid_t    Gid;
+
+    stats_method_begin (Invocation, STATS_METHOD_ALLOCATE_GID);
+    g_variant_lookup (Constraints, "system", "b", &System);
+    First = System ? manage->priv->SysGidMin : manage->priv->GidMin;
+    Last  = System ? manage->priv->SysGidMax : manage->priv->GidMax;
+    g_variant_lookup (Constraints, "min", "u", &First);
+    g_variant_lookup (Constraints, "max", "u", &Last);
+    if (First > Last || Last >= G_MAXUINT32)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "Invalid gid range %u-%u", First, Last);
+        return TRUE;
+    }
+
+    if (!gid_map_find_free (manage->priv->Gids, First, Last, &Gid))
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "No free gid in %u-%u", First, Last);
+        return TRUE;
+    }
+    stats_method_reply (Invocation);
+    user_group_admin_complete_allocate_gid (object, Invocation, Gid);
+
+    return TRUE;
+}
+
 typedef struct
 {
     gint64 gid;
@@ -764,21 +1822,19 @@ static void DeleteOldGroup_cb (Manage                *manage,
 {
     GError *error = NULL;
     DeleteGroupData *gd = data;
-    struct group *grent;
     const gchar *argv[4];
 
-    grent = getgrgid (gd->gid);
-    if (grent == NULL)
+    if (g == NULL)
     {
         DbusPrintf(Invocation, ERROR_GROUP_DOES_NOT_EXIST,
                   "No group with gid %ld found", gd->gid);
         return;
     }
-    sys_log (Invocation, "delete group '%s' (%d)", grent->gr_name, gd->gid);
+    sys_log (Invocation, "delete group '%s' (%d)", group_get_group_name (g), gd->gid);
 
-    argv[0] = "/usr/sbin/groupdel";
+    argv[0] = get_helper_path ("groupdel");
     argv[1] = "--";
-    argv[2] = grent->gr_name;
+    argv[2] = group_get_group_name (g);
     argv[3] = NULL;
 
     if (!spawn_with_login_uid (Invocation, argv, &error))
@@ -788,7 +1844,8 @@ static void DeleteOldGroup_cb (Manage                *manage,
         g_error_free (error);
         return;
     }
-    user_group_admin_emit_group_deleted(USER_GROUP_ADMIN(manage),group_get_object_path(g));
+    RemoveDeletedGroup (manage, g);
+    stats_method_reply (Invocation);
     user_group_admin_complete_delete_group(USER_GROUP_ADMIN(manage),Invocation);
 }
 
@@ -800,6 +1857,7 @@ static gboolean ManageDeleteGroup (UserGroupAdmin        *object,
     DeleteGroupData *data;
     Group *group;
 
+    stats_method_begin (Invocation, STATS_METHOD_DELETE_GROUP);
     if ((gid_t)gid == 0)
     {
         DbusPrintf (Invocation, ERROR_FAILED, "Refuse to delete root group");
@@ -830,6 +1888,7 @@ static gboolean ManageListGroup (UserGroupAdmin *object,
     const gchar *name;
     Group *group;
 
+    stats_method_begin (Invocation, STATS_METHOD_LIST_CACHED_GROUPS);
     GroupPaths  = g_ptr_array_new ();
     g_hash_table_iter_init (&iter, manage->priv->GroupsHashTable);
     while (g_hash_table_iter_next (&iter, (gpointer *)&name, (gpointer *)&group))
@@ -838,6 +1897,7 @@ static gboolean ManageListGroup (UserGroupAdmin *object,
     }
     g_ptr_array_add (GroupPaths, NULL);
 
+    stats_method_reply (Invocation);
     user_group_admin_complete_list_cached_groups (object, Invocation,
                                                  (const gchar * const *)GroupPaths->pdata);
 
@@ -846,12 +1906,446 @@ static gboolean ManageListGroup (UserGroupAdmin *object,
     return TRUE;
 }
 
+static gboolean ManageListGroupIfChanged (UserGroupAdmin *object,
+                                          GDBusMethodInvocation *Invocation,
+                                          guint64 KnownGeneration)
+{
+    Manage *manage = (Manage*)object;
+    GPtrArray *GroupPaths;
+    GHashTableIter iter;
+    const gchar *name;
+    Group *group;
+    gboolean Changed;
+
+    stats_method_begin (Invocation, STATS_METHOD_LIST_CACHED_GROUPS_IF_CHANGED);
+    GroupPaths  = g_ptr_array_new ();
+    Changed = KnownGeneration != manage->priv->Generation;
+    if (Changed)
+    {
+        g_hash_table_iter_init (&iter, manage->priv->GroupsHashTable);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&name, (gpointer *)&group))
+        {
+            g_ptr_array_add (GroupPaths, (gpointer) group_get_object_path (group));
+        }
+    }
+    g_ptr_array_add (GroupPaths, NULL);
+
+    stats_method_reply (Invocation);
+    user_group_admin_complete_list_cached_groups_if_changed (object,
+                                                             Invocation,
+                                                             Changed,
+                                                             manage->priv->Generation,
+                                                             (const gchar * const *)GroupPaths->pdata);
+
+    g_ptr_array_free (GroupPaths, TRUE);
+
+    return TRUE;
+}
+
+static gboolean ManageGetGroupIfModified (UserGroupAdmin *object,
+                                          GDBusMethodInvocation *Invocation,
+                                          const gchar *ObjectPath,
+                                          guint64 KnownRevision)
+{
+    Manage *manage = (Manage*)object;
+    Group *group;
+    GVariantBuilder Empty;
+    guint64 Revision;
+
+    stats_method_begin (Invocation, STATS_METHOD_GET_GROUP_IF_MODIFIED);
+    group = g_hash_table_lookup (manage->priv->GroupsByPath, ObjectPath);
+    if (group == NULL)
+    {
+        DbusPrintf (Invocation, ERROR_GROUP_DOES_NOT_EXIST,
+                    "No group with object path %s", ObjectPath);
+        return TRUE;
+    }
+
+    Revision = group_get_revision (group);
+    if (Revision == KnownRevision)
+    {
+        g_variant_builder_init (&Empty, G_VARIANT_TYPE_VARDICT);
+        stats_method_reply (Invocation);
+        user_group_admin_complete_get_group_if_modified (object,
+                                                         Invocation,
+                                                         FALSE,
+                                                         Revision,
+                                                         g_variant_builder_end (&Empty));
+        return TRUE;
+    }
+
+    stats_method_reply (Invocation);
+    user_group_admin_complete_get_group_if_modified (object,
+                                                     Invocation,
+                                                     TRUE,
+                                                     Revision,
+                                                     group_get_record (group));
+    return TRUE;
+}
+
+/* Built on demand and shared by every reader until the next change */
+static gboolean ManageEnsureSnapshot (Manage *manage, GError **error)
+{
+    ManagePrivate *priv = manage->priv;
+    g_autoptr(GPtrArray) Records = NULL;
+    GHashTableIter iter;
+    gpointer value;
+    const gchar   *Sources[] = { priv->PathGroup, priv->PathPasswd, NULL };
+
+    if (priv->Published != NULL)
+    {
+        return TRUE;
+    }
+    Records = g_ptr_array_sized_new (g_hash_table_size (priv->GroupsHashTable));
+    g_hash_table_iter_init (&iter, priv->GroupsHashTable);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        Group *group = value;
+
+        if (group->record != NULL)
+        {
+            g_ptr_array_add (Records, (gpointer) group->record);
+        }
+    }
+    priv->Published = snapshot_file_new (Records, priv->Names, priv->Generation,
+                                         Sources, priv->CacheStamps, error);
+
+    return priv->Published != NULL;
+}
+
+static gboolean PublishSnapshot (Manage *manage)
+{
+    ManagePrivate *priv = manage->priv;
+    g_autoptr(GError) error = NULL;
+
+    priv->PublishId = 0;
+    if (!ManageEnsureSnapshot (manage, &error) ||
+        (!snapshot_file_is_published (priv->Published) &&
+         !snapshot_file_publish (priv->Published, priv->PathSnapshot, &error)))
+    {
+        g_warning ("Unable to publish the group table: %s", error->message);
+    }
+
+    return FALSE;
+}
+
+/* Coalesces the changes of one main loop iteration into one table */
+static void QueuePublishSnapshot (Manage *manage)
+{
+    if (manage->priv->PathSnapshot == NULL || manage->priv->PublishId > 0)
+    {
+        return;
+    }
+    manage->priv->PublishId = g_idle_add ((GSourceFunc) PublishSnapshot, manage);
+}
+
+void ManageWithdrawSnapshot (Manage *manage)
+{
+    if (manage->priv->Published != NULL)
+    {
+        snapshot_file_withdraw (manage->priv->Published);
+    }
+}
+
+/* For the Varlink side, which maps the same table; the fd stays owned
+ * by the daemon */
+gint ManageGetSnapshotFd (Manage *manage, guint64 *generation, GError **error)
+{
+    if (!ManageEnsureSnapshot (manage, error))
+    {
+        return -1;
+    }
+    *generation = snapshot_file_get_generation (manage->priv->Published);
+
+    return snapshot_file_get_fd (manage->priv->Published);
+}
+
+/* Removes the sockets before exit so nothing connects to a dead daemon */
+void ManageStopListeners (Manage *manage)
+{
+    g_clear_pointer (&manage->priv->Userdb, userdb_server_free);
+    g_clear_pointer (&manage->priv->Peers, peer_server_free);
+}
+
+static gboolean ManageOpenSnapshot (UserGroupAdmin *object,
+                                    GDBusMethodInvocation *Invocation,
+                                    GUnixFDList *FdList)
+{
+    Manage *manage = (Manage*)object;
+    ManagePrivate *priv = manage->priv;
+    g_autoptr(GUnixFDList) OutFdList = NULL;
+    g_autoptr(GError) error = NULL;
+    gint Index;
+
+    stats_method_begin (Invocation, STATS_METHOD_OPEN_SNAPSHOT);
+    if (!ManageEnsureSnapshot (manage, &error))
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "%s", error->message);
+        return TRUE;
+    }
+
+    OutFdList = g_unix_fd_list_new ();
+    Index = g_unix_fd_list_append (OutFdList, snapshot_file_get_fd (priv->Published), &error);
+    if (Index < 0)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "Unable to pass snapshot: %s", error->message);
+        return TRUE;
+    }
+    stats_method_reply (Invocation);
+    user_group_admin_complete_open_snapshot (object,
+                                             Invocation,
+                                             OutFdList,
+                                             g_variant_new_handle (Index));
+    return TRUE;
+}
+
+/* Each dump holds a worker thread for as long as its reader takes */
+#define DUMP_MAX_IN_FLIGHT 4
+
+typedef struct
+{
+    Manage                *manage;
+    GDBusMethodInvocation *Invocation;
+    GCancellable          *Cancellable;
+    guint                  NameWatch;
+    gulong                 ClosedId;
+} DumpRequest;
+
+static void DumpCallerGone (GDBusConnection *Connection, const gchar *name, gpointer data)
+{
+    DumpRequest *dr = data;
+
+    g_cancellable_cancel (dr->Cancellable);
+}
+
+static void DumpPeerClosed (GDBusConnection *Connection,
+                            gboolean RemotePeerVanished,
+                            GError *error,
+                            gpointer data)
+{
+    DumpCallerGone (Connection, NULL, data);
+}
+
+static void DumpGroupsDone (GObject *source, GAsyncResult *result, gpointer data)
+{
+    DumpRequest *dr = data;
+    g_autoptr(GError) error = NULL;
+    guint Count;
+
+    if (!group_dump_finish (result, &Count, &error))
+    {
+        DbusPrintf (dr->Invocation, ERROR_FAILED, "%s", error->message);
+    }
+    else
+    {
+        stats_method_reply (dr->Invocation);
+        user_group_admin_complete_dump_groups (NULL, dr->Invocation, NULL, Count);
+    }
+    if (dr->NameWatch > 0)
+        g_bus_unwatch_name (dr->NameWatch);
+    if (dr->ClosedId > 0)
+        g_signal_handler_disconnect (g_dbus_method_invocation_get_connection (dr->Invocation),
+                                     dr->ClosedId);
+    dr->manage->priv->Dumps--;
+    g_object_unref (dr->Cancellable);
+    g_object_unref (dr->Invocation);
+    g_object_unref (dr->manage);
+    g_free (dr);
+}
+
+/* Serializing happens on a worker against a dup of the published table,
+ * so the main loop keeps answering while a slow reader drains the pipe.
+ * A caller that leaves the bus takes its dump with it. */
+static gboolean ManageDumpGroups (UserGroupAdmin *object,
+                                  GDBusMethodInvocation *Invocation,
+                                  GUnixFDList *FdList,
+                                  GVariant *Fd,
+                                  const gchar *Format)
+{
+    Manage *manage = (Manage*)object;
+    g_autoptr(GError) error = NULL;
+    GDBusConnection *Connection;
+    const gchar *Sender;
+    GroupDumpFormat DumpFormat;
+    DumpRequest *dr;
+    gint OutFd, TableFd;
+    gint Flags;
+
+    stats_method_begin (Invocation, STATS_METHOD_DUMP_GROUPS);
+    if (!group_dump_parse_format (Format, &DumpFormat))
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "Unknown dump format '%s'", Format);
+        return TRUE;
+    }
+    if (manage->priv->Dumps >= DUMP_MAX_IN_FLIGHT)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "At most %u dumps at a time", DUMP_MAX_IN_FLIGHT);
+        return TRUE;
+    }
+    if (FdList == NULL)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "No file descriptor passed");
+        return TRUE;
+    }
+    OutFd = g_unix_fd_list_get (FdList, g_variant_get_handle (Fd), &error);
+    if (OutFd < 0)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "%s", error->message);
+        return TRUE;
+    }
+    Flags = fcntl (OutFd, F_GETFL);
+    if (Flags < 0 || (Flags & O_ACCMODE) == O_RDONLY)
+    {
+        close (OutFd);
+        DbusPrintf (Invocation, ERROR_FAILED, "The file descriptor is not open for writing");
+        return TRUE;
+    }
+    if (!ManageEnsureSnapshot (manage, &error))
+    {
+        close (OutFd);
+        DbusPrintf (Invocation, ERROR_FAILED, "%s", error->message);
+        return TRUE;
+    }
+    TableFd = dup (snapshot_file_get_fd (manage->priv->Published));
+    if (TableFd < 0)
+    {
+        close (OutFd);
+        DbusPrintf (Invocation, ERROR_FAILED, "Unable to duplicate the group table: %s",
+                    g_strerror (errno));
+        return TRUE;
+    }
+
+    dr = g_new0 (DumpRequest, 1);
+    dr->manage = g_object_ref (manage);
+    dr->Invocation = g_object_ref (Invocation);
+    dr->Cancellable = g_cancellable_new ();
+    Connection = g_dbus_method_invocation_get_connection (Invocation);
+    Sender = g_dbus_method_invocation_get_sender (Invocation);
+    /* Peers have no bus name; their connection closing is the same thing */
+    if (Sender != NULL)
+    {
+        dr->NameWatch = g_bus_watch_name_on_connection (Connection,
+                                                        Sender,
+                                                        G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                        NULL,
+                                                        DumpCallerGone,
+                                                        dr,
+                                                        NULL);
+    }
+    else
+    {
+        dr->ClosedId = g_signal_connect (Connection, "closed",
+                                         G_CALLBACK (DumpPeerClosed), dr);
+    }
+    manage->priv->Dumps++;
+    group_dump_async (TableFd, OutFd, DumpFormat, dr->Cancellable,
+                      DumpGroupsDone, dr);
+    return TRUE;
+}
+
+static gboolean ManageWatch (UserGroupAdmin *object,
+                             GDBusMethodInvocation *Invocation,
+                             GVariant *Filter)
+{
+    Manage *manage = (Manage*)object;
+    g_autoptr(GError) error = NULL;
+    const gchar *ObjectPath;
+
+    stats_method_begin (Invocation, STATS_METHOD_WATCH);
+    ObjectPath = group_watches_add (manage->priv->Watches,
+                                    g_dbus_method_invocation_get_connection (Invocation),
+                                    g_dbus_method_invocation_get_sender (Invocation),
+                                    Filter,
+                                    manage->priv->GroupsHashTable,
+                                    &error);
+    if (ObjectPath == NULL)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "%s", error->message);
+        return TRUE;
+    }
+    stats_method_reply (Invocation);
+    user_group_admin_complete_watch (object, Invocation, ObjectPath);
+    return TRUE;
+}
+
+static gboolean ManageUnwatch (UserGroupAdmin *object,
+                               GDBusMethodInvocation *Invocation,
+                               const gchar *ObjectPath)
+{
+    Manage *manage = (Manage*)object;
+
+    stats_method_begin (Invocation, STATS_METHOD_UNWATCH);
+    if (!group_watches_remove (manage->priv->Watches,
+                               g_dbus_method_invocation_get_connection (Invocation),
+                               g_dbus_method_invocation_get_sender (Invocation),
+                               ObjectPath))
+    {
+        DbusPrintf (Invocation, ERROR_FAILED, "No watch %s", ObjectPath);
+        return TRUE;
+    }
+    stats_method_reply (Invocation);
+    user_group_admin_complete_unwatch (object, Invocation);
+    return TRUE;
+}
+
+/* The reply of GetMembershipMatrix is kept well under the bus's message limit */
+#define MATRIX_MAX_BYTES (16 * 1024 * 1024)
+
+static gboolean ManageGetMembershipMatrix (UserGroupAdmin        *object,
+                                           GDBusMethodInvocation *Invocation,
+                                           const gchar *const    *Users,
+                                           const gchar *const    *Groups)
+{
+    Manage *manage = (Manage*)object;
+    ManagePrivate *priv = manage->priv;
+    MemberMatrix *Matrix;
+    guint n_groups, i;
+
+    stats_method_begin (Invocation, STATS_METHOD_GET_MEMBERSHIP_MATRIX);
+    n_groups = g_strv_length ((gchar **) Groups);
+    if (member_matrix_row_bytes (g_strv_length ((gchar **) Users)) * n_groups > MATRIX_MAX_BYTES)
+    {
+        DbusPrintf (Invocation, ERROR_FAILED,
+                    "A matrix of %u users by %u groups is too large",
+                    g_strv_length ((gchar **) Users), n_groups);
+        return TRUE;
+    }
+
+    Matrix = member_matrix_new (priv->Names, Users);
+    for (i = 0; i < n_groups; i++)
+    {
+        Group *group = g_hash_table_lookup (priv->GroupsByPath, Groups[i]);
+
+        if (group == NULL)
+        {
+            DbusPrintf (Invocation, ERROR_GROUP_DOES_NOT_EXIST, "No group at %s", Groups[i]);
+            member_matrix_free (Matrix);
+            return TRUE;
+        }
+        member_matrix_add_row (Matrix, group->record);
+    }
+    stats_method_reply (Invocation);
+    user_group_admin_complete_get_membership_matrix (object, Invocation, member_matrix_steal (Matrix));
+    member_matrix_free (Matrix);
+
+    return TRUE;
+}
+
 static void manage_user_group_admin_iface_init (UserGroupAdminIface *iface)
 {
     iface->handle_list_cached_groups = ManageListGroup;
+    iface->handle_list_cached_groups_if_changed = ManageListGroupIfChanged;
+    iface->handle_get_group_if_modified = ManageGetGroupIfModified;
     iface->handle_create_group =       ManageCreateGroup;
+    iface->handle_create_group_with_gid = ManageCreateGroupWithGid;
+    iface->handle_allocate_gid =       ManageAllocateGid;
     iface->handle_delete_group =       ManageDeleteGroup;
     iface->handle_find_group_by_id =   ManageFindGRoupByid;
     iface->handle_find_group_by_name = ManageFindGroupByname;
+    iface->handle_open_snapshot =      ManageOpenSnapshot;
+    iface->handle_dump_groups =        ManageDumpGroups;
+    iface->handle_watch =              ManageWatch;
+    iface->handle_unwatch =            ManageUnwatch;
+    iface->handle_get_membership_matrix = ManageGetMembershipMatrix;
     iface->get_daemon_version =        ManageGetDammonVersion;
 }
@@ -16,6 +16,7 @@
 #define __GROUP_SERVER__
 
 #include "group.h"
+#include "group-watch.h"
 #include "types.h"
 G_BEGIN_DECLS
 
@@ -63,6 +64,27 @@ void    DbusPrintf (GDBusMethodInvocation *Invocation,
                  ...);
 int     RegisterGroupManage (Manage *manage);
 void    ManageLoadGroup(Manage *manage);
+void    ManageSetRoot (const gchar *root);
+void    ManageSetNssEnumeration (guint page_size);
+void    ManageSetNegativeTtl (guint seconds);
+void    ManageSetMutationLimits (guint concurrency, guint rate);
+void    ManageSetCachePath (const gchar *path);
+void    ManageSaveCache (Manage *manage);
+void    ManageSetSnapshotPath (const gchar *path);
+void    ManageWithdrawSnapshot (Manage *manage);
+gint    ManageGetSnapshotFd (Manage *manage, guint64 *generation, GError **error);
+void    ManageEnableUserdb    (const gchar *path);
+void    ManageSetPeerSocket (const gchar *path);
+void    ManageStopListeners (Manage *manage);
+void    ManageExportPeer (Manage *manage, GDBusConnection *connection);
+void    ManageUnexportPeer (Manage *manage, GDBusConnection *connection);
+void    ManageExportOnPeers (Manage *manage, GDBusInterfaceSkeleton *skeleton, const gchar *ObjectPath);
+void    ManageNotifyWatchers (Manage *manage, Group *group, GroupWatchEvent event);
+void    ManageGroupEdited (Manage *manage, Group *group, const gchar *OldName, gid_t OldGid);
+gboolean ManageIsIdle (Manage *manage, guint seconds);
+void    ManageBumpGeneration (Manage *manage);
+NamePool *ManageGetNamePool  (Manage *manage);
+guint64 ManageGetGeneration  (Manage *manage);
 void    LocalCheckAuthorization(Manage                *manage,
                                 Group                 *group,
                                 const gchar           *ActionFile,
@@ -0,0 +1,227 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+
+#include "arena.h"
+#include "group-snapshot.h"
+
+/*
+ * A snapshot holds the group records produced by one reload (or by one
+ * out-of-band lookup or mutation). Records and member arrays live in a
+ * single arena, and each distinct name is referenced in the shared
+ * NamePool once per snapshot, so dropping the last reference releases
+ * the whole generation in one step. Group objects keep a reference to
+ * the snapshot that holds their current record.
+ */
+
+#define SNAPSHOT_BLOCK_SIZE (64 * 1024)
+#define SNAPSHOT_ALIGN(size) (((size) + 7) & ~(gsize) 7)
+
+struct GroupSnapshot
+{
+    gint        ref_count;
+    NamePool   *names;
+    Arena      *arena;
+    GPtrArray  *records;
+    GArray     *held;
+    GArray     *seen;
+};
+
+static GroupSnapshot *group_snapshot_new_with_block (NamePool *names, gsize block_size)
+{
+    GroupSnapshot *snapshot;
+
+    snapshot = g_new0 (GroupSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->names = names;
+    snapshot->arena = arena_new (block_size);
+    snapshot->records = g_ptr_array_new ();
+    snapshot->held = g_array_new (FALSE, FALSE, sizeof (NameId));
+    snapshot->seen = g_array_new (FALSE, TRUE, sizeof (guint32));
+
+    return snapshot;
+}
+
+GroupSnapshot *group_snapshot_new (NamePool *names)
+{
+    return group_snapshot_new_with_block (names, SNAPSHOT_BLOCK_SIZE);
+}
+
+/* For the one-record snapshots made by lookups and edits: the arena gets a
+ * single block that fits exactly one record with n_members members, rather
+ * than a reload-sized block that would sit mostly empty. */
+GroupSnapshot *group_snapshot_new_for_record (NamePool *names, guint n_members)
+{
+    gsize block_size;
+
+    block_size = SNAPSHOT_ALIGN (sizeof (GroupRecord)) +
+                 SNAPSHOT_ALIGN (MAX (n_members, 1) * sizeof (NameId));
+
+    return group_snapshot_new_with_block (names, block_size);
+}
+
+GroupSnapshot *group_snapshot_ref (GroupSnapshot *snapshot)
+{
+    g_atomic_int_inc (&snapshot->ref_count);
+
+    return snapshot;
+}
+
+/* The final unref touches the NamePool and must run on the main thread */
+void group_snapshot_unref (GroupSnapshot *snapshot)
+{
+    guint i;
+
+    if (snapshot == NULL)
+        return;
+
+    if (!g_atomic_int_dec_and_test (&snapshot->ref_count))
+        return;
+
+    for (i = 0; i < snapshot->held->len; i++)
+    {
+        name_pool_release (snapshot->names, g_array_index (snapshot->held, NameId, i));
+    }
+    g_array_free (snapshot->held, TRUE);
+    g_array_free (snapshot->seen, TRUE);
+    g_ptr_array_free (snapshot->records, TRUE);
+    arena_free (snapshot->arena);
+    g_free (snapshot);
+}
+
+/* Interns name, taking at most one pool reference per snapshot */
+static NameId snapshot_hold_name (GroupSnapshot *snapshot, const gchar *name)
+{
+    NameId id;
+    guint  word;
+    guint32 bit;
+
+    id = name_pool_find (snapshot->names, name);
+    if (id != NAME_ID_INVALID)
+    {
+        word = id / 32;
+        bit = 1u << (id % 32);
+        if (word < snapshot->seen->len &&
+            (g_array_index (snapshot->seen, guint32, word) & bit) != 0)
+        {
+            return id;
+        }
+        name_pool_ref (snapshot->names, id);
+    }
+    else
+    {
+        id = name_pool_intern (snapshot->names, name);
+        word = id / 32;
+        bit = 1u << (id % 32);
+    }
+
+    if (word >= snapshot->seen->len)
+    {
+        g_array_set_size (snapshot->seen, word + 1);
+    }
+    g_array_index (snapshot->seen, guint32, word) |= bit;
+    g_array_append_val (snapshot->held, id);
+
+    return id;
+}
+
+const GroupRecord *group_snapshot_add (GroupSnapshot      *snapshot,
+                                       const gchar        *name,
+                                       gid_t               gid,
+                                       gboolean            primary,
+                                       const gchar *const *members)
+{
+    GroupRecord *record;
+    guint        i;
+
+    record = arena_alloc (snapshot->arena, sizeof (GroupRecord));
+    record->name_id = snapshot_hold_name (snapshot, name);
+    record->gid = gid;
+    record->primary = primary;
+    record->primary_member = FALSE;
+    record->n_members = members != NULL ? g_strv_length ((gchar **) members) : 0;
+    record->members = arena_alloc (snapshot->arena,
+                                   MAX (record->n_members, 1) * sizeof (NameId));
+    for (i = 0; i < record->n_members; i++)
+    {
+        record->members[i] = snapshot_hold_name (snapshot, members[i]);
+    }
+    g_ptr_array_add (snapshot->records, record);
+
+    return record;
+}
+
+/* primary_user is the gecos of a user whose primary group this is, or NULL.
+ * It stands in as the only member of a primary group without members. */
+const GroupRecord *group_snapshot_add_grent (GroupSnapshot *snapshot,
+                                             struct group  *grent,
+                                             const gchar   *primary_user)
+{
+    const gchar *const *members;
+    const gchar *primary_members[2];
+    GroupRecord *record;
+    gboolean     stand_in = FALSE;
+
+    members = (const gchar *const *) grent->gr_mem;
+    if (primary_user != NULL && (members == NULL || members[0] == NULL))
+    {
+        primary_members[0] = primary_user;
+        primary_members[1] = NULL;
+        members = primary_members;
+        stand_in = TRUE;
+    }
+
+    record = (GroupRecord *) group_snapshot_add (snapshot,
+                                                 grent->gr_name,
+                                                 grent->gr_gid,
+                                                 primary_user != NULL,
+                                                 members);
+    record->primary_member = stand_in;
+
+    return record;
+}
+
+guint group_snapshot_get_n_records (GroupSnapshot *snapshot)
+{
+    return snapshot->records->len;
+}
+
+const GroupRecord *group_snapshot_get_record (GroupSnapshot *snapshot, guint index)
+{
+    g_return_val_if_fail (index < snapshot->records->len, NULL);
+
+    return g_ptr_array_index (snapshot->records, index);
+}
+
+NamePool *group_snapshot_get_names (GroupSnapshot *snapshot)
+{
+    return snapshot->names;
+}
+
+gsize group_snapshot_get_size (GroupSnapshot *snapshot)
+{
+    return arena_get_size (snapshot->arena);
+}
+
+gboolean group_record_members_equal (const GroupRecord *a, const GroupRecord *b)
+{
+    if (a->n_members != b->n_members)
+        return FALSE;
+
+    return a->n_members == 0 ||
+           memcmp (a->members, b->members, a->n_members * sizeof (NameId)) == 0;
+}
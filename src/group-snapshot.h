@@ -0,0 +1,61 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __GROUP_SNAPSHOT_H__
+#define __GROUP_SNAPSHOT_H__
+
+#include <sys/types.h>
+#include <grp.h>
+#include <glib.h>
+#include "name-pool.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+    NameId        name_id;
+    gid_t         gid;
+    gboolean      primary;
+    gboolean      primary_member;   /* members[0] stands in for an empty list */
+    guint         n_members;
+    NameId       *members;
+} GroupRecord;
+
+typedef struct GroupSnapshot GroupSnapshot;
+
+GroupSnapshot *     group_snapshot_new          (NamePool           *names);
+GroupSnapshot *     group_snapshot_new_for_record (NamePool         *names,
+                                                 guint               n_members);
+GroupSnapshot *     group_snapshot_ref          (GroupSnapshot      *snapshot);
+void                group_snapshot_unref        (GroupSnapshot      *snapshot);
+const GroupRecord * group_snapshot_add          (GroupSnapshot      *snapshot,
+                                                 const gchar        *name,
+                                                 gid_t               gid,
+                                                 gboolean            primary,
+                                                 const gchar *const *members);
+const GroupRecord * group_snapshot_add_grent    (GroupSnapshot      *snapshot,
+                                                 struct group       *grent,
+                                                 const gchar        *primary_user);
+guint               group_snapshot_get_n_records (GroupSnapshot     *snapshot);
+const GroupRecord * group_snapshot_get_record   (GroupSnapshot      *snapshot,
+                                                 guint               index);
+NamePool *          group_snapshot_get_names    (GroupSnapshot      *snapshot);
+gsize               group_snapshot_get_size     (GroupSnapshot      *snapshot);
+
+gboolean            group_record_members_equal  (const GroupRecord  *a,
+                                                 const GroupRecord  *b);
+
+G_END_DECLS
+
+#endif /* __GROUP_SNAPSHOT_H__ */
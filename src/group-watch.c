@@ -0,0 +1,404 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "group-watch.h"
+
+/*
+ * Subscriptions made with Watch(). Each one names the groups a client
+ * cares about; changes to those are collected for a short while and
+ * then sent to that client alone as a single WatchEvents signal, so a
+ * burst of edits costs one wakeup and unrelated churn costs none. A
+ * subscription ends with Unwatch() or when its client leaves the bus or
+ * closes its peer connection.
+ */
+
+#define WATCH_DELAY_MS        200
+#define WATCH_MAX_PER_CLIENT  32
+
+typedef struct
+{
+    guint32         gid;
+    GroupWatchEvent event;
+} PendingEvent;
+
+typedef struct
+{
+    GroupWatches    *watches;
+    gchar           *path;
+    GDBusConnection *connection;
+    gchar           *sender;        /* NULL on a peer connection */
+    guint            name_watch;
+
+    GHashTable      *names;
+    gboolean         has_range;
+    guint32          min;
+    guint32          max;
+    gchar           *member;
+    GHashTable      *member_of;     /* groups member was in last time */
+
+    GHashTable      *pending;       /* name -> PendingEvent */
+} Watch;
+
+struct GroupWatches
+{
+    GHashTable *by_path;
+    guint       serial;
+    guint       flush_id;
+};
+
+static const gchar *event_names[] =
+{
+    "added",
+    "changed",
+    "removed",
+};
+
+static void WatchFree (Watch *watch)
+{
+    if (watch->name_watch > 0)
+        g_bus_unwatch_name (watch->name_watch);
+    g_clear_pointer (&watch->names, g_hash_table_destroy);
+    g_clear_pointer (&watch->member_of, g_hash_table_destroy);
+    g_hash_table_destroy (watch->pending);
+    g_object_unref (watch->connection);
+    g_free (watch->member);
+    g_free (watch->sender);
+    g_free (watch->path);
+    g_free (watch);
+}
+
+GroupWatches *group_watches_new (void)
+{
+    GroupWatches *watches;
+
+    watches = g_new0 (GroupWatches, 1);
+    watches->by_path = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              NULL, (GDestroyNotify) WatchFree);
+
+    return watches;
+}
+
+void group_watches_free (GroupWatches *watches)
+{
+    if (watches->flush_id > 0)
+        g_source_remove (watches->flush_id);
+    g_hash_table_destroy (watches->by_path);
+    g_free (watches);
+}
+
+static gboolean ParseFilter (Watch *watch, GVariant *filter, GError **error)
+{
+    GVariantIter iter;
+    const gchar *key;
+    GVariant *value;
+
+    watch->min = 0;
+    watch->max = G_MAXUINT32;
+    g_variant_iter_init (&iter, filter);
+    while (g_variant_iter_next (&iter, "{&sv}", &key, &value))
+    {
+        if (g_strcmp0 (key, "names") == 0 &&
+            g_variant_is_of_type (value, G_VARIANT_TYPE_STRING_ARRAY))
+        {
+            g_autofree const gchar **names = g_variant_get_strv (value, NULL);
+            guint i;
+
+            if (watch->names == NULL)
+                watch->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+            for (i = 0; names[i] != NULL; i++)
+                g_hash_table_add (watch->names, g_strdup (names[i]));
+        }
+        else if (g_strcmp0 (key, "min") == 0 &&
+                 g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
+        {
+            watch->min = g_variant_get_uint32 (value);
+            watch->has_range = TRUE;
+        }
+        else if (g_strcmp0 (key, "max") == 0 &&
+                 g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
+        {
+            watch->max = g_variant_get_uint32 (value);
+            watch->has_range = TRUE;
+        }
+        else if (g_strcmp0 (key, "member") == 0 &&
+                 g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (watch->member);
+            watch->member = g_variant_dup_string (value, NULL);
+        }
+        else
+        {
+            g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                         "Unknown filter '%s' of type %s", key,
+                         g_variant_get_type_string (value));
+            g_variant_unref (value);
+            return FALSE;
+        }
+        g_variant_unref (value);
+    }
+    if (watch->min > watch->max)
+    {
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                     "Empty gid range %u..%u", watch->min, watch->max);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* A group matches if any one criterion holds, an empty filter matches
+ * every group */
+static gboolean WatchMatches (Watch *watch, Group *group, GroupWatchEvent event)
+{
+    const gchar *name = group_get_group_name (group);
+    gid_t gid = group_get_gid (group);
+    gboolean member_match = FALSE;
+
+    if (watch->member != NULL)
+    {
+        /* Leaving a group is a change the member's watcher wants too */
+        member_match = g_hash_table_contains (watch->member_of, name);
+        if (event != GROUP_WATCH_REMOVED && is_user_in_group (group, watch->member))
+        {
+            g_hash_table_add (watch->member_of, g_strdup (name));
+            member_match = TRUE;
+        }
+        else
+        {
+            g_hash_table_remove (watch->member_of, name);
+        }
+    }
+
+    if (watch->names == NULL && !watch->has_range && watch->member == NULL)
+        return TRUE;
+    if (watch->names != NULL && g_hash_table_contains (watch->names, name))
+        return TRUE;
+    if (watch->has_range && gid >= watch->min && gid <= watch->max)
+        return TRUE;
+
+    return member_match;
+}
+
+static void SenderVanished (GDBusConnection *connection,
+                            const gchar     *name,
+                            gpointer         data)
+{
+    Watch *watch = data;
+
+    g_hash_table_remove (watch->watches->by_path, watch->path);
+}
+
+const gchar *group_watches_add (GroupWatches    *watches,
+                                GDBusConnection *connection,
+                                const gchar     *sender,
+                                GVariant        *filter,
+                                GHashTable      *groups,
+                                GError         **error)
+{
+    GHashTableIter iter;
+    gpointer value;
+    Watch *watch;
+    guint n = 0;
+
+    g_hash_table_iter_init (&iter, watches->by_path);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        Watch *other = value;
+
+        if (other->connection == connection && g_strcmp0 (other->sender, sender) == 0)
+            n++;
+    }
+    if (n >= WATCH_MAX_PER_CLIENT)
+    {
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                     "At most %u watches per client", WATCH_MAX_PER_CLIENT);
+        return NULL;
+    }
+
+    watch = g_new0 (Watch, 1);
+    watch->watches = watches;
+    watch->connection = g_object_ref (connection);
+    watch->sender = g_strdup (sender);
+    watch->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    if (!ParseFilter (watch, filter, error))
+    {
+        WatchFree (watch);
+        return NULL;
+    }
+    if (watch->member != NULL)
+    {
+        watch->member_of = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        g_hash_table_iter_init (&iter, groups);
+        while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+            if (is_user_in_group (value, watch->member))
+                g_hash_table_add (watch->member_of, g_strdup (group_get_group_name (value)));
+        }
+    }
+    watch->path = g_strdup_printf ("/org/group/admin/watch/%u", ++watches->serial);
+    g_hash_table_insert (watches->by_path, watch->path, watch);
+
+    /* Peers are dropped through group_watches_drop_connection instead */
+    if (sender != NULL)
+    {
+        watch->name_watch = g_bus_watch_name_on_connection (connection,
+                                                            sender,
+                                                            G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                            NULL,
+                                                            SenderVanished,
+                                                            watch,
+                                                            NULL);
+    }
+
+    return watch->path;
+}
+
+gboolean group_watches_remove (GroupWatches    *watches,
+                               GDBusConnection *connection,
+                               const gchar     *sender,
+                               const gchar     *object_path)
+{
+    Watch *watch = g_hash_table_lookup (watches->by_path, object_path);
+
+    /* Only the client that made a watch may end it */
+    if (watch == NULL || watch->connection != connection ||
+        g_strcmp0 (watch->sender, sender) != 0)
+    {
+        return FALSE;
+    }
+
+    return g_hash_table_remove (watches->by_path, object_path);
+}
+
+void group_watches_drop_connection (GroupWatches *watches, GDBusConnection *connection)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, watches->by_path);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        if (((Watch *) value)->connection == connection)
+            g_hash_table_iter_remove (&iter);
+    }
+}
+
+static void FlushWatch (Watch *watch)
+{
+    g_autoptr(GError) error = NULL;
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sus)"));
+    g_hash_table_iter_init (&iter, watch->pending);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        PendingEvent *pending = value;
+
+        g_variant_builder_add (&builder, "(sus)", key, pending->gid,
+                               event_names[pending->event]);
+    }
+    g_hash_table_remove_all (watch->pending);
+
+    if (!g_dbus_connection_emit_signal (watch->connection,
+                                        watch->sender,
+                                        "/org/group/admin",
+                                        "org.group.admin",
+                                        "WatchEvents",
+                                        g_variant_new ("(oa(sus))", watch->path, &builder),
+                                        &error))
+    {
+        g_debug ("Unable to notify %s: %s", watch->path, error->message);
+    }
+}
+
+static gboolean FlushWatches (gpointer data)
+{
+    GroupWatches *watches = data;
+    GHashTableIter iter;
+    gpointer value;
+
+    watches->flush_id = 0;
+    g_hash_table_iter_init (&iter, watches->by_path);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        Watch *watch = value;
+
+        if (g_hash_table_size (watch->pending) > 0)
+            FlushWatch (watch);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Folds a new event into what is already queued for the same group */
+static void QueueEvent (Watch *watch, const gchar *name, guint32 gid, GroupWatchEvent event)
+{
+    PendingEvent *pending = g_hash_table_lookup (watch->pending, name);
+
+    if (pending == NULL)
+    {
+        pending = g_new (PendingEvent, 1);
+        pending->event = event;
+        g_hash_table_insert (watch->pending, g_strdup (name), pending);
+    }
+    else if (pending->event == GROUP_WATCH_ADDED && event == GROUP_WATCH_REMOVED)
+    {
+        /* Came and went before anyone was told */
+        g_hash_table_remove (watch->pending, name);
+        return;
+    }
+    else if (pending->event == GROUP_WATCH_REMOVED && event == GROUP_WATCH_ADDED)
+    {
+        pending->event = GROUP_WATCH_CHANGED;
+    }
+    else if (pending->event != GROUP_WATCH_ADDED)
+    {
+        pending->event = event;
+    }
+    pending->gid = gid;
+}
+
+void group_watches_notify (GroupWatches *watches, Group *group, GroupWatchEvent event)
+{
+    GHashTableIter iter;
+    gpointer value;
+    gboolean queued = FALSE;
+
+    g_hash_table_iter_init (&iter, watches->by_path);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        Watch *watch = value;
+
+        if (WatchMatches (watch, group, event))
+        {
+            QueueEvent (watch, group_get_group_name (group), group_get_gid (group), event);
+            queued = TRUE;
+        }
+    }
+    if (queued && watches->flush_id == 0)
+    {
+        watches->flush_id = g_timeout_add (WATCH_DELAY_MS, FlushWatches, watches);
+    }
+}
+
+guint group_watches_get_n_watches (GroupWatches *watches)
+{
+    return g_hash_table_size (watches->by_path);
+}
@@ -0,0 +1,54 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __GROUP_WATCH_H__
+#define __GROUP_WATCH_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "group.h"
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    GROUP_WATCH_ADDED,
+    GROUP_WATCH_CHANGED,
+    GROUP_WATCH_REMOVED,
+} GroupWatchEvent;
+
+typedef struct GroupWatches GroupWatches;
+
+GroupWatches * group_watches_new             (void);
+void           group_watches_free            (GroupWatches    *watches);
+const gchar *  group_watches_add             (GroupWatches    *watches,
+                                              GDBusConnection *connection,
+                                              const gchar     *sender,
+                                              GVariant        *filter,
+                                              GHashTable      *groups,
+                                              GError         **error);
+gboolean       group_watches_remove          (GroupWatches    *watches,
+                                              GDBusConnection *connection,
+                                              const gchar     *sender,
+                                              const gchar     *object_path);
+void           group_watches_drop_connection (GroupWatches    *watches,
+                                              GDBusConnection *connection);
+void           group_watches_notify          (GroupWatches    *watches,
+                                              Group           *group,
+                                              GroupWatchEvent  event);
+guint          group_watches_get_n_watches   (GroupWatches    *watches);
+
+G_END_DECLS
+
+#endif /* __GROUP_WATCH_H__ */
@@ -13,6 +13,7 @@
 *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
@@ -30,6 +31,13 @@
 #include <gio/gunixinputstream.h>
 #include "group.h"
 #include "group-server.h"
+#include "stats.h"
+
+enum
+{
+    PROP_0,
+    PROP_USERS
+};
 
 static void user_group_list_iface_init (UserGroupListIface *iface);
 
@@ -51,32 +59,115 @@ gid_t group_get_gid (Group *group)
     return user_group_list_get_gid(USER_GROUP_LIST(group));
 }
 
+/* Groups found only through NSS enumeration are not in the local files */
+void group_set_local_group (Group *group, gboolean local)
+{
+    group->local_group = local;
+    user_group_list_set_local_group (USER_GROUP_LIST (group), local);
+}
+
 gboolean group_get_local_group(Group *group)
 {
     return user_group_list_get_local_group(USER_GROUP_LIST(group));
 }
 
+guint64 group_get_revision (Group *group)
+{
+    return user_group_list_get_revision (USER_GROUP_LIST (group));
+}
+
+/* Stamps the group with the generation its change is about to be
+ * published under. Unlike a per-object counter this never repeats for a
+ * recreated object path or across restarts. */
+static void group_bump_revision (Group *group)
+{
+    user_group_list_set_revision (USER_GROUP_LIST (group),
+                                  ManageGetGeneration (group->manage) + 1);
+}
+
+/* Announces a change made by one of the daemon's own mutations; the
+ * revision was already bumped when the new record was bound. */
+void group_changed (Group *group)
+{
+    user_group_list_emit_changed (USER_GROUP_LIST (group));
+    ManageNotifyWatchers (group->manage, group, GROUP_WATCH_CHANGED);
+    ManageBumpGeneration (group->manage);
+}
+
+GVariant *group_get_record (Group *group)
+{
+    GVariantBuilder builder;
+    g_autofree const gchar **users = NULL;
+
+    users = group_get_users (group);
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&builder, "{sv}", "Revision",
+                           g_variant_new_uint64 (group_get_revision (group)));
+    g_variant_builder_add (&builder, "{sv}", "GroupName",
+                           g_variant_new_string (group_get_group_name (group)));
+    g_variant_builder_add (&builder, "{sv}", "Gid",
+                           g_variant_new_uint64 (group_get_gid (group)));
+    g_variant_builder_add (&builder, "{sv}", "LocalGroup",
+                           g_variant_new_boolean (group_get_local_group (group)));
+    g_variant_builder_add (&builder, "{sv}", "PrimaryGroup",
+                           g_variant_new_boolean (user_group_list_get_primary_group (USER_GROUP_LIST (group))));
+    g_variant_builder_add (&builder, "{sv}", "Users",
+                           g_variant_new_strv (users, -1));
+    g_variant_builder_add (&builder, "{sv}", "MemberCount",
+                           g_variant_new_uint32 (group->record != NULL ? group->record->n_members : 0));
+
+    return g_variant_builder_end (&builder);
+}
+
+/* Larger groups get a hash set of member ids, built on the first check
+ * and dropped whenever the members change */
+#define MEMBER_SET_MIN 32
+
+static GHashTable *group_get_member_set (Group *group)
+{
+    const GroupRecord *record = group->record;
+    guint n;
+
+    if (group->member_set != NULL)
+    {
+        return group->member_set;
+    }
+    group->member_set = g_hash_table_new (g_direct_hash, g_direct_equal);
+    for (n = record->primary_member ? 1 : 0; n < record->n_members; n++)
+    {
+        g_hash_table_add (group->member_set, GUINT_TO_POINTER (record->members[n] + 1));
+    }
+
+    return group->member_set;
+}
+
+/* Only members listed in the file count, not a primary user standing in
+ * for an empty list. No NSS lookup is made. */
 gboolean is_user_in_group(Group *group,const char *user)
 {
-    char const **users;
-    int i = 0;
-    struct group * grent;
+    const GroupRecord *record = group->record;
+    NameId id;
+    guint  n;
 
-    users = user_group_list_get_users(USER_GROUP_LIST(group));
-    while(users[i] != NULL)
+    if (record == NULL)
     {
-        if(g_strcmp0(users[i],user) == 0)
-            return TRUE;
-        i++;
+        return FALSE;
     }
-    i = 0;
-    grent = getgrnam(group_get_group_name(group));
-    while (grent->gr_mem[i] != NULL)
+    id = name_pool_find (group_snapshot_get_names (group->snapshot), user);
+    if (id == NAME_ID_INVALID)
     {
-        if(g_strcmp0(grent->gr_mem[i],user) == 0)
+        return FALSE;
+    }
+    if (record->n_members >= MEMBER_SET_MIN)
+    {
+        return g_hash_table_contains (group_get_member_set (group), GUINT_TO_POINTER (id + 1));
+    }
+    for (n = record->primary_member ? 1 : 0; n < record->n_members; n++)
+    {
+        if (record->members[n] == id)
             return TRUE;
-        i++;
     }
+
     return FALSE;
 }
 
@@ -116,6 +207,7 @@ void RegisterGroup (Manage *manage,Group *group)
         }
         return;
     }
+    ManageExportOnPeers (manage, G_DBUS_INTERFACE_SKELETON (group), object_path);
 }
 
 void UnRegisterGroup (Manage *manage,Group *group)
@@ -123,29 +215,226 @@ void UnRegisterGroup (Manage *manage,Group *group)
     g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (group));
 }
 
-void group_update_from_grent (Group        *group,
-                              struct group *grent)
+/* The member names of the bound record, borrowed from the name pool.
+ * Free the array with g_free. */
+const gchar **group_get_users (Group *group)
+{
+    NamePool *names;
+    const gchar **users;
+    guint n, i;
+
+    n = group->record != NULL ? group->record->n_members : 0;
+    users = g_new (const gchar *, n + 1);
+    if (n > 0)
+    {
+        names = group_snapshot_get_names (group->snapshot);
+        for (i = 0; i < n; i++)
+        {
+            users[i] = name_pool_lookup (names, group->record->members[i]);
+        }
+    }
+    users[n] = NULL;
+
+    return users;
+}
+
+/* Users is built from the record only when someone reads it, so a change
+ * just names it in PropertiesChanged */
+static void group_invalidate_users (Group *group)
+{
+    static const gchar *const invalidated[] = { "Users", NULL };
+    GList *connections, *l;
+
+    connections = g_dbus_interface_skeleton_get_connections (G_DBUS_INTERFACE_SKELETON (group));
+    for (l = connections; l != NULL; l = l->next)
+    {
+        g_dbus_connection_emit_signal (l->data,
+                                       NULL,
+                                       group->object_path,
+                                       "org.freedesktop.DBus.Properties",
+                                       "PropertiesChanged",
+                                       g_variant_new ("(s@a{sv}^as)",
+                                                      "org.group.admin.list",
+                                                      g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0),
+                                                      invalidated),
+                                       NULL);
+    }
+    g_list_free_full (connections, g_object_unref);
+}
+
+/* Points group at record, which must belong to snapshot, and updates the
+ * exported properties. Returns TRUE if anything visible on the bus changed. */
+gboolean group_bind_record (Group             *group,
+                            GroupSnapshot     *snapshot,
+                            const GroupRecord *record)
 {
+    const GroupRecord *old = group->record;
+    GroupSnapshot *old_snapshot = group->snapshot;
+    gboolean changed = FALSE;
+    gboolean revised = FALSE;
+    gboolean members_changed;
+
     g_object_freeze_notify (G_OBJECT (group));
-    if (grent->gr_gid != group->gid)
+    if (record->gid != group->gid)
+    {
+        group->gid = record->gid;
+        revised = TRUE;
+    }
+    if (old == NULL || old->name_id != record->name_id)
+    {
+        revised = TRUE;
+    }
+    members_changed = old == NULL || !group_record_members_equal (old, record);
+    if (old == NULL || old->primary != record->primary)
     {
-        group->gid = grent->gr_gid;
-        g_object_notify (G_OBJECT (group), "gid");
+        changed = TRUE;
     }
 
-    if (g_strcmp0 (group->group_name, grent->gr_name) != 0)
+    group->snapshot = group_snapshot_ref (snapshot);
+    group->record = record;
+    group_snapshot_unref (old_snapshot);
+
+    if (members_changed)
     {
-        g_free (group->group_name);
-        group->group_name = g_strdup (grent->gr_name);
-        g_object_notify (G_OBJECT (group), "group-name");
+        g_clear_pointer (&group->member_set, g_hash_table_destroy);
+        user_group_list_set_member_count (USER_GROUP_LIST (group), record->n_members);
+        revised = TRUE;
+    }
+    if (revised)
+    {
+        group_bump_revision (group);
+        changed = TRUE;
     }
 
-    user_group_list_set_local_group(USER_GROUP_LIST(group),TRUE);
+    user_group_list_set_primary_group (USER_GROUP_LIST (group), record->primary);
+    user_group_list_set_local_group(USER_GROUP_LIST(group),group->local_group);
     user_group_list_set_gid(USER_GROUP_LIST(group),group->gid);
-    user_group_list_set_group_name(USER_GROUP_LIST(group),group->group_name);
-    user_group_list_set_users(USER_GROUP_LIST(group),
-                             (const gchar *const *)grent->gr_mem);
+    user_group_list_set_group_name(USER_GROUP_LIST(group),
+                                   name_pool_lookup (group_snapshot_get_names (snapshot),
+                                                     record->name_id));
     g_object_thaw_notify (G_OBJECT (group));
+    if (members_changed && old != NULL)
+    {
+        group_invalidate_users (group);
+    }
+
+    return changed;
+}
+
+/* The members as the file lists them, without a primary user standing
+ * in for an empty list. Free with g_free, the names are borrowed. */
+static const gchar **group_file_members (Group *group)
+{
+    const gchar **users;
+
+    users = group_get_users (group);
+    if (group->record->primary_member && users[0] != NULL)
+    {
+        memmove (users, users + 1, group->record->n_members * sizeof (gchar *));
+    }
+
+    return users;
+}
+
+/* Binds group to a single-record snapshot of its own. users are the file
+ * members; the primary user standing in for an empty list is kept. */
+static gboolean group_rebind (Group              *group,
+                              const gchar        *name,
+                              gid_t               gid,
+                              const gchar *const *users)
+{
+    GroupSnapshot *snapshot;
+    const GroupRecord *record;
+    const gchar *stand_in = NULL;
+    gboolean changed;
+
+    if (group->record->primary_member)
+    {
+        stand_in = name_pool_lookup (group_snapshot_get_names (group->snapshot),
+                                     group->record->members[0]);
+    }
+    snapshot = group_snapshot_new_for_record (ManageGetNamePool (group->manage),
+                                              g_strv_length ((gchar **) users));
+    if (stand_in != NULL && users[0] == NULL)
+    {
+        struct group grent = { (gchar *) name, NULL, gid, NULL };
+
+        record = group_snapshot_add_grent (snapshot, &grent, stand_in);
+    }
+    else
+    {
+        record = group_snapshot_add (snapshot, name, gid, group->record->primary, users);
+    }
+    changed = group_bind_record (group, snapshot, record);
+    group_snapshot_unref (snapshot);
+
+    return changed;
+}
+
+/* primary_user is the gecos of a user whose primary group this is, or NULL.
+ * Returns TRUE if anything visible on the bus changed. */
+gboolean group_update_from_grent (Group        *group,
+                                  struct group *grent,
+                                  const gchar  *primary_user)
+{
+    GroupSnapshot *snapshot;
+    const GroupRecord *record;
+    gboolean changed;
+
+    snapshot = group_snapshot_new_for_record (ManageGetNamePool (group->manage),
+                                              grent->gr_mem != NULL ? g_strv_length (grent->gr_mem) : 0);
+    record = group_snapshot_add_grent (snapshot, grent, primary_user);
+    changed = group_bind_record (group, snapshot, record);
+    group_snapshot_unref (snapshot);
+
+    return changed;
+}
+
+gboolean group_set_members (Group *group, const gchar *const *users)
+{
+    return group_rebind (group,
+                         group_get_group_name (group),
+                         group->record->gid,
+                         users);
+}
+
+gboolean group_set_name (Group *group, const gchar *name)
+{
+    g_autofree const gchar **users = group_file_members (group);
+
+    return group_rebind (group, name, group->record->gid, users);
+}
+
+gboolean group_set_gid (Group *group, gid_t gid)
+{
+    g_autofree const gchar **users = group_file_members (group);
+
+    return group_rebind (group, group_get_group_name (group), gid, users);
+}
+
+/* Adds or removes one file member the way groupmems -a or -d does */
+static gboolean group_edit_member (Group *group, const gchar *user, gboolean add)
+{
+    g_autofree const gchar **users = group_file_members (group);
+    GPtrArray *members;
+    gboolean changed;
+    guint i;
+
+    members = g_ptr_array_new ();
+    for (i = 0; users[i] != NULL; i++)
+    {
+        if (g_strcmp0 (users[i], user) != 0)
+            g_ptr_array_add (members, (gpointer) users[i]);
+    }
+    if (add)
+    {
+        g_ptr_array_add (members, (gpointer) user);
+    }
+    g_ptr_array_add (members, NULL);
+    changed = group_set_members (group, (const gchar *const *) members->pdata);
+    g_ptr_array_free (members, TRUE);
+
+    return changed;
 }
 
 gchar * compute_object_path (Group *group)
@@ -164,7 +453,32 @@ static void group_finalize (GObject *object)
     group = GROUP (object);
 
     g_free (group->object_path);
-    g_free (group->group_name);
+    g_clear_pointer (&group->member_set, g_hash_table_destroy);
+    group_snapshot_unref (group->snapshot);
+
+    G_OBJECT_CLASS (group_parent_class)->finalize (object);
+}
+
+static void group_get_property (GObject    *object,
+                                guint       param_id,
+                                GValue     *value,
+                                GParamSpec *pspec)
+{
+    Group *group = GROUP (object);
+
+    switch (param_id)
+    {
+        case PROP_USERS:
+        {
+            g_autofree const gchar **users = group_get_users (group);
+
+            g_value_set_boxed (value, users);
+            break;
+        }
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
+            break;
+    }
 }
 
 static void group_class_init (GroupClass *class)
@@ -173,13 +487,21 @@ static void group_class_init (GroupClass *class)
 
     gobject_class = G_OBJECT_CLASS (class);
     gobject_class->finalize = group_finalize;
+    gobject_class->get_property = group_get_property;
+
+    /* Read through here by Get and GetAll instead of being stored in the
+     * skeleton */
+    g_object_class_override_property (gobject_class, PROP_USERS, "users");
 }
 
 static void group_init (Group *group)
 {
     group->object_path = NULL;
-    group->group_name = NULL;
+    group->snapshot = NULL;
+    group->record = NULL;
+    group->member_set = NULL;
     group->gid = -1;
+    group->local_group = TRUE;
 }
 
 Group * group_new (Manage *manage,gid_t gid)
@@ -202,7 +524,6 @@ static void AddUserAuthorized_cb (Manage                *manage,
     gchar *name = udata;
     GError *error = NULL;
     const gchar *argv[6];
-    struct group * grent;
 
     if(getpwnam (name) == NULL)
     {
@@ -215,7 +536,7 @@ static void AddUserAuthorized_cb (Manage                *manage,
         sys_log (Invocation, "%s user '%s' %s group '%s'","add",
                 name,"to",group_get_group_name (g));
 
-        argv[0] = "/usr/sbin/groupmems";
+        argv[0] = get_helper_path ("groupmems");
         argv[1] = "-g";
         argv[2] = group_get_group_name (g);
         argv[3] = "-a";
@@ -230,11 +551,10 @@ static void AddUserAuthorized_cb (Manage                *manage,
             return;
         }
 
-        grent = getgrnam(group_get_group_name(g));
-        user_group_list_set_users(USER_GROUP_LIST(g),
-                                 (const gchar *const *)grent->gr_mem);
-        user_group_list_emit_changed (USER_GROUP_LIST(g));
+        group_edit_member (g, name, TRUE);
+        group_changed (g);
     }
+    stats_method_reply (Invocation);
     user_group_list_complete_add_user_to_group(USER_GROUP_LIST(g),Invocation);
 }
 
@@ -244,6 +564,7 @@ static gboolean AddUserToGroup (UserGroupList *object,
 {
     Group *group = (Group*) object;
 
+    stats_method_begin (Invocation, STATS_METHOD_ADD_USER_TO_GROUP);
     LocalCheckAuthorization (group->manage,
                              group,
                              "org.group.admin.group-administration",
@@ -263,6 +584,7 @@ static void ChangeNameAuthorized_cb (Manage                *manage,
 {
     gchar *name = udata;
     GError *error = NULL;
+    g_autofree gchar *OldName = NULL;
     const gchar *argv[6];
 
     if (g_strcmp0 (group_get_group_name (g), name) != 0)
@@ -270,7 +592,7 @@ static void ChangeNameAuthorized_cb (Manage                *manage,
         sys_log (Invocation, "changing name of group '%s' to '%s'",
                  group_get_group_name (g),name);
 
-        argv[0] = "/usr/sbin/groupmod";
+        argv[0] = get_helper_path ("groupmod");
         argv[1] = "-n";
         argv[2] = name;
         argv[3] = "--";
@@ -284,9 +606,14 @@ static void ChangeNameAuthorized_cb (Manage                *manage,
             g_error_free (error);
             return;
         }
-        user_group_list_set_group_name(USER_GROUP_LIST(g),name);
-        user_group_list_emit_changed (USER_GROUP_LIST(g));
+        OldName = g_strdup (group_get_group_name (g));
+        /* Watchers filtering on the old name must hear that it is gone */
+        ManageNotifyWatchers (manage, g, GROUP_WATCH_REMOVED);
+        group_set_name (g, name);
+        ManageGroupEdited (manage, g, OldName, group_get_gid (g));
+        group_changed (g);
     }
+    stats_method_reply (Invocation);
     user_group_list_complete_change_group_name(USER_GROUP_LIST(g),Invocation);
 }
 
@@ -296,6 +623,7 @@ static gboolean ChangeGroupName (UserGroupList *object,
 {
     Group *group = (Group*) object;
 
+    stats_method_begin (Invocation, STATS_METHOD_CHANGE_GROUP_NAME);
     LocalCheckAuthorization (group->manage,
                              group,
                              "org.group.admin.group-administration",
@@ -317,13 +645,14 @@ static void ChangeIdAuthorized_cb   (Manage                *manage,
     GError *error = NULL;
     const gchar *Strid = g_strdup_printf("%u",id);
     const gchar *argv[6];
+    gid_t OldGid;
 
     if (group_get_gid (g) != id)
     {
         sys_log (Invocation, "changing id of group '%u' to '%u'",
                  group_get_gid (g),id);
 
-        argv[0] = "/usr/sbin/groupmod";
+        argv[0] = get_helper_path ("groupmod");
         argv[1] = "-g";
         argv[2] = Strid;
         argv[3] = "--";
@@ -337,9 +666,14 @@ static void ChangeIdAuthorized_cb   (Manage                *manage,
             g_free((gpointer)Strid);
             return;
         }
-        user_group_list_set_gid(USER_GROUP_LIST(g),id);
-        user_group_list_emit_changed (USER_GROUP_LIST(g));
+        OldGid = group_get_gid (g);
+        /* The old object path goes away, tell watchers under the old gid */
+        ManageNotifyWatchers (manage, g, GROUP_WATCH_REMOVED);
+        group_set_gid (g, id);
+        ManageGroupEdited (manage, g, group_get_group_name (g), OldGid);
+        group_changed (g);
     }
+    stats_method_reply (Invocation);
     user_group_list_complete_change_group_id(USER_GROUP_LIST(g),Invocation);
 }
 
@@ -349,6 +683,7 @@ static gboolean ChangeGroupId (UserGroupList *object,
 {
     Group *group = (Group*) object;
 
+    stats_method_begin (Invocation, STATS_METHOD_CHANGE_GROUP_ID);
     LocalCheckAuthorization (group->manage,
                              group,
                              "org.group.admin.group-administration",
@@ -369,7 +704,6 @@ static void RemoveUserAuthorized_cb (Manage                *manage,
     gchar *name = udata;
     GError *error = NULL;
     const gchar *argv[6];
-    struct group * grent;
 
     if(getpwnam (name) == NULL)
     {
@@ -382,7 +716,7 @@ static void RemoveUserAuthorized_cb (Manage                *manage,
         sys_log (Invocation, "%s user '%s' %s group '%s'","remove",
                 name,"from",group_get_group_name (g));
 
-        argv[0] = "/usr/sbin/groupmems";
+        argv[0] = get_helper_path ("groupmems");
         argv[1] = "-g";
         argv[2] = group_get_group_name (g);
         argv[3] = "-d";
@@ -397,12 +731,11 @@ static void RemoveUserAuthorized_cb (Manage                *manage,
             return;
         }
 
-        grent = getgrnam(group_get_group_name(g));
-        user_group_list_set_users(USER_GROUP_LIST(g),
-                                 (const gchar *const *)grent->gr_mem);
-        user_group_list_emit_changed (USER_GROUP_LIST(g));
+        group_edit_member (g, name, FALSE);
+        group_changed (g);
 
     }
+    stats_method_reply (Invocation);
     user_group_list_complete_remove_user_from_group (USER_GROUP_LIST(g),Invocation);
 }
 
@@ -413,6 +746,7 @@ static gboolean RemoveUserFromGroup (UserGroupList *object,
 
     Group *group = (Group*) object;
 
+    stats_method_begin (Invocation, STATS_METHOD_REMOVE_USER_FROM_GROUP);
     LocalCheckAuthorization (group->manage,
                              group,
                              "org.group.admin.group-administration",
@@ -425,10 +759,24 @@ static gboolean RemoveUserFromGroup (UserGroupList *object,
     return TRUE;
 }
 
+static gboolean IsMember (UserGroupList         *object,
+                          GDBusMethodInvocation *Invocation,
+                          const gchar           *user)
+{
+    Group *group = (Group*) object;
+
+    stats_method_begin (Invocation, STATS_METHOD_IS_MEMBER);
+    stats_method_reply (Invocation);
+    user_group_list_complete_is_member (object, Invocation, is_user_in_group (group, user));
+
+    return TRUE;
+}
+
 static void user_group_list_iface_init (UserGroupListIface *iface)
 {
     iface->handle_add_user_to_group =      AddUserToGroup;
     iface->handle_change_group_name =      ChangeGroupName;
     iface->handle_change_group_id =        ChangeGroupId;
     iface->handle_remove_user_from_group = RemoveUserFromGroup;
+    iface->handle_is_member =              IsMember;
 }
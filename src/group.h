@@ -22,6 +22,7 @@
 #include "group-generated.h"
 #include "group-list-generated.h"
 #include "util.h"
+#include "group-snapshot.h"
 #include "types.h"
 G_BEGIN_DECLS
 
@@ -37,10 +38,11 @@ typedef struct Group
     gchar        *object_path;
     gid_t         gid;
     GDBusConnection *system_bus_connection;
-    gchar        *group_name;
+    GroupSnapshot *snapshot;
+    const GroupRecord *record;
     gboolean      local_group;
-    GStrv         users;
     guint         changed_timeout_id;
+    GHashTable   *member_set;
 } Group;
 
 typedef struct GroupClass
@@ -51,8 +53,18 @@ typedef struct GroupClass
 GType          group_get_type                (void) G_GNUC_CONST;
 Group *        group_new                     (Manage         *manage,
                                               gid_t           gid);
-void           group_update_from_grent       (Group          *group,
-                                              struct group   *grent);
+gboolean       group_update_from_grent       (Group          *group,
+                                              struct group   *grent,
+                                              const gchar    *primary_user);
+gboolean       group_bind_record             (Group          *group,
+                                              GroupSnapshot  *snapshot,
+                                              const GroupRecord *record);
+gboolean       group_set_members             (Group          *group,
+                                              const gchar *const *users);
+gboolean       group_set_name                (Group          *group,
+                                              const gchar    *name);
+gboolean       group_set_gid                 (Group          *group,
+                                              gid_t           gid);
 
 void           RegisterGroup                 (Manage         *manage,
                                               Group          *group);
@@ -66,7 +78,11 @@ const gchar *  group_get_object_path         (Group          *group);
 gid_t          group_get_gid                 (Group          *group);
 const gchar *  group_get_group_name          (Group          *group);
 gboolean       group_get_local_group         (Group          *group);
-GStrv          group_get_users               (Group          *group);
+void           group_set_local_group         (Group          *group,
+                                              gboolean        local);
+const gchar ** group_get_users               (Group          *group);
+guint64        group_get_revision            (Group          *group);
+GVariant *     group_get_record              (Group          *group);
 gboolean       is_user_in_group              (Group          *group,
                                               const char      *user);
 gchar       *  compute_object_path           (Group          *group);
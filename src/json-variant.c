@@ -0,0 +1,391 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "json-variant.h"
+
+/*
+ * Just enough JSON for Varlink messages: a recursive descent parser that
+ * builds a GVariant, so callers can use g_variant_lookup on what arrives,
+ * and an escaper for building replies with GString. Nesting is capped to
+ * keep a hostile peer from recursing the stack away.
+ */
+
+#define JSON_MAX_DEPTH 32
+
+typedef struct
+{
+    const gchar *text;
+    const gchar *end;
+    const gchar *p;
+} JsonParser;
+
+static GVariant *ParseValue (JsonParser *parser, guint depth, GError **error);
+
+static gboolean Fail (JsonParser *parser, GError **error, const gchar *what)
+{
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "Invalid JSON at offset %" G_GSIZE_FORMAT ": %s",
+                 (gsize) (parser->p - parser->text), what);
+    return FALSE;
+}
+
+static void SkipSpace (JsonParser *parser)
+{
+    while (parser->p < parser->end &&
+           (*parser->p == ' ' || *parser->p == '\t' || *parser->p == '\n' || *parser->p == '\r'))
+    {
+        parser->p++;
+    }
+}
+
+static gboolean Expect (JsonParser *parser, gchar c)
+{
+    SkipSpace (parser);
+    if (parser->p < parser->end && *parser->p == c)
+    {
+        parser->p++;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static gint HexDigits (const gchar *p)
+{
+    gint value = 0;
+    gint i;
+
+    for (i = 0; i < 4; i++)
+    {
+        gint digit = g_ascii_xdigit_value (p[i]);
+
+        if (digit < 0)
+            return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+static gchar *ParseString (JsonParser *parser, GError **error)
+{
+    g_autoptr(GString) out = NULL;
+
+    if (!Expect (parser, '"'))
+    {
+        Fail (parser, error, "expected a string");
+        return NULL;
+    }
+    out = g_string_new (NULL);
+    while (parser->p < parser->end && *parser->p != '"')
+    {
+        guchar c = *parser->p;
+
+        if (c < 0x20)
+        {
+            Fail (parser, error, "control character in string");
+            return NULL;
+        }
+        if (c != '\\')
+        {
+            g_string_append_c (out, c);
+            parser->p++;
+            continue;
+        }
+        if (parser->end - parser->p < 2)
+        {
+            Fail (parser, error, "unterminated string");
+            return NULL;
+        }
+        parser->p += 2;
+        switch (parser->p[-1])
+        {
+        case '"':  g_string_append_c (out, '"');  break;
+        case '\\': g_string_append_c (out, '\\'); break;
+        case '/':  g_string_append_c (out, '/');  break;
+        case 'b':  g_string_append_c (out, '\b'); break;
+        case 'f':  g_string_append_c (out, '\f'); break;
+        case 'n':  g_string_append_c (out, '\n'); break;
+        case 'r':  g_string_append_c (out, '\r'); break;
+        case 't':  g_string_append_c (out, '\t'); break;
+        case 'u':
+        {
+            gint unit, low;
+            gunichar ch;
+
+            if (parser->end - parser->p < 4 || (unit = HexDigits (parser->p)) < 0)
+            {
+                Fail (parser, error, "bad \\u escape");
+                return NULL;
+            }
+            parser->p += 4;
+            ch = unit;
+            if (unit >= 0xd800 && unit < 0xdc00)
+            {
+                if (parser->end - parser->p < 6 || parser->p[0] != '\\' || parser->p[1] != 'u' ||
+                    (low = HexDigits (parser->p + 2)) < 0xdc00 || low >= 0xe000)
+                {
+                    Fail (parser, error, "unpaired surrogate");
+                    return NULL;
+                }
+                parser->p += 6;
+                ch = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+            }
+            else if (unit == 0 || (unit >= 0xdc00 && unit < 0xe000))
+            {
+                Fail (parser, error, "character not allowed");
+                return NULL;
+            }
+            g_string_append_unichar (out, ch);
+            break;
+        }
+        default:
+            Fail (parser, error, "unknown escape");
+            return NULL;
+        }
+    }
+    if (parser->p >= parser->end)
+    {
+        Fail (parser, error, "unterminated string");
+        return NULL;
+    }
+    parser->p++;
+    if (!g_utf8_validate (out->str, out->len, NULL))
+    {
+        Fail (parser, error, "string is not UTF-8");
+        return NULL;
+    }
+
+    return g_string_free (g_steal_pointer (&out), FALSE);
+}
+
+static GVariant *ParseNumber (JsonParser *parser, GError **error)
+{
+    const gchar *start = parser->p;
+    g_autofree gchar *copy = NULL;
+    gboolean integer = TRUE;
+    gchar *end;
+
+    if (parser->p < parser->end && *parser->p == '-')
+        parser->p++;
+    while (parser->p < parser->end &&
+           (g_ascii_isdigit (*parser->p) ||
+            (*parser->p != '\0' && strchr (".eE+-", *parser->p) != NULL)))
+    {
+        if (!g_ascii_isdigit (*parser->p))
+            integer = FALSE;
+        parser->p++;
+    }
+    copy = g_strndup (start, parser->p - start);
+    errno = 0;
+    if (integer)
+    {
+        gint64 value = g_ascii_strtoll (copy, &end, 10);
+
+        if (*end == '\0' && end != copy && errno == 0)
+            return g_variant_new_int64 (value);
+    }
+    else
+    {
+        gdouble value = g_ascii_strtod (copy, &end);
+
+        if (*end == '\0' && end != copy && errno == 0)
+            return g_variant_new_double (value);
+    }
+    parser->p = start;
+    Fail (parser, error, "bad number");
+
+    return NULL;
+}
+
+static gboolean ParseWord (JsonParser *parser, const gchar *word)
+{
+    gsize length = strlen (word);
+
+    if ((gsize) (parser->end - parser->p) >= length && memcmp (parser->p, word, length) == 0)
+    {
+        parser->p += length;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static GVariant *ParseObject (JsonParser *parser, guint depth, GError **error)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    if (Expect (parser, '}'))
+    {
+        return g_variant_builder_end (&builder);
+    }
+    do
+    {
+        g_autofree gchar *key = NULL;
+        GVariant *value;
+
+        key = ParseString (parser, error);
+        if (key == NULL)
+            goto failed;
+        if (!Expect (parser, ':'))
+        {
+            Fail (parser, error, "expected ':'");
+            goto failed;
+        }
+        if (!(value = ParseValue (parser, depth + 1, error)))
+            goto failed;
+        if (g_variant_is_of_type (value, G_VARIANT_TYPE ("mv")))
+        {
+            g_variant_unref (g_variant_ref_sink (value));
+            continue;
+        }
+        g_variant_builder_add (&builder, "{sv}", key, value);
+    } while (Expect (parser, ','));
+
+    if (Expect (parser, '}'))
+    {
+        return g_variant_builder_end (&builder);
+    }
+    Fail (parser, error, "expected ',' or '}'");
+failed:
+    g_variant_builder_clear (&builder);
+    return NULL;
+}
+
+static GVariant *ParseArray (JsonParser *parser, guint depth, GError **error)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("av"));
+    if (Expect (parser, ']'))
+    {
+        return g_variant_builder_end (&builder);
+    }
+    do
+    {
+        GVariant *value = ParseValue (parser, depth + 1, error);
+
+        if (value == NULL)
+        {
+            g_variant_builder_clear (&builder);
+            return NULL;
+        }
+        g_variant_builder_add (&builder, "v", value);
+    } while (Expect (parser, ','));
+
+    if (Expect (parser, ']'))
+    {
+        return g_variant_builder_end (&builder);
+    }
+    Fail (parser, error, "expected ',' or ']'");
+    g_variant_builder_clear (&builder);
+
+    return NULL;
+}
+
+static GVariant *ParseValue (JsonParser *parser, guint depth, GError **error)
+{
+    if (depth > JSON_MAX_DEPTH)
+    {
+        Fail (parser, error, "nested too deeply");
+        return NULL;
+    }
+    SkipSpace (parser);
+    if (parser->p >= parser->end)
+    {
+        Fail (parser, error, "unexpected end");
+        return NULL;
+    }
+    switch (*parser->p)
+    {
+    case '{':
+        parser->p++;
+        return ParseObject (parser, depth, error);
+    case '[':
+        parser->p++;
+        return ParseArray (parser, depth, error);
+    case '"':
+    {
+        gchar *value = ParseString (parser, error);
+
+        return value != NULL ? g_variant_new_take_string (value) : NULL;
+    }
+    default:
+        break;
+    }
+    if (ParseWord (parser, "true"))
+        return g_variant_new_boolean (TRUE);
+    if (ParseWord (parser, "false"))
+        return g_variant_new_boolean (FALSE);
+    if (ParseWord (parser, "null"))
+        return g_variant_new_maybe (G_VARIANT_TYPE_VARIANT, NULL);
+    if (*parser->p == '-' || g_ascii_isdigit (*parser->p))
+        return ParseNumber (parser, error);
+
+    Fail (parser, error, "unexpected character");
+    return NULL;
+}
+
+GVariant *json_variant_parse (const gchar *text, gsize length, GError **error)
+{
+    JsonParser parser = { text, text + length, text };
+    GVariant *value;
+
+    value = ParseValue (&parser, 0, error);
+    if (value == NULL)
+    {
+        return NULL;
+    }
+    g_variant_ref_sink (value);
+    SkipSpace (&parser);
+    if (parser.p != parser.end)
+    {
+        Fail (&parser, error, "trailing data");
+        g_variant_unref (value);
+        return NULL;
+    }
+
+    return value;
+}
+
+void json_append_string (GString *out, const gchar *value)
+{
+    const gchar *p;
+
+    g_string_append_c (out, '"');
+    for (p = value; *p != '\0'; p++)
+    {
+        guchar c = *p;
+
+        switch (c)
+        {
+        case '"':  g_string_append (out, "\\\""); break;
+        case '\\': g_string_append (out, "\\\\"); break;
+        case '\n': g_string_append (out, "\\n");  break;
+        case '\r': g_string_append (out, "\\r");  break;
+        case '\t': g_string_append (out, "\\t");  break;
+        default:
+            if (c < 0x20)
+                g_string_append_printf (out, "\\u%04x", c);
+            else
+                g_string_append_c (out, c);
+            break;
+        }
+    }
+    g_string_append_c (out, '"');
+}
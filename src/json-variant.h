@@ -0,0 +1,32 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __JSON_VARIANT_H__
+#define __JSON_VARIANT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Objects become a{sv} (members that are null are left out), arrays av,
+ * strings s, integers x, other numbers d and true/false b. */
+GVariant * json_variant_parse  (const gchar *text,
+                                gsize        length,
+                                GError     **error);
+void       json_append_string  (GString     *out,
+                                const gchar *value);
+
+G_END_DECLS
+
+#endif /* __JSON_VARIANT_H__ */
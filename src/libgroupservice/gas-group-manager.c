@@ -83,6 +83,7 @@ typedef struct
 
     gboolean               is_loaded;
     gboolean               list_cached_groups_done;
+    guint64                generation;
 } GasGroupManagerPrivate;
 
 enum
@@ -123,6 +124,11 @@ static void     update_group                    (GasGroupManager *manager,
                                                  GasGroup        *group);
 static gpointer group_manager_object = NULL;
 
+/* Set by gas_group_manager_set_peer_socket(), NULL is the system bus */
+static gchar           *peer_socket = NULL;
+static GDBusConnection *peer_connection = NULL;
+G_LOCK_DEFINE_STATIC (peer_connection);
+
 G_DEFINE_TYPE_WITH_PRIVATE (GasGroupManager, gas_group_manager, G_TYPE_OBJECT)
 
 static void g_free_list_data(gpointer data, gpointer userdata)
@@ -823,18 +829,40 @@ static void load_groups (GasGroupManager *manager)
     GError *error = NULL;
     g_auto(GStrv) group_paths = NULL;
     gboolean could_list = FALSE;
+    gboolean changed = TRUE;
+    guint64  generation = 0;
 
     if (!ensure_group_admin_proxy (manager))
     {
         g_print("check group_admin_proxy fail !!!\r\n");
         return;
     }
-    could_list = user_group_admin_call_list_cached_groups_sync (priv->group_admin_proxy,
-                                                                &group_paths,
-                                                                NULL, &error);
+    could_list = user_group_admin_call_list_cached_groups_if_changed_sync (priv->group_admin_proxy,
+                                                                           priv->generation,
+                                                                           &changed,
+                                                                           &generation,
+                                                                           &group_paths,
+                                                                           NULL, &error);
+    if (could_list)
+    {
+        if (!changed && priv->list_cached_groups_done)
+        {
+            return;
+        }
+        priv->generation = generation;
+    }
+    else
+    {
+        /* Daemon predates generations, fall back to a full listing */
+        g_clear_error (&error);
+        could_list = user_group_admin_call_list_cached_groups_sync (priv->group_admin_proxy,
+                                                                    &group_paths,
+                                                                    NULL, &error);
+    }
     if (!could_list)
     {
         g_print ("GasGroupManager: ListCachedGroups failed: %s", error->message);
+        g_error_free (error);
         return;
     }
 
@@ -981,7 +1009,7 @@ static gboolean ensure_group_admin_proxy (GasGroupManager *manager)
 
     priv->group_admin_proxy = user_group_admin_proxy_new_sync (priv->connection,
                                                                G_DBUS_PROXY_FLAGS_NONE,
-                                                               GROUPADMIN_NAME,
+                                                               _gas_get_bus_name (),
                                                                GROUPADMIN_PATH,
                                                                NULL,
                                                                &error);
@@ -1027,7 +1055,7 @@ static void gas_group_manager_init (GasGroupManager *manager)
                                                          g_free,
                                                          g_object_unref);
 
-    priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+    priv->connection = _gas_get_connection (&error);
     if (priv->connection == NULL)
     {
         if (error != NULL)
@@ -1089,6 +1117,59 @@ static void gas_group_manager_finalize (GObject *object)
     g_hash_table_destroy (priv->groups_by_object_path);
 }
 
+/* Talks to the daemon over its --peer-socket instead of the system bus.
+ * Has to come before gas_group_manager_get_default() or any other call;
+ * objects created earlier keep their bus connection. */
+void gas_group_manager_set_peer_socket (const char *path)
+{
+    G_LOCK (peer_connection);
+    g_free (peer_socket);
+    peer_socket = g_strdup (path);
+    g_clear_object (&peer_connection);
+    G_UNLOCK (peer_connection);
+}
+
+/* One connection shared by the manager, every group and snapshots */
+GDBusConnection *_gas_get_connection (GError **error)
+{
+    GDBusConnection *connection = NULL;
+
+    G_LOCK (peer_connection);
+    if (peer_socket == NULL)
+    {
+        G_UNLOCK (peer_connection);
+        return g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, error);
+    }
+    if (peer_connection != NULL && g_dbus_connection_is_closed (peer_connection))
+    {
+        g_clear_object (&peer_connection);
+    }
+    if (peer_connection == NULL)
+    {
+        g_autofree gchar *escaped = g_dbus_address_escape_value (peer_socket);
+        g_autofree gchar *address = g_strdup_printf ("unix:path=%s", escaped);
+
+        peer_connection = g_dbus_connection_new_for_address_sync (address,
+                                                                  G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                                  NULL,
+                                                                  NULL,
+                                                                  error);
+    }
+    if (peer_connection != NULL)
+    {
+        connection = g_object_ref (peer_connection);
+    }
+    G_UNLOCK (peer_connection);
+
+    return connection;
+}
+
+/* A peer connection has no bus, so calls and proxies name no destination */
+const char *_gas_get_bus_name (void)
+{
+    return peer_socket != NULL ? NULL : GROUPADMIN_NAME;
+}
+
 GasGroupManager *gas_group_manager_get_default (void)
 {
     if (group_manager_object == NULL)
@@ -59,6 +59,8 @@ GType                gas_group_manager_get_type              (void);
 
 GasGroupManager *    gas_group_manager_get_default           (void);
 
+void                 gas_group_manager_set_peer_socket       (const char      *path);
+
 gboolean             gas_group_manager_no_service            (GasGroupManager *manager);
 
 GSList *             gas_group_manager_list_groups           (GasGroupManager *manager);
@@ -16,12 +16,15 @@
 #define __GAS_GROUP_PRIVATE_H_
 
 #include <pwd.h>
+#include <gio/gio.h>
 #include "gas-group.h"
 
 G_BEGIN_DECLS
 
 void           _gas_group_update_from_object_path   (GasGroup  *group,
                                                     const char *object_path);
+GDBusConnection * _gas_get_connection               (GError   **error);
+const char *   _gas_get_bus_name                    (void);
 G_END_DECLS
 
 #endif
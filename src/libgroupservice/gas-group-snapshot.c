@@ -0,0 +1,219 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <unistd.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#include "gas-group-private.h"
+#include "gas-group-snapshot.h"
+#include "snapshot-reader.h"
+
+#define GROUPADMIN_PATH      "/org/group/admin"
+#define GROUPADMIN_INTERFACE "org.group.admin"
+
+/*
+ * Read-only view of the daemon's group table in shared memory. Lookups
+ * touch only the mapping; the bus is used to fetch the table and, when
+ * the kernel could not leave the daemon a way to flag a stale table, to
+ * compare generations in gas_group_snapshot_refresh().
+ */
+struct _GasGroupSnapshot
+{
+    GDBusConnection *connection;
+    GsSnapshot       map;
+};
+
+static gboolean map_snapshot (GasGroupSnapshot *snapshot, GError **error)
+{
+    g_autoptr(GVariant) reply = NULL;
+    g_autoptr(GUnixFDList) fd_list = NULL;
+    GsSnapshot map;
+    gint32 index;
+    gint fd, ret;
+
+    reply = g_dbus_connection_call_with_unix_fd_list_sync (snapshot->connection,
+                                                           _gas_get_bus_name (),
+                                                           GROUPADMIN_PATH,
+                                                           GROUPADMIN_INTERFACE,
+                                                           "OpenSnapshot",
+                                                           NULL,
+                                                           G_VARIANT_TYPE ("(h)"),
+                                                           G_DBUS_CALL_FLAGS_NONE,
+                                                           -1,
+                                                           NULL,
+                                                           &fd_list,
+                                                           NULL,
+                                                           error);
+    if (reply == NULL)
+    {
+        return FALSE;
+    }
+    g_variant_get (reply, "(h)", &index);
+    fd = g_unix_fd_list_get (fd_list, index, error);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+    ret = gs_snapshot_map (fd, &map);
+    close (fd);
+    if (ret < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (-ret),
+                     "Unable to map group snapshot: %s", g_strerror (-ret));
+        return FALSE;
+    }
+
+    gs_snapshot_unmap (&snapshot->map);
+    snapshot->map = map;
+
+    return TRUE;
+}
+
+static gboolean is_current (GasGroupSnapshot *snapshot)
+{
+    g_autoptr(GVariant) reply = NULL;
+    g_autoptr(GVariant) value = NULL;
+
+    if (!(snapshot->map.header->flags & GS_SNAPSHOT_FLAG_STATIC))
+    {
+        return gs_snapshot_is_current (&snapshot->map);
+    }
+
+    reply = g_dbus_connection_call_sync (snapshot->connection,
+                                         _gas_get_bus_name (),
+                                         GROUPADMIN_PATH,
+                                         "org.freedesktop.DBus.Properties",
+                                         "Get",
+                                         g_variant_new ("(ss)", GROUPADMIN_INTERFACE, "Generation"),
+                                         G_VARIANT_TYPE ("(v)"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1,
+                                         NULL,
+                                         NULL);
+    if (reply == NULL)
+    {
+        return TRUE;
+    }
+    g_variant_get (reply, "(v)", &value);
+
+    return g_variant_get_uint64 (value) == snapshot->map.header->generation;
+}
+
+/* Maps the daemon's current group table */
+GasGroupSnapshot *gas_group_snapshot_open (GError **error)
+{
+    GasGroupSnapshot *snapshot;
+
+    snapshot = g_new0 (GasGroupSnapshot, 1);
+    snapshot->connection = _gas_get_connection (error);
+    if (snapshot->connection == NULL || !map_snapshot (snapshot, error))
+    {
+        gas_group_snapshot_free (snapshot);
+        return NULL;
+    }
+
+    return snapshot;
+}
+
+void gas_group_snapshot_free (GasGroupSnapshot *snapshot)
+{
+    gs_snapshot_unmap (&snapshot->map);
+    g_clear_object (&snapshot->connection);
+    g_free (snapshot);
+}
+
+/* Maps a new table if the daemon's groups changed since this one was
+ * built. On error the old table stays mapped. */
+gboolean gas_group_snapshot_refresh (GasGroupSnapshot *snapshot, GError **error)
+{
+    if (is_current (snapshot))
+    {
+        return TRUE;
+    }
+
+    return map_snapshot (snapshot, error);
+}
+
+guint64 gas_group_snapshot_get_generation (GasGroupSnapshot *snapshot)
+{
+    return snapshot->map.header->generation;
+}
+
+guint gas_group_snapshot_get_n_groups (GasGroupSnapshot *snapshot)
+{
+    return snapshot->map.header->n_groups;
+}
+
+gboolean gas_group_snapshot_lookup_name (GasGroupSnapshot *snapshot,
+                                         const char       *name,
+                                         gid_t            *gid)
+{
+    const GsSnapshotGroup *group;
+
+    group = gs_snapshot_find_name (&snapshot->map, name);
+    if (group == NULL)
+    {
+        return FALSE;
+    }
+    if (gid != NULL)
+    {
+        *gid = group->gid;
+    }
+
+    return TRUE;
+}
+
+/* The name stays valid until the next refresh */
+const char *gas_group_snapshot_lookup_gid (GasGroupSnapshot *snapshot, gid_t gid)
+{
+    const GsSnapshotGroup *group;
+
+    group = gs_snapshot_find_gid (&snapshot->map, gid);
+    if (group == NULL)
+    {
+        return NULL;
+    }
+
+    return gs_snapshot_group_name (&snapshot->map, group);
+}
+
+/* NULL if there is no such group, free with g_strfreev() */
+char **gas_group_snapshot_get_members (GasGroupSnapshot *snapshot, const char *name)
+{
+    const GsSnapshotGroup *group;
+    GPtrArray *members;
+    guint32 i;
+
+    group = gs_snapshot_find_name (&snapshot->map, name);
+    if (group == NULL)
+    {
+        return NULL;
+    }
+    members = g_ptr_array_sized_new (group->n_members + 1);
+    for (i = 0; i < group->n_members; i++)
+    {
+        const char *member = gs_snapshot_group_member (&snapshot->map, group, i);
+
+        if (member != NULL)
+        {
+            g_ptr_array_add (members, g_strdup (member));
+        }
+    }
+    g_ptr_array_add (members, NULL);
+
+    return (char **) g_ptr_array_free (members, FALSE);
+}
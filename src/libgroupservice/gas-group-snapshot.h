@@ -0,0 +1,50 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __GAS_GROUP_SNAPSHOT_H__
+#define __GAS_GROUP_SNAPSHOT_H__
+
+#include <sys/types.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GasGroupSnapshot GasGroupSnapshot;
+
+GasGroupSnapshot * gas_group_snapshot_open           (GError           **error);
+
+void               gas_group_snapshot_free           (GasGroupSnapshot  *snapshot);
+
+gboolean           gas_group_snapshot_refresh        (GasGroupSnapshot  *snapshot,
+                                                      GError           **error);
+
+guint64            gas_group_snapshot_get_generation (GasGroupSnapshot  *snapshot);
+
+guint              gas_group_snapshot_get_n_groups   (GasGroupSnapshot  *snapshot);
+
+gboolean           gas_group_snapshot_lookup_name    (GasGroupSnapshot  *snapshot,
+                                                      const char        *name,
+                                                      gid_t             *gid);
+
+const char *       gas_group_snapshot_lookup_gid     (GasGroupSnapshot  *snapshot,
+                                                      gid_t              gid);
+
+char **            gas_group_snapshot_get_members    (GasGroupSnapshot  *snapshot,
+                                                      const char        *name);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GasGroupSnapshot, gas_group_snapshot_free)
+
+G_END_DECLS
+
+#endif
@@ -30,7 +30,6 @@
 #define GAS_IS_GROUP_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GAS_TYPE_GROUP))
 #define GAS_GROUP_GET_CLASS(object) (G_TYPE_INSTANCE_GET_CLASS ((object), GAS_TYPE_GROUP, GasGRoupClass))
 
-#define GROUP_NAME           "org.group.admin"
 #define GROUP_LSIT_INTERFACE "org.group.admin.list"
 
 enum
@@ -143,7 +142,7 @@ static void gas_group_init (GasGroup *group)
 {
     g_autoptr(GError) error = NULL;
 
-    group->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+    group->connection = _gas_get_connection (&error);
     if (group->connection == NULL)
     {
         g_warning ("Couldn't connect to system bus: %s", error->message);
@@ -185,7 +184,7 @@ static void reload_proxy(GasGroup *group)
 
     group_proxy = user_group_list_proxy_new_sync (group->connection,
                                                   G_DBUS_PROXY_FLAGS_NONE,
-                                                  GROUP_NAME,
+                                                  _gas_get_bus_name (),
                                                   object_path,
                                                   NULL,
                                                   &error);
@@ -227,13 +226,49 @@ int gas_group_collate (GasGroup *group1, GasGroup *group2)
     return g_utf8_collate (str1, str2);
 }
 
+/* The daemon only invalidates Users when it changes, so the cached copy
+ * may be gone; fetch it again on the first read after that. */
 char const **gas_group_get_group_users (GasGroup *group)
 {
+    g_autoptr(GVariant) reply = NULL;
+    g_autoptr(GVariant) users = NULL;
+    g_autoptr(GError) error = NULL;
+    const char **cached;
+
     g_return_val_if_fail (GAS_IS_GROUP (group), NULL);
 
     if (group->group_proxy == NULL)
         return NULL;
-    return user_group_list_get_users(group->group_proxy);
+    cached = (const char **) user_group_list_get_users (group->group_proxy);
+    if (cached != NULL)
+        return cached;
+
+    reply = g_dbus_proxy_call_sync (G_DBUS_PROXY (group->group_proxy),
+                                    "org.freedesktop.DBus.Properties.Get",
+                                    g_variant_new ("(ss)", GROUP_LSIT_INTERFACE, "Users"),
+                                    G_DBUS_CALL_FLAGS_NONE,
+                                    -1,
+                                    NULL,
+                                    &error);
+    if (reply == NULL)
+    {
+        g_warning ("Couldn't read the group members: %s", error->message);
+        return NULL;
+    }
+    g_variant_get (reply, "(v)", &users);
+    g_dbus_proxy_set_cached_property (G_DBUS_PROXY (group->group_proxy), "Users", users);
+
+    return (const char **) user_group_list_get_users (group->group_proxy);
+}
+
+guint gas_group_get_member_count (GasGroup *group)
+{
+    g_return_val_if_fail (GAS_IS_GROUP (group), 0);
+
+    if (group->group_proxy == NULL)
+        return 0;
+
+    return user_group_list_get_member_count (group->group_proxy);
 }
 
 gboolean gas_group_is_local_group(GasGroup *group)
@@ -268,22 +303,53 @@ const char * gas_group_get_group_name (GasGroup *group)
     return user_group_list_get_group_name(group->group_proxy);
 }
 
+/* Asks the daemon, which keeps a hashed member set for large groups,
+ * rather than fetching and scanning Users here */
 gboolean gas_group_user_is_group (GasGroup *group, const char *user)
 {
+    g_autoptr(GError) error = NULL;
+    gboolean member = FALSE;
     char const **users;
     int i = 0;
+
     g_return_val_if_fail (GAS_IS_GROUP (group), FALSE);
     g_return_val_if_fail (user != NULL, FALSE);
     g_return_val_if_fail (getpwnam(user) != NULL, FALSE);
     g_return_val_if_fail (USER_GROUP_IS_LIST (group->group_proxy), FALSE);
-    users = gas_group_get_group_users(group);
-    while(users[i] != NULL)
+
+    if (!user_group_list_call_is_member_sync (group->group_proxy,
+                                              user,
+                                              &member,
+                                              NULL,
+                                              &error))
     {
-        if(g_strcmp0(users[i], user) == 0)
-            return TRUE;
-        i++;
+        if (!g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD))
+        {
+            g_warning ("IsMember call failed: %s", error->message);
+            return FALSE;
+        }
+        /* Daemon predates IsMember, scan the members here */
+        users = gas_group_get_group_users (group);
+        while (users != NULL && users[i] != NULL)
+        {
+            if (g_strcmp0 (users[i], user) == 0)
+                return TRUE;
+            i++;
+        }
+        return FALSE;
     }
-    return FALSE;
+
+    return member;
+}
+
+guint64 gas_group_get_revision (GasGroup *group)
+{
+    g_return_val_if_fail (GAS_IS_GROUP (group), 0);
+
+    if (group->group_proxy == NULL)
+        return 0;
+
+    return user_group_list_get_revision (group->group_proxy);
 }
 
 const char * gas_group_get_object_path (GasGroup *group)
@@ -342,7 +408,7 @@ void _gas_group_update_from_object_path (GasGroup *group,
 
     group_proxy = user_group_list_proxy_new_sync (group->connection,
                                                   G_DBUS_PROXY_FLAGS_NONE,
-                                                  GROUP_NAME,
+                                                  _gas_get_bus_name (),
                                                   object_path,
                                                   NULL,
                                                   &error);
@@ -36,6 +36,8 @@ gid_t          gas_group_get_gid                   (GasGroup   *Group);
 
 const char    *gas_group_get_group_name            (GasGroup   *Group);
 
+guint64        gas_group_get_revision              (GasGroup   *Group);
+
 gboolean       gas_group_is_local_group            (GasGroup   *Group);
 
 gboolean       gas_group_is_primary_group          (GasGroup   *Group);
@@ -45,6 +47,8 @@ gboolean       gas_group_user_is_group             (GasGroup   *Group,
 
 char const **  gas_group_get_group_users           (GasGroup   *Group);
 
+guint          gas_group_get_member_count          (GasGroup   *Group);
+
 gint           gas_group_collate                   (GasGroup   *Group1,
                                                     GasGroup   *Group2);
 
@@ -17,5 +17,6 @@
 #include <gas/gas-group-enum-types.h>
 #include <gas/gas-group.h>
 #include <gas/gas-group-manager.h>
+#include <gas/gas-group-snapshot.h>
 
 #endif
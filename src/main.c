@@ -14,28 +14,94 @@
 */
 #include <stdlib.h>
 #include <stdio.h>
+#include <signal.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <glib-unix.h>
 #include "group-server.h"
+#include "probes.h"
+#include "stats.h"
 
 #define NAME_TO_CLAIM    "org.group.admin"
 #define PACKAGE          "group-service"
 #define LOCALEDIR        "/usr/share/locale/"
 
 static GMainLoop *loop = NULL;
+static Manage    *manage = NULL;
+static guint      OwnID = 0;
+static gint64     StartTime = 0;
+static gchar     *root = NULL;
+static gchar     *helper_dir = NULL;
+static gint       nss_page_size = 0;
+static gint       negative_ttl = -1;
+static gint       max_mutations = 4;
+static gint       mutation_rate = 0;
+static gchar     *cache_path = NULL;
+static gchar     *snapshot_path = NULL;
+static gboolean   userdb = FALSE;
+static gchar     *userdb_socket = NULL;
+static gchar     *peer_socket = NULL;
+static gint       idle_exit = 0;
+
+static GOptionEntry entries[] =
+{
+    { "root", 0, 0, G_OPTION_ARG_FILENAME, &root,
+      "Read passwd, shadow and group below DIR instead of /", "DIR" },
+    { "helper-dir", 0, 0, G_OPTION_ARG_FILENAME, &helper_dir,
+      "Run groupadd, groupdel, groupmems and groupmod from DIR", "DIR" },
+    { "enumerate-nss", 0, 0, G_OPTION_ARG_INT, &nss_page_size,
+      "Also list NSS directory groups, fetched N per page in the background", "N" },
+    { "negative-ttl", 0, 0, G_OPTION_ARG_INT, &negative_ttl,
+      "Remember failed group lookups for SECONDS, 0 disables (default 30)", "SECONDS" },
+    { "max-mutations", 0, 0, G_OPTION_ARG_INT, &max_mutations,
+      "Run at most N changes between authorization and reply (default 4)", "N" },
+    { "mutation-rate", 0, 0, G_OPTION_ARG_INT, &mutation_rate,
+      "Let each caller start N changes per second, 0 for no limit", "N" },
+    { "cache", 0, 0, G_OPTION_ARG_FILENAME, &cache_path,
+      "Keep the parsed groups in FILE between runs", "FILE" },
+    { "snapshot-path", 0, 0, G_OPTION_ARG_FILENAME, &snapshot_path,
+      "Publish the group table for libnss_groupservice at FILE, empty disables", "FILE" },
+    { "userdb", 0, 0, G_OPTION_ARG_NONE, &userdb,
+      "Serve io.systemd.UserDatabase on /run/systemd/userdb/" NAME_TO_CLAIM, NULL },
+    { "userdb-socket", 0, 0, G_OPTION_ARG_FILENAME, &userdb_socket,
+      "Serve io.systemd.UserDatabase on SOCKET instead", "SOCKET" },
+    { "peer-socket", 0, 0, G_OPTION_ARG_FILENAME, &peer_socket,
+      "Also accept direct D-Bus connections from root on SOCKET", "SOCKET" },
+    { "idle-exit", 0, 0, G_OPTION_ARG_INT, &idle_exit,
+      "Exit after SECONDS without calls, for bus activation", "SECONDS" },
+    { NULL }
+};
+
 static gboolean SignalQuit (gpointer data)
 {
     g_main_loop_quit (data);
     return FALSE;
 }
 
+/* Gives up the name first so new callers activate a fresh instance,
+ * then drains whatever was already queued for this one. */
+static gboolean IdleCheck (gpointer data)
+{
+    if (manage == NULL || !ManageIsIdle (manage, idle_exit))
+    {
+        return TRUE;
+    }
+    g_debug ("Idle for %d seconds, exiting", idle_exit);
+    g_bus_unown_name (OwnID);
+    OwnID = 0;
+    g_timeout_add (100, SignalQuit, loop);
+
+    return FALSE;
+}
+
 static void AcquiredCallback (GDBusConnection *Connection,
                               const gchar *name,
                               gpointer UserData)
 {
-    Manage *manage;
+    gint64 PhaseStart, Now;
 
+    PhaseStart = g_get_monotonic_time ();
+    stats_startup_phase (STATS_STARTUP_BUS, PhaseStart - StartTime);
     manage = manage_new();
     if (manage == NULL)
     {
@@ -43,11 +109,23 @@ static void AcquiredCallback (GDBusConnection *Connection,
         g_main_loop_quit (loop);
         return;
     }
+    Now = g_get_monotonic_time ();
+    stats_startup_phase (STATS_STARTUP_LOAD, Now - PhaseStart);
+    PhaseStart = Now;
 
     if(RegisterGroupManage (manage) < 0)
     {
         printf("error !!!\r\n");;
     }
+    Now = g_get_monotonic_time ();
+    stats_startup_phase (STATS_STARTUP_EXPORT, Now - PhaseStart);
+    stats_startup_phase (STATS_STARTUP_TOTAL, Now - StartTime);
+    GS_PROBE1 (startup__done, Now - StartTime);
+
+    if (idle_exit > 0)
+    {
+        g_timeout_add_seconds (MIN (idle_exit, 10), IdleCheck, NULL);
+    }
 }
 
 static void NameLostCallback (GDBusConnection *connection,
@@ -60,14 +138,66 @@ static void NameLostCallback (GDBusConnection *connection,
 
 int main (int argc, char *argv[])
 {
-    guint OwnID;
+    g_autoptr(GOptionContext) context = NULL;
+    g_autoptr(GError) error = NULL;
 
+    StartTime = g_get_monotonic_time ();
+    /* Our own lookups, and those of the helpers we spawn, must not be
+     * routed by nss-systemd back to our userdb socket: the main loop
+     * that would answer them is the one waiting */
+    g_setenv ("SYSTEMD_BYPASS_USERDB", NAME_TO_CLAIM, TRUE);
     bind_textdomain_codeset (PACKAGE, "UTF-8");
     setlocale (LC_ALL, "");
 #if !GLIB_CHECK_VERSION (2, 35, 3)
     g_type_init ();
 #endif
 
+    context = g_option_context_new (NULL);
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    if (root != NULL)
+    {
+        ManageSetRoot (root);
+    }
+    if (helper_dir != NULL)
+    {
+        set_helper_dir (helper_dir);
+    }
+    if (nss_page_size > 0)
+    {
+        ManageSetNssEnumeration (nss_page_size);
+    }
+    if (negative_ttl >= 0)
+    {
+        ManageSetNegativeTtl (negative_ttl);
+    }
+    if (max_mutations < 1 || mutation_rate < 0)
+    {
+        g_printerr ("--max-mutations must be positive and --mutation-rate not negative\n");
+        return EXIT_FAILURE;
+    }
+    ManageSetMutationLimits (max_mutations, mutation_rate);
+    if (cache_path != NULL)
+    {
+        ManageSetCachePath (cache_path);
+    }
+    if (snapshot_path != NULL)
+    {
+        ManageSetSnapshotPath (snapshot_path);
+    }
+    if (userdb || userdb_socket != NULL)
+    {
+        ManageEnableUserdb (userdb_socket);
+    }
+    if (peer_socket != NULL)
+    {
+        ManageSetPeerSocket (peer_socket);
+    }
+
     OwnID = g_bus_own_name (G_BUS_TYPE_SYSTEM,
                             NAME_TO_CLAIM,
                             G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT,
@@ -79,11 +209,23 @@ int main (int argc, char *argv[])
 
     loop = g_main_loop_new (NULL, FALSE);
 
+    /* A reader closing its end of a DumpGroups pipe must fail the write,
+     * not kill the daemon */
+    signal (SIGPIPE, SIG_IGN);
     g_unix_signal_add (SIGINT,  SignalQuit, loop);
     g_unix_signal_add (SIGTERM, SignalQuit, loop);
 
     g_main_loop_run (loop);
-    g_bus_unown_name(OwnID);
+    if (OwnID > 0)
+    {
+        g_bus_unown_name(OwnID);
+    }
+    if (manage != NULL)
+    {
+        ManageStopListeners (manage);
+        ManageWithdrawSnapshot (manage);
+        ManageSaveCache (manage);
+    }
     g_main_loop_unref (loop);
 
     return 0;
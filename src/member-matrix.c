@@ -0,0 +1,173 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+
+#include "member-matrix.h"
+
+/*
+ * Packs "which of these users are in which of these groups" into one bit
+ * per pair. There is a row per group, in request order. Bit j of a row is
+ * users[j] and sits in byte j / 8 at bit j % 8. Each row is padded to a
+ * whole number of 64-bit words, so a client can count a group's members
+ * among the users with one popcount per word.
+ *
+ * The requested users are resolved to name ids once. A bitmap over those
+ * ids lets the walk over a group's member ids skip anyone who was not
+ * asked about without a hash lookup.
+ */
+
+#define NO_COLUMN G_MAXUINT
+
+struct MemberMatrix
+{
+    guint       n_users;
+    gsize       row_words;
+    GArray     *rows;           /* guint64, little endian */
+    GHashTable *first_column;   /* NameId + 1 -> column + 1 */
+    guint      *next_column;    /* the same name asked for again, or NO_COLUMN */
+    guint64    *wanted;         /* bitmap over name ids */
+    NameId      max_id;
+};
+
+gsize member_matrix_row_bytes (guint n_users)
+{
+    return ((gsize) n_users + 63) / 64 * sizeof (guint64);
+}
+
+MemberMatrix *member_matrix_new (NamePool *names, const gchar *const *users)
+{
+    MemberMatrix *matrix;
+    NameId *ids;
+    guint  *last_column;
+    guint   i;
+
+    matrix = g_new0 (MemberMatrix, 1);
+    matrix->n_users = g_strv_length ((gchar **) users);
+    matrix->row_words = member_matrix_row_bytes (matrix->n_users) / sizeof (guint64);
+    matrix->rows = g_array_new (FALSE, TRUE, sizeof (guint64));
+    matrix->first_column = g_hash_table_new (g_direct_hash, g_direct_equal);
+    matrix->next_column = g_new (guint, matrix->n_users);
+    ids = g_new (NameId, matrix->n_users);
+    last_column = g_new (guint, matrix->n_users);
+
+    for (i = 0; i < matrix->n_users; i++)
+    {
+        gpointer first;
+        guint    column;
+
+        matrix->next_column[i] = NO_COLUMN;
+        ids[i] = name_pool_find (names, users[i]);
+        if (ids[i] == NAME_ID_INVALID)
+        {
+            continue;
+        }
+        matrix->max_id = MAX (matrix->max_id, ids[i]);
+        first = g_hash_table_lookup (matrix->first_column, GUINT_TO_POINTER (ids[i] + 1));
+        if (first == NULL)
+        {
+            g_hash_table_insert (matrix->first_column,
+                                 GUINT_TO_POINTER (ids[i] + 1),
+                                 GUINT_TO_POINTER (i + 1));
+            last_column[i] = i;
+            continue;
+        }
+        column = GPOINTER_TO_UINT (first) - 1;
+        matrix->next_column[last_column[column]] = i;
+        last_column[column] = i;
+    }
+
+    matrix->wanted = g_new0 (guint64, matrix->max_id / 64 + 1);
+    for (i = 0; i < matrix->n_users; i++)
+    {
+        if (ids[i] != NAME_ID_INVALID)
+            matrix->wanted[ids[i] / 64] |= G_GUINT64_CONSTANT (1) << (ids[i] % 64);
+    }
+    g_free (last_column);
+    g_free (ids);
+
+    return matrix;
+}
+
+void member_matrix_free (MemberMatrix *matrix)
+{
+    if (matrix == NULL)
+        return;
+
+    if (matrix->rows != NULL)
+        g_array_free (matrix->rows, TRUE);
+    g_hash_table_destroy (matrix->first_column);
+    g_free (matrix->next_column);
+    g_free (matrix->wanted);
+    g_free (matrix);
+}
+
+/* Appends the row for record, or a row of zeros for NULL. Only the
+ * members listed in the file count, not a primary user standing in for an
+ * empty list. */
+void member_matrix_add_row (MemberMatrix *matrix, const GroupRecord *record)
+{
+    guint64 *row;
+    guint    n;
+
+    g_array_set_size (matrix->rows, matrix->rows->len + matrix->row_words);
+    row = &g_array_index (matrix->rows, guint64, matrix->rows->len - matrix->row_words);
+    if (record == NULL)
+    {
+        return;
+    }
+
+    for (n = record->primary_member ? 1 : 0; n < record->n_members; n++)
+    {
+        NameId id = record->members[n];
+        gpointer first;
+        guint column;
+
+        if (id > matrix->max_id ||
+            (matrix->wanted[id / 64] & (G_GUINT64_CONSTANT (1) << (id % 64))) == 0)
+        {
+            continue;
+        }
+        first = g_hash_table_lookup (matrix->first_column, GUINT_TO_POINTER (id + 1));
+        for (column = GPOINTER_TO_UINT (first) - 1; column != NO_COLUMN; column = matrix->next_column[column])
+        {
+            row[column / 64] |= G_GUINT64_CONSTANT (1) << (column % 64);
+        }
+    }
+}
+
+/* Returns the rows as a floating "ay"; the matrix takes no more rows */
+GVariant *member_matrix_steal (MemberMatrix *matrix)
+{
+    guint64 *words;
+    gsize    n_words;
+    gsize    i;
+
+    n_words = matrix->rows->len;
+    words = (guint64 *) (gpointer) g_array_free (matrix->rows, FALSE);
+    matrix->rows = NULL;
+    for (i = 0; i < n_words; i++)
+    {
+        words[i] = GUINT64_TO_LE (words[i]);
+    }
+
+    return g_variant_new_from_data (G_VARIANT_TYPE_BYTESTRING,
+                                    words,
+                                    n_words * sizeof (guint64),
+                                    TRUE,
+                                    g_free,
+                                    words);
+}
@@ -0,0 +1,35 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __MEMBER_MATRIX_H__
+#define __MEMBER_MATRIX_H__
+
+#include <glib.h>
+#include "group-snapshot.h"
+
+G_BEGIN_DECLS
+
+typedef struct MemberMatrix MemberMatrix;
+
+MemberMatrix * member_matrix_new         (NamePool           *names,
+                                          const gchar *const *users);
+void           member_matrix_free        (MemberMatrix       *matrix);
+void           member_matrix_add_row     (MemberMatrix       *matrix,
+                                          const GroupRecord  *record);
+gsize          member_matrix_row_bytes   (guint               n_users);
+GVariant *     member_matrix_steal       (MemberMatrix       *matrix);
+
+G_END_DECLS
+
+#endif /* __MEMBER_MATRIX_H__ */
@@ -0,0 +1,154 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <glib.h>
+
+#include "name-pool.h"
+
+/*
+ * Refcounted string pool shared by all groups of the daemon. Every user
+ * and group name is stored once, and groups refer to it by a compact id,
+ * so membership lists are arrays of NameId and compare with memcmp.
+ * Ids of names that are no longer referenced go on a free list and are
+ * handed out again by the next intern.
+ */
+
+typedef struct
+{
+    gchar *name;
+    guint  refs;
+} NameEntry;
+
+struct NamePool
+{
+    GHashTable *ids;
+    GArray     *entries;
+    GArray     *free_ids;
+};
+
+NamePool *name_pool_new (void)
+{
+    NamePool *pool;
+
+    pool = g_new0 (NamePool, 1);
+    pool->ids = g_hash_table_new (g_str_hash, g_str_equal);
+    pool->entries = g_array_new (FALSE, TRUE, sizeof (NameEntry));
+    pool->free_ids = g_array_new (FALSE, FALSE, sizeof (NameId));
+
+    return pool;
+}
+
+void name_pool_free (NamePool *pool)
+{
+    guint i;
+
+    if (pool == NULL)
+        return;
+
+    for (i = 0; i < pool->entries->len; i++)
+    {
+        g_free (g_array_index (pool->entries, NameEntry, i).name);
+    }
+    g_hash_table_destroy (pool->ids);
+    g_array_free (pool->entries, TRUE);
+    g_array_free (pool->free_ids, TRUE);
+    g_free (pool);
+}
+
+NameId name_pool_find (NamePool *pool, const gchar *name)
+{
+    gpointer value;
+
+    if (name == NULL)
+        return NAME_ID_INVALID;
+
+    if (!g_hash_table_lookup_extended (pool->ids, name, NULL, &value))
+        return NAME_ID_INVALID;
+
+    return GPOINTER_TO_UINT (value);
+}
+
+NameId name_pool_intern (NamePool *pool, const gchar *name)
+{
+    NameEntry *entry;
+    NameId     id;
+
+    g_return_val_if_fail (name != NULL, NAME_ID_INVALID);
+
+    id = name_pool_find (pool, name);
+    if (id != NAME_ID_INVALID)
+    {
+        g_array_index (pool->entries, NameEntry, id).refs++;
+        return id;
+    }
+
+    if (pool->free_ids->len > 0)
+    {
+        id = g_array_index (pool->free_ids, NameId, pool->free_ids->len - 1);
+        g_array_set_size (pool->free_ids, pool->free_ids->len - 1);
+    }
+    else
+    {
+        id = pool->entries->len;
+        g_array_set_size (pool->entries, id + 1);
+    }
+
+    entry = &g_array_index (pool->entries, NameEntry, id);
+    entry->name = g_strdup (name);
+    entry->refs = 1;
+    g_hash_table_insert (pool->ids, entry->name, GUINT_TO_POINTER (id));
+
+    return id;
+}
+
+void name_pool_ref (NamePool *pool, NameId id)
+{
+    g_return_if_fail (id < pool->entries->len);
+
+    g_array_index (pool->entries, NameEntry, id).refs++;
+}
+
+void name_pool_release (NamePool *pool, NameId id)
+{
+    NameEntry *entry;
+
+    if (id == NAME_ID_INVALID)
+        return;
+    g_return_if_fail (id < pool->entries->len);
+
+    entry = &g_array_index (pool->entries, NameEntry, id);
+    g_return_if_fail (entry->refs > 0);
+
+    if (--entry->refs > 0)
+        return;
+
+    g_hash_table_remove (pool->ids, entry->name);
+    g_free (entry->name);
+    entry->name = NULL;
+    g_array_append_val (pool->free_ids, id);
+}
+
+const gchar *name_pool_lookup (NamePool *pool, NameId id)
+{
+    if (id >= pool->entries->len)
+        return NULL;
+
+    return g_array_index (pool->entries, NameEntry, id).name;
+}
+
+guint name_pool_size (NamePool *pool)
+{
+    return g_hash_table_size (pool->ids);
+}
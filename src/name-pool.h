@@ -0,0 +1,43 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __NAME_POOL_H__
+#define __NAME_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef guint32 NameId;
+typedef struct NamePool NamePool;
+
+#define NAME_ID_INVALID ((NameId) G_MAXUINT32)
+
+NamePool *    name_pool_new          (void);
+void          name_pool_free         (NamePool    *pool);
+NameId        name_pool_intern       (NamePool    *pool,
+                                      const gchar *name);
+void          name_pool_ref          (NamePool    *pool,
+                                      NameId       id);
+void          name_pool_release      (NamePool    *pool,
+                                      NameId       id);
+NameId        name_pool_find         (NamePool    *pool,
+                                      const gchar *name);
+const gchar * name_pool_lookup       (NamePool    *pool,
+                                      NameId       id);
+guint         name_pool_size         (NamePool    *pool);
+
+G_END_DECLS
+
+#endif /* __NAME_POOL_H__ */
@@ -0,0 +1,166 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <glib.h>
+
+#include "negative-cache.h"
+
+/*
+ * Remembers names and gids that NSS recently said do not exist, so that
+ * repeated lookups of stale groups do not reach a network directory.
+ * Every entry gets the same TTL, which makes insertion order also expiry
+ * order: expired and evicted entries always come off the head of a FIFO.
+ * Names and gids share one table with distinct key prefixes.
+ */
+
+typedef struct
+{
+    gchar  *key;
+    gint64  expires;
+} NegativeEntry;
+
+struct NegativeCache
+{
+    GHashTable *entries;        /* set of keys, owned by order */
+    GQueue      order;          /* NegativeEntry, oldest first */
+    guint       max_entries;
+    gint64      ttl_usec;
+    guint64     hits;
+    guint64     misses;
+    guint64     evictions;
+};
+
+NegativeCache *negative_cache_new (guint max_entries, gint64 ttl_usec)
+{
+    NegativeCache *cache;
+
+    cache = g_new0 (NegativeCache, 1);
+    cache->entries = g_hash_table_new (g_str_hash, g_str_equal);
+    g_queue_init (&cache->order);
+    cache->max_entries = max_entries;
+    cache->ttl_usec = ttl_usec;
+
+    return cache;
+}
+
+static void negative_entry_free (NegativeEntry *entry)
+{
+    g_free (entry->key);
+    g_free (entry);
+}
+
+static void negative_cache_pop (NegativeCache *cache)
+{
+    NegativeEntry *entry = g_queue_pop_head (&cache->order);
+
+    g_hash_table_remove (cache->entries, entry->key);
+    negative_entry_free (entry);
+}
+
+static void negative_cache_expire (NegativeCache *cache)
+{
+    gint64 now = g_get_monotonic_time ();
+
+    while (!g_queue_is_empty (&cache->order) &&
+           ((NegativeEntry *) g_queue_peek_head (&cache->order))->expires <= now)
+    {
+        negative_cache_pop (cache);
+    }
+}
+
+void negative_cache_clear (NegativeCache *cache)
+{
+    g_hash_table_remove_all (cache->entries);
+    g_queue_foreach (&cache->order, (GFunc) negative_entry_free, NULL);
+    g_queue_clear (&cache->order);
+}
+
+void negative_cache_free (NegativeCache *cache)
+{
+    negative_cache_clear (cache);
+    g_hash_table_destroy (cache->entries);
+    g_free (cache);
+}
+
+static gboolean negative_cache_has (NegativeCache *cache, const gchar *key)
+{
+    negative_cache_expire (cache);
+    if (g_hash_table_contains (cache->entries, key))
+    {
+        cache->hits++;
+        return TRUE;
+    }
+    cache->misses++;
+
+    return FALSE;
+}
+
+static void negative_cache_add (NegativeCache *cache, gchar *key)
+{
+    NegativeEntry *entry;
+
+    if (cache->max_entries == 0 || cache->ttl_usec <= 0 ||
+        g_hash_table_contains (cache->entries, key))
+    {
+        g_free (key);
+        return;
+    }
+    if (g_queue_get_length (&cache->order) >= cache->max_entries)
+    {
+        negative_cache_pop (cache);
+        cache->evictions++;
+    }
+
+    entry = g_new (NegativeEntry, 1);
+    entry->key = key;
+    entry->expires = g_get_monotonic_time () + cache->ttl_usec;
+    g_queue_push_tail (&cache->order, entry);
+    g_hash_table_add (cache->entries, entry->key);
+}
+
+gboolean negative_cache_has_name (NegativeCache *cache, const gchar *name)
+{
+    g_autofree gchar *key = g_strconcat ("n:", name, NULL);
+
+    return negative_cache_has (cache, key);
+}
+
+gboolean negative_cache_has_gid (NegativeCache *cache, gid_t gid)
+{
+    g_autofree gchar *key = g_strdup_printf ("g:%u", (guint) gid);
+
+    return negative_cache_has (cache, key);
+}
+
+void negative_cache_add_name (NegativeCache *cache, const gchar *name)
+{
+    negative_cache_add (cache, g_strconcat ("n:", name, NULL));
+}
+
+void negative_cache_add_gid (NegativeCache *cache, gid_t gid)
+{
+    negative_cache_add (cache, g_strdup_printf ("g:%u", (guint) gid));
+}
+
+/* (hits, misses, evictions, entries) */
+GVariant *negative_cache_get_counters (NegativeCache *cache)
+{
+    negative_cache_expire (cache);
+    return g_variant_new ("(tttu)",
+                          cache->hits,
+                          cache->misses,
+                          cache->evictions,
+                          g_queue_get_length (&cache->order));
+}
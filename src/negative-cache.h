@@ -0,0 +1,41 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __NEGATIVE_CACHE_H__
+#define __NEGATIVE_CACHE_H__
+
+#include <sys/types.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct NegativeCache NegativeCache;
+
+NegativeCache * negative_cache_new          (guint            max_entries,
+                                             gint64           ttl_usec);
+void            negative_cache_free         (NegativeCache   *cache);
+gboolean        negative_cache_has_name     (NegativeCache   *cache,
+                                             const gchar     *name);
+gboolean        negative_cache_has_gid      (NegativeCache   *cache,
+                                             gid_t            gid);
+void            negative_cache_add_name     (NegativeCache   *cache,
+                                             const gchar     *name);
+void            negative_cache_add_gid      (NegativeCache   *cache,
+                                             gid_t            gid);
+void            negative_cache_clear        (NegativeCache   *cache);
+GVariant *      negative_cache_get_counters (NegativeCache   *cache);
+
+G_END_DECLS
+
+#endif /* __NEGATIVE_CACHE_H__ */
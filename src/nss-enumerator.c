@@ -0,0 +1,236 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <errno.h>
+#include <string.h>
+#include <grp.h>
+#include <glib.h>
+
+#include "nss-enumerator.h"
+#include "probes.h"
+
+/*
+ * Walks every group NSS knows about (files, sss, ldap, ...) on a worker
+ * thread and hands the results to the main loop in pages. At most
+ * max_pages are in flight: the worker takes a credit before filling a
+ * page and the main loop returns it once the page is merged, so a slow
+ * merge throttles the directory walk instead of queueing it all up.
+ * Page delivery runs at G_PRIORITY_LOW so bus traffic is served first.
+ */
+
+#define NSS_BUFFER_SIZE 4096
+#define NSS_CREDIT      GINT_TO_POINTER (1)
+
+struct NssEnumerator
+{
+    gint          ref_count;
+    gint          cancelled;
+    guint         page_size;
+    guint         n_entries;
+    GAsyncQueue  *credits;
+    NssPageFunc   page_func;
+    NssDoneFunc   done_func;
+    gpointer      user_data;
+};
+
+typedef struct
+{
+    NssEnumerator *enumerator;
+    NssPage       *page;
+} NssDelivery;
+
+static NssEnumerator *nss_enumerator_ref (NssEnumerator *enumerator)
+{
+    g_atomic_int_inc (&enumerator->ref_count);
+    return enumerator;
+}
+
+static void nss_enumerator_unref (NssEnumerator *enumerator)
+{
+    if (!g_atomic_int_dec_and_test (&enumerator->ref_count))
+    {
+        return;
+    }
+    g_async_queue_unref (enumerator->credits);
+    g_free (enumerator);
+}
+
+static NssPage *nss_page_new (guint page_size)
+{
+    NssPage *page;
+
+    page = g_new0 (NssPage, 1);
+    page->arena = arena_new (16 * 1024);
+    page->entries = g_ptr_array_sized_new (page_size);
+
+    return page;
+}
+
+static void nss_page_free (NssPage *page)
+{
+    g_ptr_array_free (page->entries, TRUE);
+    arena_free (page->arena);
+    g_free (page);
+}
+
+static struct group *nss_page_copy (NssPage *page, const struct group *grent)
+{
+    struct group *copy;
+    guint n = 0;
+    guint i;
+
+    while (grent->gr_mem != NULL && grent->gr_mem[n] != NULL)
+    {
+        n++;
+    }
+    copy = arena_alloc (page->arena, sizeof (struct group));
+    copy->gr_name = arena_strdup (page->arena, grent->gr_name);
+    copy->gr_passwd = arena_strdup (page->arena, grent->gr_passwd);
+    copy->gr_gid = grent->gr_gid;
+    copy->gr_mem = arena_alloc (page->arena, (n + 1) * sizeof (gchar *));
+    for (i = 0; i < n; i++)
+    {
+        copy->gr_mem[i] = arena_strdup (page->arena, grent->gr_mem[i]);
+    }
+    copy->gr_mem[n] = NULL;
+
+    return copy;
+}
+
+static gboolean nss_deliver_page (gpointer data)
+{
+    NssDelivery   *delivery = data;
+    NssEnumerator *enumerator = delivery->enumerator;
+
+    if (!g_atomic_int_get (&enumerator->cancelled))
+    {
+        enumerator->page_func (delivery->page, enumerator->user_data);
+    }
+    nss_page_free (delivery->page);
+    g_async_queue_push (enumerator->credits, NSS_CREDIT);
+    nss_enumerator_unref (enumerator);
+    g_free (delivery);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean nss_deliver_done (gpointer data)
+{
+    NssEnumerator *enumerator = data;
+
+    if (!g_atomic_int_get (&enumerator->cancelled) && enumerator->done_func != NULL)
+    {
+        enumerator->done_func (enumerator->n_entries, enumerator->user_data);
+    }
+    nss_enumerator_unref (enumerator);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer nss_enumerator_thread (gpointer data)
+{
+    NssEnumerator *enumerator = data;
+    struct group   grent;
+    struct group  *result;
+    gsize          buflen = NSS_BUFFER_SIZE;
+    gchar         *buf;
+    gboolean       more = TRUE;
+
+    buf = g_malloc (buflen);
+    setgrent ();
+    while (more)
+    {
+        NssDelivery *delivery;
+        NssPage     *page;
+
+        g_async_queue_pop (enumerator->credits);
+        if (g_atomic_int_get (&enumerator->cancelled))
+        {
+            break;
+        }
+        page = nss_page_new (enumerator->page_size);
+        while (page->entries->len < enumerator->page_size)
+        {
+            int ret = getgrent_r (&grent, buf, buflen, &result);
+
+            if (ret == ERANGE)
+            {
+                /* The same entry is returned again with a larger buffer */
+                buflen *= 2;
+                buf = g_realloc (buf, buflen);
+                continue;
+            }
+            if (ret != 0 || result == NULL)
+            {
+                more = FALSE;
+                break;
+            }
+            g_ptr_array_add (page->entries, nss_page_copy (page, result));
+        }
+        enumerator->n_entries += page->entries->len;
+        GS_PROBE2 (nss__page, page->entries->len, enumerator->n_entries);
+
+        delivery = g_new0 (NssDelivery, 1);
+        delivery->enumerator = nss_enumerator_ref (enumerator);
+        delivery->page = page;
+        g_idle_add_full (G_PRIORITY_LOW, nss_deliver_page, delivery, NULL);
+    }
+    endgrent ();
+    g_free (buf);
+
+    g_idle_add_full (G_PRIORITY_LOW, nss_deliver_done, enumerator, NULL);
+    return NULL;
+}
+
+NssEnumerator *nss_enumerator_start (guint       page_size,
+                                     guint       max_pages,
+                                     NssPageFunc page_func,
+                                     NssDoneFunc done_func,
+                                     gpointer    user_data)
+{
+    NssEnumerator *enumerator;
+    GThread *thread;
+    guint i;
+
+    g_return_val_if_fail (page_size > 0 && max_pages > 0, NULL);
+
+    enumerator = g_new0 (NssEnumerator, 1);
+    enumerator->ref_count = 1;
+    enumerator->page_size = page_size;
+    enumerator->page_func = page_func;
+    enumerator->done_func = done_func;
+    enumerator->user_data = user_data;
+    enumerator->credits = g_async_queue_new ();
+    for (i = 0; i < max_pages; i++)
+    {
+        g_async_queue_push (enumerator->credits, NSS_CREDIT);
+    }
+
+    /* The thread's reference is handed to nss_deliver_done () */
+    thread = g_thread_new ("nss-enumerator", nss_enumerator_thread,
+                           nss_enumerator_ref (enumerator));
+    g_thread_unref (thread);
+
+    return enumerator;
+}
+
+/* Callbacks stop immediately. The worker may still be inside NSS and
+ * exits at its next page boundary; it is not joined. */
+void nss_enumerator_stop (NssEnumerator *enumerator)
+{
+    g_atomic_int_set (&enumerator->cancelled, TRUE);
+    g_async_queue_push (enumerator->credits, NSS_CREDIT);
+    nss_enumerator_unref (enumerator);
+}
@@ -0,0 +1,49 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __NSS_ENUMERATOR_H__
+#define __NSS_ENUMERATOR_H__
+
+#include <grp.h>
+#include <glib.h>
+#include "arena.h"
+
+G_BEGIN_DECLS
+
+/* One batch of getgrent_r () results; every string lives in arena */
+typedef struct
+{
+    Arena     *arena;
+    GPtrArray *entries;
+} NssPage;
+
+typedef struct NssEnumerator NssEnumerator;
+
+/* Both callbacks run on the main thread. page is freed when page_func
+ * returns, so anything kept must be copied out. */
+typedef void (*NssPageFunc) (NssPage  *page,
+                             gpointer  user_data);
+typedef void (*NssDoneFunc) (guint     n_entries,
+                             gpointer  user_data);
+
+NssEnumerator * nss_enumerator_start   (guint        page_size,
+                                        guint        max_pages,
+                                        NssPageFunc  page_func,
+                                        NssDoneFunc  done_func,
+                                        gpointer     user_data);
+void            nss_enumerator_stop    (NssEnumerator *enumerator);
+
+G_END_DECLS
+
+#endif /* __NSS_ENUMERATOR_H__ */
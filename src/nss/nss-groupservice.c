@@ -0,0 +1,319 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <nss.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "snapshot-reader.h"
+
+/*
+ * NSS "groupservice" source: answers getgrnam, getgrgid and initgroups
+ * from the table the daemon publishes at GS_SNAPSHOT_PATH. Whenever that
+ * table is missing, stale, older than the group or passwd file on disk or
+ * left behind by a daemon that is no longer running, every call returns
+ * NOTFOUND so the next source (normally files) answers instead:
+ *
+ *   group: groupservice files
+ */
+
+#define RECHECK_INTERVAL_SEC 1
+
+enum nss_status _nss_groupservice_getgrnam_r (const char *name, struct group *result,
+                                              char *buffer, size_t buflen, int *errnop);
+enum nss_status _nss_groupservice_getgrgid_r (gid_t gid, struct group *result,
+                                              char *buffer, size_t buflen, int *errnop);
+enum nss_status _nss_groupservice_initgroups_dyn (const char *user, gid_t group,
+                                                  long int *start, long int *size,
+                                                  gid_t **groupsp, long int limit,
+                                                  int *errnop);
+
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+static GsSnapshot      snapshot;
+static dev_t           snapshot_dev;
+static ino_t           snapshot_ino;
+static time_t          snapshot_checked;
+
+static const char *snapshot_path (void)
+{
+    const char *path = secure_getenv ("GROUP_SERVICE_SNAPSHOT");
+
+    return path != NULL ? path : GS_SNAPSHOT_PATH;
+}
+
+static void drop_snapshot (void)
+{
+    gs_snapshot_unmap (&snapshot);
+    snapshot_dev = 0;
+    snapshot_ino = 0;
+}
+
+/* Reopens the published path: maps it if it is a different file, or
+ * drops everything if no daemon holds it any more. */
+static void reopen_snapshot (void)
+{
+    struct stat st;
+    int fd;
+
+    fd = open (snapshot_path (), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        drop_snapshot ();
+        return;
+    }
+    if (flock (fd, LOCK_EX | LOCK_NB) == 0 || fstat (fd, &st) < 0)
+    {
+        drop_snapshot ();
+        close (fd);
+        return;
+    }
+    if (snapshot.base == NULL || st.st_dev != snapshot_dev || st.st_ino != snapshot_ino)
+    {
+        drop_snapshot ();
+        if (gs_snapshot_map (fd, &snapshot) == 0)
+        {
+            snapshot_dev = st.st_dev;
+            snapshot_ino = st.st_ino;
+        }
+    }
+    close (fd);
+}
+
+/* Called with snapshot_lock held. Between rechecks a lookup costs a
+ * clock read, a load of the header's live generation and a stat() of
+ * each source file: the daemon's lock only says it is running, not that
+ * it has caught up with an edit. */
+static int ensure_snapshot (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC_COARSE, &now);
+    if (snapshot.base == NULL ||
+        !gs_snapshot_is_current (&snapshot) ||
+        now.tv_sec - snapshot_checked >= RECHECK_INTERVAL_SEC)
+    {
+        reopen_snapshot ();
+        snapshot_checked = now.tv_sec;
+    }
+
+    return snapshot.base != NULL &&
+           gs_snapshot_is_current (&snapshot) &&
+           gs_snapshot_sources_current (&snapshot);
+}
+
+static char *append_string (char **cursor, char *end, const char *string)
+{
+    size_t len = strlen (string) + 1;
+    char *copy = *cursor;
+
+    if ((size_t) (end - copy) < len)
+    {
+        return NULL;
+    }
+    memcpy (copy, string, len);
+    *cursor += len;
+
+    return copy;
+}
+
+static enum nss_status fill_group (const GsSnapshotGroup *group,
+                                   struct group          *result,
+                                   char                  *buffer,
+                                   size_t                 buflen,
+                                   int                   *errnop)
+{
+    char *end = buffer + buflen;
+    char *cursor;
+    char **members;
+    uintptr_t align;
+    uint32_t i;
+
+    align = (sizeof (char *) - (uintptr_t) buffer % sizeof (char *)) % sizeof (char *);
+    if (buflen < align ||
+        (buflen - align) / sizeof (char *) < (size_t) group->n_members + 1)
+    {
+        goto erange;
+    }
+    members = (char **) (buffer + align);
+    cursor = (char *) (members + group->n_members + 1);
+
+    result->gr_gid = group->gid;
+    result->gr_name = append_string (&cursor, end, gs_snapshot_group_name (&snapshot, group));
+    result->gr_passwd = append_string (&cursor, end, "x");
+    if (result->gr_name == NULL || result->gr_passwd == NULL)
+    {
+        goto erange;
+    }
+    for (i = 0; i < group->n_members; i++)
+    {
+        const char *member = gs_snapshot_group_member (&snapshot, group, i);
+
+        members[i] = append_string (&cursor, end, member != NULL ? member : "");
+        if (members[i] == NULL)
+        {
+            goto erange;
+        }
+    }
+    members[group->n_members] = NULL;
+    result->gr_mem = members;
+
+    return NSS_STATUS_SUCCESS;
+
+erange:
+    *errnop = ERANGE;
+    return NSS_STATUS_TRYAGAIN;
+}
+
+enum nss_status _nss_groupservice_getgrnam_r (const char   *name,
+                                              struct group *result,
+                                              char         *buffer,
+                                              size_t        buflen,
+                                              int          *errnop)
+{
+    const GsSnapshotGroup *group;
+    enum nss_status status = NSS_STATUS_NOTFOUND;
+
+    pthread_mutex_lock (&snapshot_lock);
+    if (ensure_snapshot ())
+    {
+        group = gs_snapshot_find_name (&snapshot, name);
+        if (group != NULL)
+        {
+            status = fill_group (group, result, buffer, buflen, errnop);
+        }
+    }
+    pthread_mutex_unlock (&snapshot_lock);
+
+    return status;
+}
+
+enum nss_status _nss_groupservice_getgrgid_r (gid_t         gid,
+                                              struct group *result,
+                                              char         *buffer,
+                                              size_t        buflen,
+                                              int          *errnop)
+{
+    const GsSnapshotGroup *group;
+    enum nss_status status = NSS_STATUS_NOTFOUND;
+
+    pthread_mutex_lock (&snapshot_lock);
+    if (ensure_snapshot ())
+    {
+        group = gs_snapshot_find_gid (&snapshot, gid);
+        if (group != NULL)
+        {
+            status = fill_group (group, result, buffer, buflen, errnop);
+        }
+    }
+    pthread_mutex_unlock (&snapshot_lock);
+
+    return status;
+}
+
+static int add_gid (gid_t      gid,
+                    long int  *start,
+                    long int  *size,
+                    gid_t    **groupsp,
+                    long int   limit)
+{
+    gid_t *groups = *groupsp;
+    long int i;
+
+    for (i = 0; i < *start; i++)
+    {
+        if (groups[i] == gid)
+        {
+            return 0;
+        }
+    }
+    if (*start == *size)
+    {
+        long int new_size;
+
+        if (limit > 0 && *size >= limit)
+        {
+            return 0;
+        }
+        new_size = *size > 0 ? *size * 2 : 16;
+        if (limit > 0 && new_size > limit)
+        {
+            new_size = limit;
+        }
+        groups = realloc (groups, new_size * sizeof (gid_t));
+        if (groups == NULL)
+        {
+            return -ENOMEM;
+        }
+        *groupsp = groups;
+        *size = new_size;
+    }
+    groups[(*start)++] = gid;
+
+    return 0;
+}
+
+/* Supplementary groups of user from the reverse-membership index; group
+ * is the primary gid the caller already has. */
+enum nss_status _nss_groupservice_initgroups_dyn (const char *user,
+                                                  gid_t       group,
+                                                  long int   *start,
+                                                  long int   *size,
+                                                  gid_t     **groupsp,
+                                                  long int    limit,
+                                                  int        *errnop)
+{
+    const GsSnapshotUser *entry;
+    enum nss_status status = NSS_STATUS_NOTFOUND;
+    uint32_t i;
+
+    pthread_mutex_lock (&snapshot_lock);
+    if (!ensure_snapshot ())
+    {
+        goto out;
+    }
+    entry = gs_snapshot_find_user (&snapshot, user);
+    if (entry == NULL)
+    {
+        goto out;
+    }
+    status = NSS_STATUS_SUCCESS;
+    for (i = 0; i < entry->n_groups; i++)
+    {
+        const GsSnapshotGroup *member_of = gs_snapshot_user_group (&snapshot, entry, i);
+
+        if (member_of == NULL || member_of->gid == group)
+        {
+            continue;
+        }
+        if (add_gid (member_of->gid, start, size, groupsp, limit) < 0)
+        {
+            *errnop = ENOMEM;
+            status = NSS_STATUS_TRYAGAIN;
+            break;
+        }
+    }
+
+out:
+    pthread_mutex_unlock (&snapshot_lock);
+    return status;
+}
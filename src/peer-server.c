@@ -0,0 +1,203 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "peer-server.h"
+
+/*
+ * A private D-Bus server for clients that make many calls, such as batch
+ * importers. They get the same objects as on the system bus but talk to
+ * the daemon directly, saving the bus daemon's copy and context switch
+ * on every message. Only root, or the user the daemon runs as, may
+ * connect; the uid comes from SO_PEERCRED on the socket rather than from
+ * anything the client sends.
+ */
+
+struct PeerServer
+{
+    Manage            *manage;
+    gchar             *path;
+    GDBusServer       *server;
+    GDBusAuthObserver *observer;
+    GPtrArray         *connections;
+};
+
+static gboolean AllowMechanism (GDBusAuthObserver *observer,
+                                const gchar       *mechanism,
+                                gpointer           data)
+{
+    return g_strcmp0 (mechanism, "EXTERNAL") == 0;
+}
+
+static gboolean AuthorizePeer (GDBusAuthObserver *observer,
+                               GIOStream         *stream,
+                               GCredentials      *credentials,
+                               gpointer           data)
+{
+    g_autoptr(GCredentials) peer = NULL;
+    g_autoptr(GError) error = NULL;
+    uid_t uid;
+
+    if (!G_IS_SOCKET_CONNECTION (stream))
+    {
+        return FALSE;
+    }
+    peer = g_socket_get_credentials (g_socket_connection_get_socket (G_SOCKET_CONNECTION (stream)),
+                                     &error);
+    if (peer == NULL)
+    {
+        g_warning ("Unable to read peer credentials: %s", error->message);
+        return FALSE;
+    }
+    uid = g_credentials_get_unix_user (peer, NULL);
+    if (uid != 0 && uid != geteuid ())
+    {
+        g_debug ("Refusing peer connection from uid %u", (guint) uid);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void ConnectionClosed (GDBusConnection *connection,
+                              gboolean         remote_peer_vanished,
+                              GError          *error,
+                              gpointer         data)
+{
+    PeerServer *server = data;
+
+    ManageUnexportPeer (server->manage, connection);
+    g_signal_handlers_disconnect_by_func (connection, ConnectionClosed, server);
+    g_ptr_array_remove (server->connections, connection);
+}
+
+static gboolean NewConnection (GDBusServer     *dbus_server,
+                               GDBusConnection *connection,
+                               gpointer         data)
+{
+    PeerServer *server = data;
+
+    g_ptr_array_add (server->connections, g_object_ref (connection));
+    g_signal_connect (connection, "closed", G_CALLBACK (ConnectionClosed), server);
+    ManageExportPeer (server->manage, connection);
+
+    return TRUE;
+}
+
+PeerServer *peer_server_new (Manage *manage, const gchar *path, GError **error)
+{
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *address = NULL;
+    g_autofree gchar *escaped = NULL;
+    g_autofree gchar *guid = NULL;
+    PeerServer *server;
+    struct stat st;
+
+    dir = g_path_get_dirname (path);
+    if (g_mkdir_with_parents (dir, 0755) < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Unable to create %s: %s", dir, g_strerror (errno));
+        return NULL;
+    }
+    if (g_lstat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+    {
+        g_unlink (path);
+    }
+
+    server = g_new0 (PeerServer, 1);
+    server->manage = manage;
+    server->path = g_strdup (path);
+    server->connections = g_ptr_array_new_with_free_func (g_object_unref);
+    server->observer = g_dbus_auth_observer_new ();
+    g_signal_connect (server->observer, "allow-mechanism", G_CALLBACK (AllowMechanism), NULL);
+    g_signal_connect (server->observer, "authorize-authenticated-peer", G_CALLBACK (AuthorizePeer), NULL);
+
+    escaped = g_dbus_address_escape_value (path);
+    address = g_strdup_printf ("unix:path=%s", escaped);
+    guid = g_dbus_generate_guid ();
+    server->server = g_dbus_server_new_sync (address,
+                                             G_DBUS_SERVER_FLAGS_NONE,
+                                             guid,
+                                             server->observer,
+                                             NULL,
+                                             error);
+    if (server->server == NULL)
+    {
+        peer_server_free (server);
+        return NULL;
+    }
+    /* The uid check is what matters; the mode just keeps others from
+     * getting as far as authentication */
+    g_chmod (path, 0600);
+    g_signal_connect (server->server, "new-connection", G_CALLBACK (NewConnection), server);
+    g_dbus_server_start (server->server);
+
+    return server;
+}
+
+void peer_server_free (PeerServer *server)
+{
+    guint i;
+
+    if (server->server != NULL)
+    {
+        g_dbus_server_stop (server->server);
+        g_object_unref (server->server);
+        g_unlink (server->path);
+    }
+    for (i = 0; i < server->connections->len; i++)
+    {
+        GDBusConnection *connection = g_ptr_array_index (server->connections, i);
+
+        g_signal_handlers_disconnect_by_func (connection, ConnectionClosed, server);
+        ManageUnexportPeer (server->manage, connection);
+        g_dbus_connection_close (connection, NULL, NULL, NULL);
+    }
+    g_ptr_array_unref (server->connections);
+    g_object_unref (server->observer);
+    g_free (server->path);
+    g_free (server);
+}
+
+/* Called for objects that appear after peers have connected */
+void peer_server_export (PeerServer             *server,
+                         GDBusInterfaceSkeleton *skeleton,
+                         const gchar            *object_path)
+{
+    guint i;
+
+    for (i = 0; i < server->connections->len; i++)
+    {
+        GDBusConnection *connection = g_ptr_array_index (server->connections, i);
+        g_autoptr(GError) error = NULL;
+
+        if (!g_dbus_interface_skeleton_export (skeleton, connection, object_path, &error))
+        {
+            g_warning ("Unable to export %s to a peer: %s", object_path, error->message);
+        }
+    }
+}
+
+guint peer_server_get_n_peers (PeerServer *server)
+{
+    return server->connections->len;
+}
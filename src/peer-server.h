@@ -0,0 +1,36 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __PEER_SERVER_H__
+#define __PEER_SERVER_H__
+
+#include <gio/gio.h>
+#include "group-server.h"
+
+G_BEGIN_DECLS
+
+typedef struct PeerServer PeerServer;
+
+PeerServer * peer_server_new         (Manage                 *manage,
+                                      const gchar            *path,
+                                      GError                **error);
+void         peer_server_free        (PeerServer             *server);
+void         peer_server_export      (PeerServer             *server,
+                                      GDBusInterfaceSkeleton *skeleton,
+                                      const gchar            *object_path);
+guint        peer_server_get_n_peers (PeerServer             *server);
+
+G_END_DECLS
+
+#endif /* __PEER_SERVER_H__ */
@@ -0,0 +1,42 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+/*
+ * Static tracepoints under the "group_service" provider. Built with
+ * -Dusdt=true they become sys/sdt.h probes that cost a nop until a tracer
+ * attaches; otherwise they compile away and the arguments are never
+ * evaluated, only type checked. See tools/bpftrace for scripts that
+ * consume them.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define GS_PROBE(name)                DTRACE_PROBE (group_service, name)
+#define GS_PROBE1(name, a)            DTRACE_PROBE1 (group_service, name, a)
+#define GS_PROBE2(name, a, b)         DTRACE_PROBE2 (group_service, name, a, b)
+#define GS_PROBE3(name, a, b, c)      DTRACE_PROBE3 (group_service, name, a, b, c)
+#else
+#define GS_PROBE(name)                do { } while (0)
+#define GS_PROBE1(name, a)            do { if (0) { (void) (a); } } while (0)
+#define GS_PROBE2(name, a, b)         do { if (0) { (void) (a); (void) (b); } } while (0)
+#define GS_PROBE3(name, a, b, c)      do { if (0) { (void) (a); (void) (b); (void) (c); } } while (0)
+#endif
+
+#endif /* __PROBES_H__ */
@@ -0,0 +1,315 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "scheduler.h"
+
+/*
+ * Sits in front of every call that needs polkit and a helper run. Each
+ * caller gets its own queue and the queues take turns, so one script
+ * flooding AddUserToGroup only delays itself. A call made with
+ * interactive authorization allowed, such as one from a settings panel,
+ * goes ahead of bulk callers' turns. At most max_running calls are
+ * between dispatch and reply, and with a rate each caller may start
+ * that many calls per second, bursting up to the same number.
+ *
+ * Lookups never pass through here.
+ */
+
+#define SCHEDULER_MAX_QUEUED 64
+
+typedef struct
+{
+    GDBusMethodInvocation *invocation;
+    SchedulerJobFunc       run;
+    gpointer               data;
+    GDestroyNotify         destroy;
+    gboolean               interactive;
+} Job;
+
+typedef struct
+{
+    gchar  *key;
+    GQueue  jobs;
+    gdouble tokens;
+    gint64  refilled;
+} Caller;
+
+struct Scheduler
+{
+    guint       max_running;
+    guint       rate;
+    GHashTable *callers;    /* key -> Caller */
+    GQueue      turns;      /* callers with queued jobs, next one first */
+    GPtrArray  *running;    /* invocations dispatched but not answered */
+    guint       queued;
+    guint64     dispatched;
+    guint64     rejected;
+    guint       dispatch_id;
+};
+
+static void JobFree (Job *job)
+{
+    if (job->destroy != NULL)
+        job->destroy (job->data);
+    g_free (job);
+}
+
+static void CallerFree (Caller *caller)
+{
+    g_queue_clear_full (&caller->jobs, (GDestroyNotify) JobFree);
+    g_free (caller->key);
+    g_free (caller);
+}
+
+Scheduler *scheduler_new (guint max_running, guint rate)
+{
+    Scheduler *scheduler;
+
+    scheduler = g_new0 (Scheduler, 1);
+    scheduler->max_running = MAX (max_running, 1);
+    scheduler->rate = rate;
+    scheduler->callers = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                NULL, (GDestroyNotify) CallerFree);
+    g_queue_init (&scheduler->turns);
+    scheduler->running = g_ptr_array_new ();
+
+    return scheduler;
+}
+
+static void JobDone (gpointer data, GObject *invocation);
+
+void scheduler_free (Scheduler *scheduler)
+{
+    guint i;
+
+    if (scheduler->dispatch_id > 0)
+        g_source_remove (scheduler->dispatch_id);
+    for (i = 0; i < scheduler->running->len; i++)
+        g_object_weak_unref (g_ptr_array_index (scheduler->running, i), JobDone, scheduler);
+    g_ptr_array_free (scheduler->running, TRUE);
+    g_queue_clear (&scheduler->turns);
+    g_hash_table_destroy (scheduler->callers);
+    g_free (scheduler);
+}
+
+static void Refill (Scheduler *scheduler, Caller *caller, gint64 now)
+{
+    caller->tokens = MIN ((gdouble) scheduler->rate,
+                          caller->tokens + (now - caller->refilled) * scheduler->rate / (gdouble) G_USEC_PER_SEC);
+    caller->refilled = now;
+}
+
+static gboolean DispatchLater (gpointer data);
+
+static void QueueDispatch (Scheduler *scheduler, guint delay_ms)
+{
+    if (scheduler->dispatch_id > 0)
+        return;
+    if (delay_ms == 0)
+        scheduler->dispatch_id = g_idle_add (DispatchLater, scheduler);
+    else
+        scheduler->dispatch_id = g_timeout_add (delay_ms, DispatchLater, scheduler);
+}
+
+/* Picks the caller whose turn it is among those with a token left,
+ * preferring one whose next call is interactive */
+static Caller *NextCaller (Scheduler *scheduler, gint64 now, gint64 *wait)
+{
+    Caller *first = NULL;
+    GList *l;
+
+    *wait = G_MAXINT64;
+    for (l = scheduler->turns.head; l != NULL; l = l->next)
+    {
+        Caller *caller = l->data;
+        Job *job = g_queue_peek_head (&caller->jobs);
+
+        if (scheduler->rate > 0)
+        {
+            Refill (scheduler, caller, now);
+            if (caller->tokens < 1)
+            {
+                *wait = MIN (*wait, (1 - caller->tokens) * G_USEC_PER_SEC / scheduler->rate);
+                continue;
+            }
+        }
+        if (job->interactive)
+            return caller;
+        if (first == NULL)
+            first = caller;
+    }
+
+    return first;
+}
+
+static void Dispatch (Scheduler *scheduler)
+{
+    gint64 now = g_get_monotonic_time ();
+    gint64 wait;
+
+    while (scheduler->running->len < scheduler->max_running)
+    {
+        Caller *caller;
+        Job *job;
+
+        caller = NextCaller (scheduler, now, &wait);
+        if (caller == NULL)
+        {
+            if (wait != G_MAXINT64)
+                QueueDispatch (scheduler, wait / 1000 + 1);
+            return;
+        }
+
+        job = g_queue_pop_head (&caller->jobs);
+        scheduler->queued--;
+        g_queue_remove (&scheduler->turns, caller);
+        if (!g_queue_is_empty (&caller->jobs))
+            g_queue_push_tail (&scheduler->turns, caller);
+        if (scheduler->rate > 0)
+            caller->tokens -= 1;
+        else if (g_queue_is_empty (&caller->jobs))
+            g_hash_table_remove (scheduler->callers, caller->key);
+
+        scheduler->dispatched++;
+        g_ptr_array_add (scheduler->running, job->invocation);
+        g_object_weak_ref (G_OBJECT (job->invocation), JobDone, scheduler);
+        /* The job owns data from here on */
+        job->run (job->data);
+        g_free (job);
+    }
+}
+
+static gboolean DispatchLater (gpointer data)
+{
+    Scheduler *scheduler = data;
+
+    scheduler->dispatch_id = 0;
+    Dispatch (scheduler);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* The reply has gone out, which frees the invocation. Jobs may answer
+ * from inside run, so the next one starts from the main loop. */
+static void JobDone (gpointer data, GObject *invocation)
+{
+    Scheduler *scheduler = data;
+
+    g_ptr_array_remove_fast (scheduler->running, invocation);
+    if (!g_queue_is_empty (&scheduler->turns))
+        QueueDispatch (scheduler, 0);
+}
+
+/* Forgets callers that have nothing queued and a full bucket again */
+static void ForgetIdleCallers (Scheduler *scheduler, gint64 now)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, scheduler->callers);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        Caller *caller = value;
+
+        if (!g_queue_is_empty (&caller->jobs))
+            continue;
+        Refill (scheduler, caller, now);
+        if (caller->tokens >= scheduler->rate)
+            g_hash_table_iter_remove (&iter);
+    }
+}
+
+gboolean scheduler_submit (Scheduler             *scheduler,
+                           GDBusMethodInvocation *invocation,
+                           SchedulerJobFunc       run,
+                           gpointer               data,
+                           GDestroyNotify         destroy,
+                           GError               **error)
+{
+    const gchar *sender = g_dbus_method_invocation_get_sender (invocation);
+    g_autofree gchar *key = NULL;
+    gint64 now = g_get_monotonic_time ();
+    Caller *caller;
+    Job *job;
+
+    /* Peer connections have no bus name, each one is a caller of its own */
+    if (sender != NULL)
+        key = g_strdup (sender);
+    else
+        key = g_strdup_printf ("peer:%p", g_dbus_method_invocation_get_connection (invocation));
+
+    caller = g_hash_table_lookup (scheduler->callers, key);
+    if (caller == NULL)
+    {
+        if (scheduler->rate > 0 && g_hash_table_size (scheduler->callers) >= 256)
+            ForgetIdleCallers (scheduler, now);
+        caller = g_new0 (Caller, 1);
+        caller->key = g_steal_pointer (&key);
+        g_queue_init (&caller->jobs);
+        caller->tokens = scheduler->rate;
+        caller->refilled = now;
+        g_hash_table_insert (scheduler->callers, caller->key, caller);
+    }
+    if (caller->jobs.length >= SCHEDULER_MAX_QUEUED)
+    {
+        scheduler->rejected++;
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                     "Too many queued requests from %s", caller->key);
+        return FALSE;
+    }
+
+    job = g_new0 (Job, 1);
+    job->invocation = invocation;
+    job->run = run;
+    job->data = data;
+    job->destroy = destroy;
+    job->interactive = (g_dbus_message_get_flags (g_dbus_method_invocation_get_message (invocation)) &
+                        G_DBUS_MESSAGE_FLAGS_ALLOW_INTERACTIVE_AUTHORIZATION) != 0;
+    g_queue_push_tail (&caller->jobs, job);
+    if (caller->jobs.length == 1)
+        g_queue_push_tail (&scheduler->turns, caller);
+    scheduler->queued++;
+
+    Dispatch (scheduler);
+    return TRUE;
+}
+
+GVariant *scheduler_get_counters (Scheduler *scheduler)
+{
+    return g_variant_new ("(uutt)",
+                          scheduler->running->len,
+                          scheduler->queued,
+                          scheduler->dispatched,
+                          scheduler->rejected);
+}
+
+GVariant *scheduler_get_queues (Scheduler *scheduler)
+{
+    GVariantBuilder builder;
+    GList *l;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{su}"));
+    for (l = scheduler->turns.head; l != NULL; l = l->next)
+    {
+        Caller *caller = l->data;
+
+        g_variant_builder_add (&builder, "{su}", caller->key, caller->jobs.length);
+    }
+
+    return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,41 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct Scheduler Scheduler;
+
+typedef void (*SchedulerJobFunc) (gpointer data);
+
+Scheduler * scheduler_new          (guint                  max_running,
+                                    guint                  rate);
+void        scheduler_free         (Scheduler             *scheduler);
+gboolean    scheduler_submit       (Scheduler             *scheduler,
+                                    GDBusMethodInvocation *invocation,
+                                    SchedulerJobFunc       run,
+                                    gpointer               data,
+                                    GDestroyNotify         destroy,
+                                    GError               **error);
+GVariant *  scheduler_get_counters (Scheduler             *scheduler);
+GVariant *  scheduler_get_queues   (Scheduler             *scheduler);
+
+G_END_DECLS
+
+#endif /* __SCHEDULER_H__ */
@@ -0,0 +1,521 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#define _GNU_SOURCE
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "snapshot-file.h"
+#include "snapshot-format.h"
+
+/*
+ * Write side of snapshot-format.h: serializes the group records into a
+ * memfd and seals it, so the same fd can be handed to every client. The
+ * daemon keeps a writable mapping of the header only, which it uses once
+ * to store the newer generation when the table goes out of date. The
+ * same bytes can also be published under a path, for the NSS module.
+ */
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+struct SnapshotFile
+{
+    gint              fd;
+    guint64           generation;
+    gsize             size;
+    GsSnapshotHeader *header;
+    gint              published_fd;
+    gchar            *published_path;
+    GsSnapshotHeader *published_header;
+};
+
+static gint CompareRecords (gconstpointer a, gconstpointer b, gpointer data)
+{
+    const GroupRecord *ra = *(const GroupRecord **) a;
+    const GroupRecord *rb = *(const GroupRecord **) b;
+    NamePool *names = data;
+
+    if (ra->gid != rb->gid)
+    {
+        return ra->gid < rb->gid ? -1 : 1;
+    }
+    return g_strcmp0 (name_pool_lookup (names, ra->name_id),
+                      name_pool_lookup (names, rb->name_id));
+}
+
+/* Each distinct name is stored once, shared between groups and members */
+static guint32 InternString (GHashTable  *offsets,
+                             GByteArray  *strings,
+                             NamePool    *names,
+                             NameId       id)
+{
+    const gchar *name;
+    gpointer offset;
+
+    if (g_hash_table_lookup_extended (offsets, GUINT_TO_POINTER (id), NULL, &offset))
+    {
+        return GPOINTER_TO_UINT (offset);
+    }
+    name = name_pool_lookup (names, id);
+    offset = GUINT_TO_POINTER (strings->len);
+    g_byte_array_append (strings, (const guint8 *) name, strlen (name) + 1);
+    g_hash_table_insert (offsets, GUINT_TO_POINTER (id), offset);
+
+    return GPOINTER_TO_UINT (offset);
+}
+
+static guint32 IndexSize (guint n_entries)
+{
+    guint32 n_buckets = 8;
+
+    /* At most half full, so probes stay short */
+    while (n_buckets < n_entries * 2)
+    {
+        n_buckets *= 2;
+    }
+    return n_buckets;
+}
+
+static void FillIndex (guint32 *index, guint32 n_buckets, const guint32 *hashes, guint n_entries)
+{
+    guint i;
+
+    for (i = 0; i < n_entries; i++)
+    {
+        guint32 slot = hashes[i] & (n_buckets - 1);
+
+        while (index[slot] != 0)
+        {
+            slot = (slot + 1) & (n_buckets - 1);
+        }
+        index[slot] = i + 1;
+    }
+}
+
+static guint8 *BuildTable (GPtrArray          *records,
+                           NamePool           *names,
+                           guint64             generation,
+                           const gchar *const *sources,
+                           GVariant           *stamps,
+                           gsize              *size)
+{
+    GsSnapshotSource source_entries[GS_SNAPSHOT_N_SOURCES];
+    g_autoptr(GPtrArray) sorted = NULL;
+    g_autoptr(GHashTable) offsets = NULL;
+    g_autoptr(GHashTable) user_ids = NULL;
+    g_autoptr(GByteArray) strings = NULL;
+    g_autoptr(GArray) members = NULL;
+    g_autoptr(GArray) user_names = NULL;
+    g_autoptr(GPtrArray) user_groups = NULL;
+    GsSnapshotHeader *header;
+    GsSnapshotGroup *groups;
+    GsSnapshotUser *users;
+    guint32 *hashes;
+    guint32 *groups_of_users;
+    guint8 *data;
+    guint32 n_buckets, n_user_buckets, n_user_groups = 0;
+    guint i, j;
+
+    sorted = g_ptr_array_sized_new (records->len);
+    for (i = 0; i < records->len; i++)
+    {
+        g_ptr_array_add (sorted, g_ptr_array_index (records, i));
+    }
+    g_ptr_array_sort_with_data (sorted, CompareRecords, names);
+    n_buckets = IndexSize (sorted->len);
+
+    offsets = g_hash_table_new (g_direct_hash, g_direct_equal);
+    user_ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+    strings = g_byte_array_new ();
+    members = g_array_new (FALSE, FALSE, sizeof (guint32));
+    user_names = g_array_new (FALSE, FALSE, sizeof (NameId));
+    user_groups = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+    groups = g_new0 (GsSnapshotGroup, sorted->len);
+    for (i = 0; i < sorted->len; i++)
+    {
+        const GroupRecord *record = g_ptr_array_index (sorted, i);
+        /* A primary user standing in is not a member as far as
+         * getgrnam(3) and initgroups(3) are concerned */
+        guint n_members = record->primary_member ? 0 : record->n_members;
+
+        groups[i].name = InternString (offsets, strings, names, record->name_id);
+        groups[i].gid = record->gid;
+        groups[i].hash = gs_snapshot_hash (name_pool_lookup (names, record->name_id));
+        groups[i].flags = record->primary ? GS_SNAPSHOT_GROUP_PRIMARY : 0;
+        groups[i].members = members->len;
+        groups[i].n_members = n_members;
+        for (j = 0; j < n_members; j++)
+        {
+            guint32 offset = InternString (offsets, strings, names, record->members[j]);
+            gpointer user;
+            GArray *list;
+
+            g_array_append_val (members, offset);
+
+            /* Reverse membership, in gid order since groups are */
+            if (!g_hash_table_lookup_extended (user_ids, GUINT_TO_POINTER (record->members[j]),
+                                               NULL, &user))
+            {
+                user = GUINT_TO_POINTER (user_names->len);
+                g_hash_table_insert (user_ids, GUINT_TO_POINTER (record->members[j]), user);
+                g_array_append_val (user_names, record->members[j]);
+                g_ptr_array_add (user_groups, g_array_new (FALSE, FALSE, sizeof (guint32)));
+            }
+            list = g_ptr_array_index (user_groups, GPOINTER_TO_UINT (user));
+            if (list->len == 0 || g_array_index (list, guint32, list->len - 1) != i)
+            {
+                g_array_append_val (list, i);
+                n_user_groups++;
+            }
+        }
+    }
+    memset (source_entries, 0, sizeof (source_entries));
+    for (i = 0; i < GS_SNAPSHOT_N_SOURCES; i++)
+    {
+        /* A missing path is stored as "", which no reader can stat */
+        const gchar *path = sources != NULL && sources[i] != NULL ? sources[i] : "";
+
+        source_entries[i].path = strings->len;
+        g_byte_array_append (strings, (const guint8 *) path, strlen (path) + 1);
+        if (stamps != NULL && i < g_variant_n_children (stamps))
+        {
+            g_variant_get_child (stamps, i, "(ttt)",
+                                 &source_entries[i].mtime_usec,
+                                 &source_entries[i].size,
+                                 &source_entries[i].ino);
+        }
+    }
+    n_user_buckets = IndexSize (user_names->len);
+
+    *size = sizeof (GsSnapshotHeader) +
+            sorted->len * sizeof (GsSnapshotGroup) +
+            n_buckets * sizeof (guint32) +
+            members->len * sizeof (guint32) +
+            user_names->len * sizeof (GsSnapshotUser) +
+            n_user_buckets * sizeof (guint32) +
+            n_user_groups * sizeof (guint32) +
+            strings->len;
+    data = g_malloc0 (*size);
+    header = (GsSnapshotHeader *) data;
+    header->magic = GS_SNAPSHOT_MAGIC;
+    header->version = GS_SNAPSHOT_VERSION;
+    header->generation = generation;
+    header->live_generation = generation;
+    header->size = *size;
+    header->n_groups = sorted->len;
+    header->groups_offset = sizeof (GsSnapshotHeader);
+    header->n_buckets = n_buckets;
+    header->name_index_offset = header->groups_offset + sorted->len * sizeof (GsSnapshotGroup);
+    header->n_members = members->len;
+    header->members_offset = header->name_index_offset + n_buckets * sizeof (guint32);
+    header->n_users = user_names->len;
+    header->users_offset = header->members_offset + members->len * sizeof (guint32);
+    header->n_user_buckets = n_user_buckets;
+    header->user_index_offset = header->users_offset + user_names->len * sizeof (GsSnapshotUser);
+    header->n_user_groups = n_user_groups;
+    header->user_groups_offset = header->user_index_offset + n_user_buckets * sizeof (guint32);
+    header->strings_size = strings->len;
+    header->strings_offset = header->user_groups_offset + n_user_groups * sizeof (guint32);
+    memcpy (header->sources, source_entries, sizeof (source_entries));
+
+    memcpy (data + header->groups_offset, groups, sorted->len * sizeof (GsSnapshotGroup));
+    hashes = g_new (guint32, MAX (sorted->len, user_names->len) + 1);
+    for (i = 0; i < sorted->len; i++)
+    {
+        hashes[i] = groups[i].hash;
+    }
+    FillIndex ((guint32 *) (data + header->name_index_offset), n_buckets, hashes, sorted->len);
+    memcpy (data + header->members_offset, members->data, members->len * sizeof (guint32));
+
+    users = (GsSnapshotUser *) (data + header->users_offset);
+    groups_of_users = (guint32 *) (data + header->user_groups_offset);
+    n_user_groups = 0;
+    for (i = 0; i < user_names->len; i++)
+    {
+        NameId id = g_array_index (user_names, NameId, i);
+        GArray *list = g_ptr_array_index (user_groups, i);
+
+        users[i].name = InternString (offsets, strings, names, id);
+        users[i].hash = gs_snapshot_hash (name_pool_lookup (names, id));
+        users[i].groups = n_user_groups;
+        users[i].n_groups = list->len;
+        memcpy (groups_of_users + n_user_groups, list->data, list->len * sizeof (guint32));
+        n_user_groups += list->len;
+        hashes[i] = users[i].hash;
+    }
+    FillIndex ((guint32 *) (data + header->user_index_offset), n_user_buckets, hashes, user_names->len);
+    memcpy (data + header->strings_offset, strings->data, strings->len);
+    g_free (hashes);
+    g_free (groups);
+
+    return data;
+}
+
+static gboolean WriteAll (gint fd, const guint8 *data, gsize size, GError **error)
+{
+    while (size > 0)
+    {
+        gssize written = write (fd, data, size);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                         "Unable to write snapshot: %s", g_strerror (errno));
+            return FALSE;
+        }
+        data += written;
+        size -= written;
+    }
+
+    return TRUE;
+}
+
+/* Keeps a writable header mapping and forbids any other writer. Kernels
+ * without F_SEAL_FUTURE_WRITE get a fully sealed, static snapshot. */
+static gboolean SealFile (SnapshotFile *file, GError **error)
+{
+    gint saved_errno;
+
+    file->header = mmap (NULL, sizeof (GsSnapshotHeader), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, file->fd, 0);
+    if (file->header == MAP_FAILED)
+    {
+        saved_errno = errno;
+        file->header = NULL;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "Unable to map snapshot: %s", g_strerror (saved_errno));
+        return FALSE;
+    }
+    if (fcntl (file->fd, F_ADD_SEALS,
+               F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) == 0)
+    {
+        return TRUE;
+    }
+
+    file->header->flags |= GS_SNAPSHOT_FLAG_STATIC;
+    munmap (file->header, sizeof (GsSnapshotHeader));
+    file->header = NULL;
+    if (fcntl (file->fd, F_ADD_SEALS,
+               F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+    {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "Unable to seal snapshot: %s", g_strerror (saved_errno));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* sources are the group and passwd paths, stamps the group_cache_stamp()
+ * of them taken before the records were parsed */
+SnapshotFile *snapshot_file_new (GPtrArray          *records,
+                                 NamePool           *names,
+                                 guint64             generation,
+                                 const gchar *const *sources,
+                                 GVariant           *stamps,
+                                 GError            **error)
+{
+    SnapshotFile *file;
+    g_autofree guint8 *data = NULL;
+    gsize size;
+
+    data = BuildTable (records, names, generation, sources, stamps, &size);
+    if (size > G_MAXUINT32)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FBIG,
+                     "Snapshot of %" G_GSIZE_FORMAT " bytes is too large", size);
+        return NULL;
+    }
+
+    file = g_new0 (SnapshotFile, 1);
+    file->published_fd = -1;
+    file->generation = generation;
+    file->size = size;
+    file->fd = memfd_create ("group-service-snapshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (file->fd < 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to create snapshot: %s", g_strerror (errno));
+        snapshot_file_free (file);
+        return NULL;
+    }
+    if (!WriteAll (file->fd, data, size, error) || !SealFile (file, error))
+    {
+        snapshot_file_free (file);
+        return NULL;
+    }
+
+    return file;
+}
+
+void snapshot_file_free (SnapshotFile *file)
+{
+    if (file->published_header != NULL)
+    {
+        munmap (file->published_header, sizeof (GsSnapshotHeader));
+    }
+    if (file->published_fd >= 0)
+    {
+        close (file->published_fd);
+    }
+    g_free (file->published_path);
+    if (file->header != NULL)
+    {
+        munmap (file->header, sizeof (GsSnapshotHeader));
+    }
+    if (file->fd >= 0)
+    {
+        close (file->fd);
+    }
+    g_free (file);
+}
+
+gint snapshot_file_get_fd (SnapshotFile *file)
+{
+    return file->fd;
+}
+
+guint64 snapshot_file_get_generation (SnapshotFile *file)
+{
+    return file->generation;
+}
+
+gsize snapshot_file_get_size (SnapshotFile *file)
+{
+    return file->size;
+}
+
+/* Tells every client still mapping this table that it is out of date */
+void snapshot_file_retire (SnapshotFile *file, guint64 generation)
+{
+    if (file->header != NULL)
+    {
+        __atomic_store_n (&file->header->live_generation, generation, __ATOMIC_RELEASE);
+    }
+    if (file->published_header != NULL)
+    {
+        __atomic_store_n (&file->published_header->live_generation, generation, __ATOMIC_RELEASE);
+    }
+}
+
+/* Copies the table to path through a rename, so readers opening path
+ * see either the old file or the complete new one. The daemon keeps the
+ * file open with a shared lock as proof that it is alive. */
+gboolean snapshot_file_publish (SnapshotFile *file, const gchar *path, GError **error)
+{
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *tmp = NULL;
+    gpointer data;
+    gint fd, saved_errno;
+
+    dir = g_path_get_dirname (path);
+    if (g_mkdir_with_parents (dir, 0755) < 0)
+    {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "Unable to create %s: %s", dir, g_strerror (saved_errno));
+        return FALSE;
+    }
+    tmp = g_strconcat (path, ".XXXXXX", NULL);
+    fd = g_mkstemp_full (tmp, O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "Unable to create %s: %s", tmp, g_strerror (saved_errno));
+        return FALSE;
+    }
+
+    data = mmap (NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "Unable to map snapshot: %s", g_strerror (saved_errno));
+        goto fail;
+    }
+    if (!WriteAll (fd, data, file->size, error))
+    {
+        munmap (data, file->size);
+        goto fail;
+    }
+    munmap (data, file->size);
+
+    file->published_header = mmap (NULL, sizeof (GsSnapshotHeader), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED, fd, 0);
+    if (file->published_header == MAP_FAILED ||
+        flock (fd, LOCK_SH) < 0 ||
+        g_rename (tmp, path) < 0)
+    {
+        saved_errno = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "Unable to publish %s: %s", path, g_strerror (saved_errno));
+        if (file->published_header != MAP_FAILED)
+        {
+            munmap (file->published_header, sizeof (GsSnapshotHeader));
+        }
+        file->published_header = NULL;
+        goto fail;
+    }
+    /* The memfd copy may be flagged static, this one has a live header */
+    file->published_header->flags &= ~GS_SNAPSHOT_FLAG_STATIC;
+    file->published_fd = fd;
+    file->published_path = g_strdup (path);
+
+    return TRUE;
+
+fail:
+    close (fd);
+    g_unlink (tmp);
+    return FALSE;
+}
+
+gboolean snapshot_file_is_published (SnapshotFile *file)
+{
+    return file->published_fd >= 0;
+}
+
+/* On shutdown: marks the published copy stale and removes it, unless
+ * path has since been taken over by another file */
+void snapshot_file_withdraw (SnapshotFile *file)
+{
+    GStatBuf path_st;
+    struct stat fd_st;
+
+    if (file->published_fd < 0)
+    {
+        return;
+    }
+    snapshot_file_retire (file, file->generation + 1);
+    if (g_stat (file->published_path, &path_st) == 0 &&
+        fstat (file->published_fd, &fd_st) == 0 &&
+        path_st.st_dev == fd_st.st_dev &&
+        path_st.st_ino == fd_st.st_ino)
+    {
+        g_unlink (file->published_path);
+    }
+}
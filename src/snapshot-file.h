@@ -0,0 +1,45 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __SNAPSHOT_FILE_H__
+#define __SNAPSHOT_FILE_H__
+
+#include <glib.h>
+#include "group-snapshot.h"
+
+G_BEGIN_DECLS
+
+typedef struct SnapshotFile SnapshotFile;
+
+SnapshotFile * snapshot_file_new            (GPtrArray     *records,
+                                             NamePool      *names,
+                                             guint64        generation,
+                                             const gchar *const *sources,
+                                             GVariant      *stamps,
+                                             GError       **error);
+void           snapshot_file_free           (SnapshotFile  *file);
+gint           snapshot_file_get_fd         (SnapshotFile  *file);
+guint64        snapshot_file_get_generation (SnapshotFile  *file);
+gsize          snapshot_file_get_size       (SnapshotFile  *file);
+void           snapshot_file_retire         (SnapshotFile  *file,
+                                             guint64        generation);
+gboolean       snapshot_file_publish        (SnapshotFile  *file,
+                                             const gchar   *path,
+                                             GError       **error);
+gboolean       snapshot_file_is_published   (SnapshotFile  *file);
+void           snapshot_file_withdraw       (SnapshotFile  *file);
+
+G_END_DECLS
+
+#endif /* __SNAPSHOT_FILE_H__ */
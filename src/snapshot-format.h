@@ -0,0 +1,140 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __SNAPSHOT_FORMAT_H__
+#define __SNAPSHOT_FORMAT_H__
+
+#include <stdint.h>
+
+/*
+ * Layout of the group table that OpenSnapshot hands out as a sealed
+ * memfd. Everything is addressed by byte offsets from the start of the
+ * file, so it can be mapped anywhere, and uses host byte order since it
+ * never leaves the machine.
+ *
+ *   GsSnapshotHeader
+ *   GsSnapshotGroup  groups[n_groups]        sorted by gid, then name
+ *   uint32_t         name_index[n_buckets]   open addressing on
+ *                                            gs_snapshot_hash (name),
+ *                                            group index + 1, 0 is empty
+ *   uint32_t         members[n_members]      string offsets, each group's
+ *                                            members are contiguous
+ *   GsSnapshotUser   users[n_users]          every name listed as a member
+ *   uint32_t         user_index[n_user_buckets]
+ *                                            like name_index, for users
+ *   uint32_t         user_groups[n_user_groups]
+ *                                            group indexes, each user's
+ *                                            groups are contiguous
+ *   char             strings[strings_size]   NUL-terminated names
+ *
+ * generation is the daemon generation the table was built from. As long
+ * as the daemon runs, it stores its newer generation in live_generation
+ * once the table is out of date; a client that sees the two differ asks
+ * for a new snapshot. With GS_SNAPSHOT_FLAG_STATIC the kernel could not
+ * seal the file against writers while keeping the daemon's mapping, so
+ * live_generation never moves and the Generation property has to be
+ * watched instead.
+ *
+ * The daemon also publishes the table as a regular file for readers that
+ * cannot use the bus (the NSS module). It holds a shared flock on that
+ * file while it runs; a reader that can take an exclusive lock knows the
+ * daemon is gone and the contents are not being kept current.
+ *
+ * sources records the group and passwd files the table was parsed from:
+ * their path (a string offset) and the (mtime in usec, size, inode) the
+ * daemon saw before parsing them. A reader that finds a different stamp
+ * on disk knows the files were edited after the table was built, whether
+ * or not the daemon is still there to notice.
+ */
+
+#define GS_SNAPSHOT_PATH         "/run/group-service/snapshot"
+
+#define GS_SNAPSHOT_MAGIC        0x31534347u  /* "GSS1" */
+#define GS_SNAPSHOT_VERSION      3
+
+#define GS_SNAPSHOT_FLAG_STATIC  (1u << 0)
+
+#define GS_SNAPSHOT_GROUP_PRIMARY (1u << 0)
+
+#define GS_SNAPSHOT_SOURCE_GROUP  0
+#define GS_SNAPSHOT_SOURCE_PASSWD 1
+#define GS_SNAPSHOT_N_SOURCES     2
+
+typedef struct
+{
+    uint64_t mtime_usec;
+    uint64_t size;
+    uint64_t ino;
+    uint32_t path;
+    uint32_t reserved;
+} GsSnapshotSource;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+    uint64_t live_generation;
+    uint32_t flags;
+    uint32_t size;
+    uint32_t n_groups;
+    uint32_t groups_offset;
+    uint32_t n_buckets;
+    uint32_t name_index_offset;
+    uint32_t n_members;
+    uint32_t members_offset;
+    uint32_t n_users;
+    uint32_t users_offset;
+    uint32_t n_user_buckets;
+    uint32_t user_index_offset;
+    uint32_t n_user_groups;
+    uint32_t user_groups_offset;
+    uint32_t strings_size;
+    uint32_t strings_offset;
+    GsSnapshotSource sources[GS_SNAPSHOT_N_SOURCES];
+} GsSnapshotHeader;
+
+typedef struct
+{
+    uint32_t name;
+    uint32_t gid;
+    uint32_t hash;
+    uint32_t flags;
+    uint32_t members;
+    uint32_t n_members;
+} GsSnapshotGroup;
+
+typedef struct
+{
+    uint32_t name;
+    uint32_t hash;
+    uint32_t groups;
+    uint32_t n_groups;
+} GsSnapshotUser;
+
+/* 32-bit FNV-1a, used by the writer and every reader */
+static inline uint32_t gs_snapshot_hash (const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0')
+    {
+        hash ^= (unsigned char) *name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+#endif /* __SNAPSHOT_FORMAT_H__ */
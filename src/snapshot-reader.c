@@ -0,0 +1,310 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot-reader.h"
+
+static const GsSnapshotGroup *snapshot_groups (const GsSnapshot *snapshot)
+{
+    return (const GsSnapshotGroup *) (snapshot->base + snapshot->header->groups_offset);
+}
+
+static const GsSnapshotUser *snapshot_users (const GsSnapshot *snapshot)
+{
+    return (const GsSnapshotUser *) (snapshot->base + snapshot->header->users_offset);
+}
+
+static const char *snapshot_string (const GsSnapshot *snapshot, uint32_t offset)
+{
+    if (offset >= snapshot->header->strings_size)
+    {
+        return NULL;
+    }
+    return (const char *) snapshot->base + snapshot->header->strings_offset + offset;
+}
+
+static int section_fits (const GsSnapshotHeader *header,
+                         uint32_t                offset,
+                         uint64_t                length,
+                         uint32_t                align)
+{
+    return offset % align == 0 &&
+           offset >= sizeof (GsSnapshotHeader) &&
+           (uint64_t) offset + length <= header->size;
+}
+
+/* Maps fd read-only and checks that every section lies inside the file.
+ * The fd can be closed afterwards. Returns 0 or a negative errno. */
+int gs_snapshot_map (int fd, GsSnapshot *snapshot)
+{
+    const GsSnapshotHeader *header;
+    struct stat st;
+    void *base;
+
+    memset (snapshot, 0, sizeof (*snapshot));
+    if (fstat (fd, &st) < 0)
+    {
+        return -errno;
+    }
+    if ((size_t) st.st_size < sizeof (GsSnapshotHeader))
+    {
+        return -EBADMSG;
+    }
+    base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        return -errno;
+    }
+
+    header = base;
+    if (header->magic != GS_SNAPSHOT_MAGIC ||
+        header->version != GS_SNAPSHOT_VERSION ||
+        header->size > (uint64_t) st.st_size ||
+        (header->n_buckets & (header->n_buckets - 1)) != 0 ||
+        header->n_buckets <= header->n_groups ||
+        (header->n_user_buckets & (header->n_user_buckets - 1)) != 0 ||
+        header->n_user_buckets <= header->n_users ||
+        !section_fits (header, header->groups_offset,
+                       (uint64_t) header->n_groups * sizeof (GsSnapshotGroup), 4) ||
+        !section_fits (header, header->name_index_offset,
+                       (uint64_t) header->n_buckets * sizeof (uint32_t), 4) ||
+        !section_fits (header, header->members_offset,
+                       (uint64_t) header->n_members * sizeof (uint32_t), 4) ||
+        !section_fits (header, header->users_offset,
+                       (uint64_t) header->n_users * sizeof (GsSnapshotUser), 4) ||
+        !section_fits (header, header->user_index_offset,
+                       (uint64_t) header->n_user_buckets * sizeof (uint32_t), 4) ||
+        !section_fits (header, header->user_groups_offset,
+                       (uint64_t) header->n_user_groups * sizeof (uint32_t), 4) ||
+        !section_fits (header, header->strings_offset, header->strings_size, 1) ||
+        header->strings_size == 0 ||
+        ((const char *) base)[header->strings_offset + header->strings_size - 1] != '\0')
+    {
+        munmap (base, st.st_size);
+        return -EBADMSG;
+    }
+
+    snapshot->base = base;
+    snapshot->size = st.st_size;
+    snapshot->header = header;
+
+    return 0;
+}
+
+void gs_snapshot_unmap (GsSnapshot *snapshot)
+{
+    if (snapshot->base != NULL)
+    {
+        munmap ((void *) snapshot->base, snapshot->size);
+    }
+    memset (snapshot, 0, sizeof (*snapshot));
+}
+
+/* False once the daemon has published a newer generation */
+int gs_snapshot_is_current (const GsSnapshot *snapshot)
+{
+    return __atomic_load_n (&snapshot->header->live_generation, __ATOMIC_ACQUIRE) ==
+           snapshot->header->generation;
+}
+
+/* False once the group or passwd file on disk differs from the one the
+ * table was built from. Costs one stat() per source. */
+int gs_snapshot_sources_current (const GsSnapshot *snapshot)
+{
+    uint32_t i;
+
+    for (i = 0; i < GS_SNAPSHOT_N_SOURCES; i++)
+    {
+        const GsSnapshotSource *source = &snapshot->header->sources[i];
+        const char *path = snapshot_string (snapshot, source->path);
+        struct stat st;
+
+        if (path == NULL || path[0] == '\0' || stat (path, &st) < 0)
+        {
+            return 0;
+        }
+        if ((uint64_t) st.st_mtim.tv_sec * 1000000 +
+            st.st_mtim.tv_nsec / 1000 != source->mtime_usec ||
+            (uint64_t) st.st_size != source->size ||
+            (uint64_t) st.st_ino != source->ino)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Probes an index of entry number + 1 for the entry named name. Group
+ * and user entries both start with (name, ...) and carry the hash at
+ * hash_offset, so one loop serves both. */
+static const void *find_in_index (const GsSnapshot *snapshot,
+                                  uint32_t          index_offset,
+                                  uint32_t          n_buckets,
+                                  const uint8_t    *entries,
+                                  uint32_t          n_entries,
+                                  size_t            entry_size,
+                                  size_t            hash_offset,
+                                  const char       *name)
+{
+    const uint32_t *index;
+    uint32_t mask, hash, slot, i;
+
+    index = (const uint32_t *) (snapshot->base + index_offset);
+    mask = n_buckets - 1;
+    hash = gs_snapshot_hash (name);
+    for (i = 0, slot = hash & mask; i < n_buckets; i++, slot = (slot + 1) & mask)
+    {
+        const uint8_t *entry;
+        const char *candidate;
+
+        if (index[slot] == 0)
+        {
+            return NULL;
+        }
+        if (index[slot] > n_entries)
+        {
+            continue;
+        }
+        entry = entries + (size_t) (index[slot] - 1) * entry_size;
+        if (*(const uint32_t *) (entry + hash_offset) != hash)
+        {
+            continue;
+        }
+        candidate = snapshot_string (snapshot, *(const uint32_t *) entry);
+        if (candidate != NULL && strcmp (candidate, name) == 0)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+const GsSnapshotGroup *gs_snapshot_find_name (const GsSnapshot *snapshot, const char *name)
+{
+    const GsSnapshotHeader *header = snapshot->header;
+
+    return find_in_index (snapshot,
+                          header->name_index_offset,
+                          header->n_buckets,
+                          (const uint8_t *) snapshot_groups (snapshot),
+                          header->n_groups,
+                          sizeof (GsSnapshotGroup),
+                          offsetof (GsSnapshotGroup, hash),
+                          name);
+}
+
+/* Groups are sorted by gid; a gid shared by several groups returns the
+ * first by name, like the file order getgrgid would normally see. */
+const GsSnapshotGroup *gs_snapshot_find_gid (const GsSnapshot *snapshot, uint32_t gid)
+{
+    const GsSnapshotGroup *groups = snapshot_groups (snapshot);
+    uint32_t low = 0, high = snapshot->header->n_groups;
+
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+
+        if (groups[mid].gid < gid)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low < snapshot->header->n_groups && groups[low].gid == gid)
+    {
+        return &groups[low];
+    }
+
+    return NULL;
+}
+
+/* In gid order, for walking the whole table */
+const GsSnapshotGroup *gs_snapshot_get_group (const GsSnapshot *snapshot, uint32_t index)
+{
+    if (index >= snapshot->header->n_groups)
+    {
+        return NULL;
+    }
+
+    return &snapshot_groups (snapshot)[index];
+}
+
+const char *gs_snapshot_group_name (const GsSnapshot *snapshot, const GsSnapshotGroup *group)
+{
+    return snapshot_string (snapshot, group->name);
+}
+
+const char *gs_snapshot_group_member (const GsSnapshot      *snapshot,
+                                      const GsSnapshotGroup *group,
+                                      uint32_t               index)
+{
+    const uint32_t *members;
+
+    if (index >= group->n_members ||
+        (uint64_t) group->members + index >= snapshot->header->n_members)
+    {
+        return NULL;
+    }
+    members = (const uint32_t *) (snapshot->base + snapshot->header->members_offset);
+
+    return snapshot_string (snapshot, members[group->members + index]);
+}
+
+/* The user a reverse-membership lookup starts from, NULL if the name is
+ * not a member of any group */
+const GsSnapshotUser *gs_snapshot_find_user (const GsSnapshot *snapshot, const char *name)
+{
+    const GsSnapshotHeader *header = snapshot->header;
+
+    if (header->n_users == 0)
+    {
+        return NULL;
+    }
+    return find_in_index (snapshot,
+                          header->user_index_offset,
+                          header->n_user_buckets,
+                          (const uint8_t *) snapshot_users (snapshot),
+                          header->n_users,
+                          sizeof (GsSnapshotUser),
+                          offsetof (GsSnapshotUser, hash),
+                          name);
+}
+
+const GsSnapshotGroup *gs_snapshot_user_group (const GsSnapshot     *snapshot,
+                                               const GsSnapshotUser *user,
+                                               uint32_t              index)
+{
+    const uint32_t *user_groups;
+    uint32_t group;
+
+    if (index >= user->n_groups ||
+        (uint64_t) user->groups + index >= snapshot->header->n_user_groups)
+    {
+        return NULL;
+    }
+    user_groups = (const uint32_t *) (snapshot->base + snapshot->header->user_groups_offset);
+    group = user_groups[user->groups + index];
+    if (group >= snapshot->header->n_groups)
+    {
+        return NULL;
+    }
+
+    return &snapshot_groups (snapshot)[group];
+}
@@ -0,0 +1,55 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __SNAPSHOT_READER_H__
+#define __SNAPSHOT_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "snapshot-format.h"
+
+/* Read side of snapshot-format.h. Plain C without GLib, so it can be
+ * linked into libgroupservice as well as programs that must not pull in
+ * GLib. */
+
+typedef struct
+{
+    const uint8_t          *base;
+    size_t                  size;
+    const GsSnapshotHeader *header;
+} GsSnapshot;
+
+int                     gs_snapshot_map          (int                    fd,
+                                                  GsSnapshot            *snapshot);
+void                    gs_snapshot_unmap        (GsSnapshot            *snapshot);
+int                     gs_snapshot_is_current   (const GsSnapshot      *snapshot);
+int                     gs_snapshot_sources_current (const GsSnapshot   *snapshot);
+const GsSnapshotGroup * gs_snapshot_find_name    (const GsSnapshot      *snapshot,
+                                                  const char            *name);
+const GsSnapshotGroup * gs_snapshot_find_gid     (const GsSnapshot      *snapshot,
+                                                  uint32_t               gid);
+const GsSnapshotGroup * gs_snapshot_get_group    (const GsSnapshot      *snapshot,
+                                                  uint32_t               index);
+const char *            gs_snapshot_group_name   (const GsSnapshot      *snapshot,
+                                                  const GsSnapshotGroup *group);
+const char *            gs_snapshot_group_member (const GsSnapshot      *snapshot,
+                                                  const GsSnapshotGroup *group,
+                                                  uint32_t               index);
+const GsSnapshotUser *  gs_snapshot_find_user    (const GsSnapshot      *snapshot,
+                                                  const char            *name);
+const GsSnapshotGroup * gs_snapshot_user_group   (const GsSnapshot      *snapshot,
+                                                  const GsSnapshotUser  *user,
+                                                  uint32_t               index);
+
+#endif /* __SNAPSHOT_READER_H__ */
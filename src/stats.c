@@ -0,0 +1,359 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "probes.h"
+#include "stats.h"
+
+/*
+ * Counters behind org.group.admin.Stats. Every update happens on the
+ * daemon's main context, so plain integers are enough and no locking is
+ * needed on the hot path. Latencies go into log2 histograms whose first
+ * bucket ends at 16us and whose last bucket is open ended.
+ */
+
+#define STATS_N_BUCKETS     20
+#define STATS_FIRST_BUCKET  4
+
+typedef struct
+{
+    guint64 buckets[STATS_N_BUCKETS];
+} StatsHistogram;
+
+typedef struct
+{
+    guint64        calls;
+    guint64        errors;
+    StatsHistogram phases[STATS_N_PHASES];
+} StatsMethodCounters;
+
+typedef struct
+{
+    guint64 total;
+    guint64 last;
+    guint64 max;
+} StatsDuration;
+
+typedef struct
+{
+    StatsMethod method;
+    gint64      start;
+    gint64      reply;
+    gboolean    failed;
+} StatsCall;
+
+static StatsMethodCounters method_counters[STATS_N_METHODS];
+static StatsDuration       reload_phases[STATS_N_RELOAD_PHASES];
+static StatsDuration       reload_total;
+static guint64             reloads;
+static guint64             startup_phases[STATS_N_STARTUP_PHASES];
+static gboolean            warm_start;
+static guint               in_flight;
+static gint64              last_activity;
+static guint64             userdb_calls;
+static guint64             userdb_errors;
+
+static const gchar *method_names[STATS_N_METHODS] =
+{
+    "ListCachedGroups",
+    "ListCachedGroupsIfChanged",
+    "GetGroupIfModified",
+    "FindGroupById",
+    "FindGroupByName",
+    "CreateGroup",
+    "DeleteGroup",
+    "ChangeGroupName",
+    "ChangeGroupId",
+    "AddUserToGroup",
+    "RemoveUserFromGroup",
+    "AllocateGid",
+    "CreateGroupWithGid",
+    "OpenSnapshot",
+    "DumpGroups",
+    "Watch",
+    "Unwatch",
+    "IsMember",
+    "GetMembershipMatrix",
+};
+
+static const gchar *phase_names[STATS_N_PHASES] =
+{
+    "queue",
+    "polkit",
+    "subprocess",
+    "reply",
+    "total",
+};
+
+static const gchar *reload_phase_names[STATS_N_RELOAD_PHASES] =
+{
+    "parse",
+    "index",
+    "diff",
+    "export",
+    "signal",
+};
+
+static const gchar *startup_phase_names[STATS_N_STARTUP_PHASES] =
+{
+    "bus",
+    "load",
+    "export",
+    "total",
+};
+
+static GQuark stats_call_quark (void)
+{
+    return g_quark_from_static_string ("group-service-stats-call");
+}
+
+static void histogram_add (StatsHistogram *histogram, gint64 usec)
+{
+    guint bucket = 0;
+    guint64 bound = 1u << STATS_FIRST_BUCKET;
+
+    while (bucket < STATS_N_BUCKETS - 1 && (guint64) MAX (usec, 0) >= bound)
+    {
+        bound <<= 1;
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+}
+
+static void duration_add (StatsDuration *duration, gint64 usec)
+{
+    duration->total += usec;
+    duration->last = usec;
+    duration->max = MAX (duration->max, (guint64) usec);
+}
+
+/* Runs when the invocation is finalized, which happens right after the
+ * reply (or error) has been handed to the connection. */
+static void stats_call_done (gpointer data, GObject *invocation)
+{
+    StatsCall *call = data;
+    StatsMethodCounters *counters = &method_counters[call->method];
+    gint64 elapsed;
+
+    last_activity = g_get_monotonic_time ();
+    elapsed = last_activity - call->start;
+    in_flight--;
+    if (call->failed)
+    {
+        counters->errors++;
+    }
+    if (call->reply > 0)
+    {
+        histogram_add (&counters->phases[STATS_PHASE_REPLY], last_activity - call->reply);
+        GS_PROBE2 (method__reply, method_names[call->method], last_activity - call->reply);
+    }
+    histogram_add (&counters->phases[STATS_PHASE_TOTAL], elapsed);
+    GS_PROBE3 (method__done, method_names[call->method], call->failed, elapsed);
+    g_free (call);
+}
+
+void stats_method_begin (GDBusMethodInvocation *invocation, StatsMethod method)
+{
+    StatsCall *call;
+
+    g_return_if_fail (method < STATS_N_METHODS);
+
+    call = g_new0 (StatsCall, 1);
+    call->method = method;
+    call->start = g_get_monotonic_time ();
+    last_activity = call->start;
+    in_flight++;
+    method_counters[method].calls++;
+    GS_PROBE1 (method__start, method_names[method]);
+
+    g_object_set_qdata (G_OBJECT (invocation), stats_call_quark (), call);
+    g_object_weak_ref (G_OBJECT (invocation), stats_call_done, call);
+}
+
+void stats_method_failed (GDBusMethodInvocation *invocation)
+{
+    StatsCall *call;
+
+    call = g_object_get_qdata (G_OBJECT (invocation), stats_call_quark ());
+    if (call != NULL)
+    {
+        call->failed = TRUE;
+    }
+}
+
+/* Called by the handler right before complete_* or an error return; the
+ * reply phase runs from here until the invocation is finalized */
+void stats_method_reply (GDBusMethodInvocation *invocation)
+{
+    StatsCall *call;
+
+    call = g_object_get_qdata (G_OBJECT (invocation), stats_call_quark ());
+    if (call != NULL && call->reply == 0)
+    {
+        call->reply = g_get_monotonic_time ();
+    }
+}
+
+void stats_method_phase (GDBusMethodInvocation *invocation,
+                         StatsPhase             phase,
+                         gint64                 usec)
+{
+    StatsCall *call;
+
+    if (invocation == NULL)
+        return;
+
+    call = g_object_get_qdata (G_OBJECT (invocation), stats_call_quark ());
+    if (call != NULL)
+    {
+        histogram_add (&method_counters[call->method].phases[phase], usec);
+    }
+}
+
+const gchar *stats_method_name (GDBusMethodInvocation *invocation)
+{
+    StatsCall *call;
+
+    call = g_object_get_qdata (G_OBJECT (invocation), stats_call_quark ());
+    if (call == NULL)
+        return g_dbus_method_invocation_get_method_name (invocation);
+
+    return method_names[call->method];
+}
+
+void stats_reload_phase (StatsReloadPhase phase, gint64 usec)
+{
+    duration_add (&reload_phases[phase], usec);
+    GS_PROBE2 (reload__phase, reload_phase_names[phase], usec);
+}
+
+void stats_reload_done (gint64 usec)
+{
+    reloads++;
+    duration_add (&reload_total, usec);
+}
+
+void stats_startup_phase (StatsStartupPhase phase, gint64 usec)
+{
+    startup_phases[phase] = usec;
+}
+
+void stats_startup_set_warm (gboolean warm)
+{
+    warm_start = warm;
+}
+
+/* A Varlink call answered without going through the bus */
+void stats_userdb_request (gboolean failed)
+{
+    userdb_calls++;
+    if (failed)
+        userdb_errors++;
+    last_activity = g_get_monotonic_time ();
+}
+
+/* Invocations that have started but not been answered yet */
+guint stats_get_in_flight (void)
+{
+    return in_flight;
+}
+
+gint64 stats_get_last_activity (void)
+{
+    return last_activity;
+}
+
+guint64 stats_get_rss (void)
+{
+    g_autofree gchar *contents = NULL;
+    guint64 size = 0;
+    guint64 resident = 0;
+
+    if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+        return 0;
+    if (sscanf (contents, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT, &size, &resident) != 2)
+        return 0;
+
+    return resident * sysconf (_SC_PAGESIZE);
+}
+
+static GVariant *duration_to_variant (StatsDuration *duration)
+{
+    return g_variant_new ("(ttt)", duration->total, duration->last, duration->max);
+}
+
+void stats_add_counters (GVariantBuilder *builder)
+{
+    GVariantBuilder methods;
+    GVariantBuilder latency;
+    GVariantBuilder bounds;
+    GVariantBuilder phases;
+    GVariantBuilder startup;
+    guint i, p;
+
+    g_variant_builder_init (&methods, G_VARIANT_TYPE ("a{s(tt)}"));
+    g_variant_builder_init (&latency, G_VARIANT_TYPE ("a{sat}"));
+    for (i = 0; i < STATS_N_METHODS; i++)
+    {
+        g_variant_builder_add (&methods, "{s(tt)}", method_names[i],
+                               method_counters[i].calls,
+                               method_counters[i].errors);
+        for (p = 0; p < STATS_N_PHASES; p++)
+        {
+            g_autofree gchar *key = g_strdup_printf ("%s.%s", method_names[i], phase_names[p]);
+
+            g_variant_builder_add (&latency, "{s@at}", key,
+                                   g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                              method_counters[i].phases[p].buckets,
+                                                              STATS_N_BUCKETS,
+                                                              sizeof (guint64)));
+        }
+    }
+
+    g_variant_builder_init (&bounds, G_VARIANT_TYPE ("at"));
+    for (i = 0; i < STATS_N_BUCKETS - 1; i++)
+    {
+        g_variant_builder_add (&bounds, "t", (guint64) 1 << (STATS_FIRST_BUCKET + i));
+    }
+
+    g_variant_builder_init (&phases, G_VARIANT_TYPE ("a{s(ttt)}"));
+    for (i = 0; i < STATS_N_RELOAD_PHASES; i++)
+    {
+        g_variant_builder_add (&phases, "{s@(ttt)}", reload_phase_names[i],
+                               duration_to_variant (&reload_phases[i]));
+    }
+
+    g_variant_builder_init (&startup, G_VARIANT_TYPE ("a{st}"));
+    for (i = 0; i < STATS_N_STARTUP_PHASES; i++)
+    {
+        g_variant_builder_add (&startup, "{st}", startup_phase_names[i], startup_phases[i]);
+    }
+
+    g_variant_builder_add (builder, "{sv}", "methods", g_variant_builder_end (&methods));
+    g_variant_builder_add (builder, "{sv}", "latency", g_variant_builder_end (&latency));
+    g_variant_builder_add (builder, "{sv}", "latency-bounds-usec", g_variant_builder_end (&bounds));
+    g_variant_builder_add (builder, "{sv}", "reloads", g_variant_new_uint64 (reloads));
+    g_variant_builder_add (builder, "{sv}", "reload-usec", duration_to_variant (&reload_total));
+    g_variant_builder_add (builder, "{sv}", "reload-phases-usec", g_variant_builder_end (&phases));
+    g_variant_builder_add (builder, "{sv}", "startup-usec", g_variant_builder_end (&startup));
+    g_variant_builder_add (builder, "{sv}", "warm-start", g_variant_new_boolean (warm_start));
+    g_variant_builder_add (builder, "{sv}", "in-flight", g_variant_new_uint32 (in_flight));
+    g_variant_builder_add (builder, "{sv}", "userdb", g_variant_new ("(tt)", userdb_calls, userdb_errors));
+    g_variant_builder_add (builder, "{sv}", "rss-bytes", g_variant_new_uint64 (stats_get_rss ()));
+}
@@ -0,0 +1,98 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    STATS_METHOD_LIST_CACHED_GROUPS,
+    STATS_METHOD_LIST_CACHED_GROUPS_IF_CHANGED,
+    STATS_METHOD_GET_GROUP_IF_MODIFIED,
+    STATS_METHOD_FIND_GROUP_BY_ID,
+    STATS_METHOD_FIND_GROUP_BY_NAME,
+    STATS_METHOD_CREATE_GROUP,
+    STATS_METHOD_DELETE_GROUP,
+    STATS_METHOD_CHANGE_GROUP_NAME,
+    STATS_METHOD_CHANGE_GROUP_ID,
+    STATS_METHOD_ADD_USER_TO_GROUP,
+    STATS_METHOD_REMOVE_USER_FROM_GROUP,
+    STATS_METHOD_ALLOCATE_GID,
+    STATS_METHOD_CREATE_GROUP_WITH_GID,
+    STATS_METHOD_OPEN_SNAPSHOT,
+    STATS_METHOD_DUMP_GROUPS,
+    STATS_METHOD_WATCH,
+    STATS_METHOD_UNWATCH,
+    STATS_METHOD_IS_MEMBER,
+    STATS_METHOD_GET_MEMBERSHIP_MATRIX,
+    STATS_N_METHODS
+} StatsMethod;
+
+typedef enum
+{
+    STATS_PHASE_QUEUE,
+    STATS_PHASE_POLKIT,
+    STATS_PHASE_SUBPROCESS,
+    STATS_PHASE_REPLY,          /* from the answer being ready to it being sent */
+    STATS_PHASE_TOTAL,          /* the whole call, not a phase of its own */
+    STATS_N_PHASES
+} StatsPhase;
+
+typedef enum
+{
+    STATS_RELOAD_PARSE,
+    STATS_RELOAD_INDEX,
+    STATS_RELOAD_DIFF,
+    STATS_RELOAD_EXPORT,
+    STATS_RELOAD_SIGNAL,
+    STATS_N_RELOAD_PHASES
+} StatsReloadPhase;
+
+typedef enum
+{
+    STATS_STARTUP_BUS,
+    STATS_STARTUP_LOAD,
+    STATS_STARTUP_EXPORT,
+    STATS_STARTUP_TOTAL,
+    STATS_N_STARTUP_PHASES
+} StatsStartupPhase;
+
+void          stats_method_begin     (GDBusMethodInvocation *invocation,
+                                      StatsMethod            method);
+void          stats_method_failed    (GDBusMethodInvocation *invocation);
+void          stats_method_reply     (GDBusMethodInvocation *invocation);
+void          stats_method_phase     (GDBusMethodInvocation *invocation,
+                                      StatsPhase             phase,
+                                      gint64                 usec);
+const gchar * stats_method_name      (GDBusMethodInvocation *invocation);
+void          stats_reload_phase     (StatsReloadPhase       phase,
+                                      gint64                 usec);
+void          stats_reload_done      (gint64                 usec);
+void          stats_startup_phase    (StatsStartupPhase      phase,
+                                      gint64                 usec);
+void          stats_startup_set_warm (gboolean               warm);
+void          stats_userdb_request   (gboolean               failed);
+guint         stats_get_in_flight    (void);
+gint64        stats_get_last_activity (void);
+void          stats_add_counters     (GVariantBuilder       *builder);
+guint64       stats_get_rss          (void);
+
+G_END_DECLS
+
+#endif /* __STATS_H__ */
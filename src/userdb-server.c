@@ -0,0 +1,805 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "json-variant.h"
+#include "snapshot-reader.h"
+#include "stats.h"
+#include "userdb-server.h"
+
+/*
+ * io.systemd.UserDatabase over Varlink, so userdbctl and friends can ask
+ * the daemon for groups without going through D-Bus. Messages are JSON
+ * objects terminated by a NUL byte. Answers come straight from the table
+ * OpenSnapshot hands out, mapped once per generation, which already has
+ * a name index, gid order and reverse membership. Every client is served
+ * one request at a time: while a reply is being written nothing more is
+ * read, and an enumeration is written in batches so a slow reader only
+ * holds up itself.
+ */
+
+#define USERDB_MAX_MESSAGE  (64 * 1024)
+#define USERDB_BATCH        128
+
+#define USERDB_ERROR_NO_RECORD     "io.systemd.UserDatabase.NoRecordFound"
+#define USERDB_ERROR_CONFLICT      "io.systemd.UserDatabase.ConflictingRecordFound"
+#define USERDB_ERROR_BAD_SERVICE   "io.systemd.UserDatabase.BadService"
+#define USERDB_ERROR_UNAVAILABLE   "io.systemd.UserDatabase.ServiceNotAvailable"
+#define VARLINK_ERROR_NO_METHOD    "org.varlink.service.MethodNotFound"
+#define VARLINK_ERROR_BAD_PARAM    "org.varlink.service.InvalidParameter"
+#define VARLINK_ERROR_EXPECTED_MORE "org.varlink.service.ExpectedMore"
+
+/* A mapping of one generation of the table; enumerations keep theirs
+ * while the daemon moves on */
+typedef struct
+{
+    gint       ref_count;
+    GsSnapshot map;
+} UserdbTable;
+
+typedef enum
+{
+    CURSOR_NONE,
+    CURSOR_GROUPS,          /* every group record */
+    CURSOR_MEMBERSHIPS,     /* every (user, group) pair */
+    CURSOR_USER_GROUPS,     /* the groups of one user */
+    CURSOR_GROUP_MEMBERS,   /* the members of one group */
+} CursorKind;
+
+typedef struct
+{
+    UserdbServer      *server;
+    GSocketConnection *connection;
+    GCancellable      *cancellable;
+    GByteArray        *in;
+    GString           *out;
+    gboolean           reading;
+    gboolean           writing;
+    gboolean           failed;
+
+    CursorKind             kind;
+    UserdbTable           *table;
+    const GsSnapshotGroup *group;
+    const GsSnapshotUser  *user;
+    gchar                 *user_name;
+    guint32                index;
+    guint32                member;
+    GString               *pending;
+
+    guint8             buffer[4096];
+} UserdbClient;
+
+struct UserdbServer
+{
+    Manage         *manage;
+    gchar          *path;
+    GSocketService *service;
+    UserdbTable    *table;
+    GList          *clients;
+};
+
+static void ReadMore (UserdbClient *client);
+static void ProcessInput (UserdbClient *client);
+
+static void TableUnref (UserdbTable *table)
+{
+    if (--table->ref_count == 0)
+    {
+        gs_snapshot_unmap (&table->map);
+        g_free (table);
+    }
+}
+
+static UserdbTable *GetTable (UserdbServer *server, GError **error)
+{
+    UserdbTable *table;
+    guint64 generation;
+    gint fd;
+    int ret;
+
+    fd = ManageGetSnapshotFd (server->manage, &generation, error);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (server->table != NULL && server->table->map.header->generation == generation)
+    {
+        return server->table;
+    }
+
+    table = g_new0 (UserdbTable, 1);
+    table->ref_count = 1;
+    ret = gs_snapshot_map (fd, &table->map);
+    if (ret < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (-ret),
+                     "Unable to map the group table: %s", g_strerror (-ret));
+        g_free (table);
+        return NULL;
+    }
+    g_clear_pointer (&server->table, TableUnref);
+    server->table = table;
+
+    return table;
+}
+
+static void ClientFree (UserdbClient *client)
+{
+    if (client->server != NULL)
+    {
+        client->server->clients = g_list_remove (client->server->clients, client);
+    }
+    g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+    g_object_unref (client->connection);
+    g_object_unref (client->cancellable);
+    g_byte_array_unref (client->in);
+    g_string_free (client->out, TRUE);
+    if (client->table != NULL)
+        TableUnref (client->table);
+    if (client->pending != NULL)
+        g_string_free (client->pending, TRUE);
+    g_free (client->user_name);
+    g_free (client);
+}
+
+static void AppendReply (UserdbClient *client, const gchar *parameters, gboolean continues)
+{
+    g_string_append_printf (client->out, "{\"parameters\":%s%s}",
+                            parameters,
+                            continues ? ",\"continues\":true" : "");
+    g_string_append_c (client->out, '\0');
+}
+
+static void AppendError (UserdbClient *client, const gchar *error, const gchar *parameters)
+{
+    g_string_append_printf (client->out, "{\"error\":\"%s\",\"parameters\":%s}",
+                            error,
+                            parameters != NULL ? parameters : "{}");
+    g_string_append_c (client->out, '\0');
+    client->failed = TRUE;
+}
+
+static void AppendInvalidParameter (UserdbClient *client, const gchar *name)
+{
+    g_autoptr(GString) parameters = g_string_new ("{\"parameter\":");
+
+    json_append_string (parameters, name);
+    g_string_append_c (parameters, '}');
+    AppendError (client, VARLINK_ERROR_BAD_PARAM, parameters->str);
+}
+
+static void AppendGroupRecord (GString *out, const GsSnapshot *map, const GsSnapshotGroup *group)
+{
+    guint32 i;
+
+    g_string_append (out, "{\"record\":{\"groupName\":");
+    json_append_string (out, gs_snapshot_group_name (map, group));
+    g_string_append_printf (out, ",\"gid\":%u", group->gid);
+    if (group->n_members > 0)
+    {
+        g_string_append (out, ",\"members\":[");
+        for (i = 0; i < group->n_members; i++)
+        {
+            const gchar *member = gs_snapshot_group_member (map, group, i);
+
+            if (i > 0)
+                g_string_append_c (out, ',');
+            json_append_string (out, member != NULL ? member : "");
+        }
+        g_string_append_c (out, ']');
+    }
+    g_string_append (out, ",\"service\":\"" USERDB_SERVICE "\"},\"incomplete\":false}");
+}
+
+static void AppendMembership (GString *out, const gchar *user, const gchar *group)
+{
+    g_string_append (out, "{\"userName\":");
+    json_append_string (out, user);
+    g_string_append (out, ",\"groupName\":");
+    json_append_string (out, group);
+    g_string_append_c (out, '}');
+}
+
+/* Formats the next reply of the running enumeration into out */
+static gboolean CursorNext (UserdbClient *client, GString *out)
+{
+    const GsSnapshot *map = &client->table->map;
+    const GsSnapshotGroup *group;
+
+    switch (client->kind)
+    {
+    case CURSOR_GROUPS:
+        group = gs_snapshot_get_group (map, client->index++);
+        if (group == NULL)
+            return FALSE;
+        AppendGroupRecord (out, map, group);
+        return TRUE;
+
+    case CURSOR_MEMBERSHIPS:
+        while ((group = gs_snapshot_get_group (map, client->index)) != NULL)
+        {
+            if (client->member < group->n_members)
+            {
+                AppendMembership (out,
+                                  gs_snapshot_group_member (map, group, client->member++),
+                                  gs_snapshot_group_name (map, group));
+                return TRUE;
+            }
+            client->index++;
+            client->member = 0;
+        }
+        return FALSE;
+
+    case CURSOR_USER_GROUPS:
+        group = gs_snapshot_user_group (map, client->user, client->index++);
+        if (group == NULL)
+            return FALSE;
+        AppendMembership (out, client->user_name, gs_snapshot_group_name (map, group));
+        return TRUE;
+
+    case CURSOR_GROUP_MEMBERS:
+        if (client->member >= client->group->n_members)
+            return FALSE;
+        AppendMembership (out,
+                          gs_snapshot_group_member (map, client->group, client->member++),
+                          gs_snapshot_group_name (map, client->group));
+        return TRUE;
+
+    case CURSOR_NONE:
+    default:
+        return FALSE;
+    }
+}
+
+static void CursorStop (UserdbClient *client)
+{
+    client->kind = CURSOR_NONE;
+    g_clear_pointer (&client->table, TableUnref);
+    g_clear_pointer (&client->user_name, g_free);
+    client->group = NULL;
+    client->user = NULL;
+    if (client->pending != NULL)
+    {
+        g_string_free (client->pending, TRUE);
+        client->pending = NULL;
+    }
+}
+
+/* One reply is always held back until the next is known, since only the
+ * last one goes out without "continues" */
+static void CursorContinue (UserdbClient *client)
+{
+    guint n;
+
+    for (n = 0; n < USERDB_BATCH; n++)
+    {
+        GString *next = g_string_new (NULL);
+
+        if (!CursorNext (client, next))
+        {
+            g_string_free (next, TRUE);
+            if (client->pending == NULL)
+                AppendError (client, USERDB_ERROR_NO_RECORD, NULL);
+            else
+                AppendReply (client, client->pending->str, FALSE);
+            CursorStop (client);
+            return;
+        }
+        if (client->pending != NULL)
+        {
+            AppendReply (client, client->pending->str, TRUE);
+            g_string_free (client->pending, TRUE);
+        }
+        client->pending = next;
+    }
+}
+
+static void CursorStart (UserdbClient *client, CursorKind kind, UserdbTable *table)
+{
+    client->kind = kind;
+    client->table = table;
+    table->ref_count++;
+    client->index = 0;
+    client->member = 0;
+    CursorContinue (client);
+}
+
+/* value is NULL when key is absent; FALSE means an InvalidParameter
+ * error has been queued */
+static gboolean LookupString (UserdbClient *client,
+                              GVariant     *parameters,
+                              const gchar  *key,
+                              const gchar **value)
+{
+    g_autoptr(GVariant) v = g_variant_lookup_value (parameters, key, NULL);
+
+    *value = NULL;
+    if (v == NULL)
+    {
+        return TRUE;
+    }
+    if (!g_variant_is_of_type (v, G_VARIANT_TYPE_STRING))
+    {
+        AppendInvalidParameter (client, key);
+        return FALSE;
+    }
+    /* parameters holds the string, so it outlives v */
+    *value = g_variant_get_string (v, NULL);
+
+    return TRUE;
+}
+
+static gboolean CheckService (UserdbClient *client, GVariant *parameters)
+{
+    const gchar *service;
+
+    if (!LookupString (client, parameters, "service", &service))
+    {
+        return FALSE;
+    }
+    if (service == NULL)
+    {
+        AppendInvalidParameter (client, "service");
+        return FALSE;
+    }
+    if (strcmp (service, USERDB_SERVICE) != 0)
+    {
+        AppendError (client, USERDB_ERROR_BAD_SERVICE, NULL);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static UserdbTable *RequireTable (UserdbClient *client)
+{
+    g_autoptr(GError) error = NULL;
+    UserdbTable *table;
+
+    table = GetTable (client->server, &error);
+    if (table == NULL)
+    {
+        g_warning ("userdb: %s", error->message);
+        AppendError (client, USERDB_ERROR_UNAVAILABLE, NULL);
+    }
+
+    return table;
+}
+
+static void GetGroupRecord (UserdbClient *client, GVariant *parameters, gboolean more)
+{
+    g_autoptr(GVariant) gid_value = NULL;
+    const GsSnapshotGroup *by_name = NULL, *by_gid = NULL;
+    const gchar *name;
+    UserdbTable *table;
+    gint64 gid = -1;
+
+    if (!CheckService (client, parameters) ||
+        !LookupString (client, parameters, "groupName", &name))
+    {
+        return;
+    }
+    gid_value = g_variant_lookup_value (parameters, "gid", NULL);
+    if (gid_value != NULL)
+    {
+        if (!g_variant_is_of_type (gid_value, G_VARIANT_TYPE_INT64) ||
+            (gid = g_variant_get_int64 (gid_value)) < 0 || gid >= G_MAXUINT32)
+        {
+            AppendInvalidParameter (client, "gid");
+            return;
+        }
+    }
+    if (name == NULL && gid < 0 && !more)
+    {
+        AppendError (client, VARLINK_ERROR_EXPECTED_MORE, NULL);
+        return;
+    }
+    if ((table = RequireTable (client)) == NULL)
+    {
+        return;
+    }
+    if (name == NULL && gid < 0)
+    {
+        CursorStart (client, CURSOR_GROUPS, table);
+        return;
+    }
+
+    if (name != NULL)
+        by_name = gs_snapshot_find_name (&table->map, name);
+    if (gid >= 0)
+        by_gid = gs_snapshot_find_gid (&table->map, (guint32) gid);
+    if (name != NULL && gid >= 0)
+    {
+        /* Both given: they have to describe the same group */
+        if (by_name != NULL && by_name->gid != (guint32) gid)
+        {
+            AppendError (client, USERDB_ERROR_CONFLICT, NULL);
+            return;
+        }
+        by_gid = NULL;
+    }
+    if (by_name == NULL && by_gid == NULL)
+    {
+        AppendError (client, USERDB_ERROR_NO_RECORD, NULL);
+        return;
+    }
+    {
+        g_autoptr(GString) reply = g_string_new (NULL);
+
+        AppendGroupRecord (reply, &table->map, by_name != NULL ? by_name : by_gid);
+        AppendReply (client, reply->str, FALSE);
+    }
+}
+
+static void GetMemberships (UserdbClient *client, GVariant *parameters, gboolean more)
+{
+    const GsSnapshotGroup *group = NULL;
+    const GsSnapshotUser *user = NULL;
+    const gchar *user_name, *group_name;
+    UserdbTable *table;
+    guint32 i;
+
+    if (!CheckService (client, parameters) ||
+        !LookupString (client, parameters, "userName", &user_name) ||
+        !LookupString (client, parameters, "groupName", &group_name))
+    {
+        return;
+    }
+    if ((table = RequireTable (client)) == NULL)
+    {
+        return;
+    }
+    if (user_name != NULL)
+        user = gs_snapshot_find_user (&table->map, user_name);
+    if (group_name != NULL)
+        group = gs_snapshot_find_name (&table->map, group_name);
+
+    if (user_name != NULL && group_name != NULL)
+    {
+        g_autoptr(GString) reply = g_string_new (NULL);
+
+        for (i = 0; user != NULL && group != NULL && i < user->n_groups; i++)
+        {
+            if (gs_snapshot_user_group (&table->map, user, i) == group)
+            {
+                AppendMembership (reply, user_name, group_name);
+                AppendReply (client, reply->str, FALSE);
+                return;
+            }
+        }
+        AppendError (client, USERDB_ERROR_NO_RECORD, NULL);
+        return;
+    }
+    if (user_name != NULL)
+    {
+        if (user == NULL)
+        {
+            AppendError (client, USERDB_ERROR_NO_RECORD, NULL);
+        }
+        else if (user->n_groups > 1 && !more)
+        {
+            AppendError (client, VARLINK_ERROR_EXPECTED_MORE, NULL);
+        }
+        else
+        {
+            client->user = user;
+            client->user_name = g_strdup (user_name);
+            CursorStart (client, CURSOR_USER_GROUPS, table);
+        }
+        return;
+    }
+    if (group_name != NULL)
+    {
+        if (group == NULL)
+        {
+            AppendError (client, USERDB_ERROR_NO_RECORD, NULL);
+        }
+        else if (group->n_members > 1 && !more)
+        {
+            AppendError (client, VARLINK_ERROR_EXPECTED_MORE, NULL);
+        }
+        else
+        {
+            client->group = group;
+            CursorStart (client, CURSOR_GROUP_MEMBERS, table);
+        }
+        return;
+    }
+
+    if (!more)
+    {
+        AppendError (client, VARLINK_ERROR_EXPECTED_MORE, NULL);
+        return;
+    }
+    CursorStart (client, CURSOR_MEMBERSHIPS, table);
+}
+
+/* Returns FALSE when the message is not Varlink at all, which ends the
+ * connection like any other protocol error */
+static gboolean HandleMessage (UserdbClient *client, const gchar *text, gsize length)
+{
+    g_autoptr(GVariant) message = NULL;
+    g_autoptr(GVariant) parameters = NULL;
+    g_autoptr(GError) error = NULL;
+    const gchar *method;
+    gboolean more = FALSE, oneway = FALSE;
+
+    message = json_variant_parse (text, length, &error);
+    if (message == NULL ||
+        !g_variant_is_of_type (message, G_VARIANT_TYPE_VARDICT) ||
+        !g_variant_lookup (message, "method", "&s", &method))
+    {
+        g_debug ("userdb: dropping client: %s", error != NULL ? error->message : "no method");
+        return FALSE;
+    }
+    g_variant_lookup (message, "more", "b", &more);
+    g_variant_lookup (message, "oneway", "b", &oneway);
+    /* Lookups change nothing, so a call that wants no reply needs no work */
+    if (oneway)
+    {
+        return TRUE;
+    }
+    parameters = g_variant_lookup_value (message, "parameters", G_VARIANT_TYPE_VARDICT);
+    if (parameters == NULL)
+    {
+        parameters = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0));
+    }
+
+    client->failed = FALSE;
+    if (strcmp (method, "io.systemd.UserDatabase.GetGroupRecord") == 0)
+    {
+        GetGroupRecord (client, parameters, more);
+    }
+    else if (strcmp (method, "io.systemd.UserDatabase.GetMemberships") == 0)
+    {
+        GetMemberships (client, parameters, more);
+    }
+    else if (strcmp (method, "io.systemd.UserDatabase.GetUserRecord") == 0)
+    {
+        /* Users belong to other services */
+        if (CheckService (client, parameters))
+            AppendError (client, USERDB_ERROR_NO_RECORD, NULL);
+    }
+    else if (strcmp (method, "org.varlink.service.GetInfo") == 0)
+    {
+        AppendReply (client,
+                     "{\"vendor\":\"group-service\",\"product\":\"group-admin-daemon\","
+                     "\"version\":\"" VERSION "\",\"url\":\"https://github.com/zhuyaliang/group-service\","
+                     "\"interfaces\":[\"io.systemd.UserDatabase\",\"org.varlink.service\"]}",
+                     FALSE);
+    }
+    else
+    {
+        g_autoptr(GString) reply = g_string_new ("{\"method\":");
+
+        json_append_string (reply, method);
+        g_string_append_c (reply, '}');
+        AppendError (client, VARLINK_ERROR_NO_METHOD, reply->str);
+    }
+    stats_userdb_request (client->failed);
+
+    return TRUE;
+}
+
+static void WriteDone (GObject *source, GAsyncResult *result, gpointer data)
+{
+    UserdbClient *client = data;
+    g_autoptr(GError) error = NULL;
+
+    client->writing = FALSE;
+    if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (source), result, NULL, &error))
+    {
+        ClientFree (client);
+        return;
+    }
+    g_string_truncate (client->out, 0);
+    if (client->kind != CURSOR_NONE)
+    {
+        CursorContinue (client);
+    }
+    ProcessInput (client);
+}
+
+static void Flush (UserdbClient *client)
+{
+    GOutputStream *output;
+
+    if (client->out->len == 0 || client->writing)
+    {
+        return;
+    }
+    client->writing = TRUE;
+    output = g_io_stream_get_output_stream (G_IO_STREAM (client->connection));
+    g_output_stream_write_all_async (output,
+                                     client->out->str,
+                                     client->out->len,
+                                     G_PRIORITY_DEFAULT,
+                                     client->cancellable,
+                                     WriteDone,
+                                     client);
+}
+
+/* Handles whatever complete messages have arrived, then either writes
+ * the replies or goes back to reading */
+static void ProcessInput (UserdbClient *client)
+{
+    while (client->out->len == 0 && client->kind == CURSOR_NONE)
+    {
+        guint8 *end = memchr (client->in->data, '\0', client->in->len);
+        gsize length;
+
+        if (end == NULL)
+        {
+            break;
+        }
+        length = end - client->in->data;
+        if (!HandleMessage (client, (const gchar *) client->in->data, length))
+        {
+            ClientFree (client);
+            return;
+        }
+        g_byte_array_remove_range (client->in, 0, length + 1);
+    }
+    if (client->out->len > 0)
+    {
+        Flush (client);
+        return;
+    }
+    if (client->in->len > USERDB_MAX_MESSAGE)
+    {
+        ClientFree (client);
+        return;
+    }
+    ReadMore (client);
+}
+
+static void ReadDone (GObject *source, GAsyncResult *result, gpointer data)
+{
+    UserdbClient *client = data;
+    g_autoptr(GError) error = NULL;
+    gssize n;
+
+    client->reading = FALSE;
+    n = g_input_stream_read_finish (G_INPUT_STREAM (source), result, &error);
+    if (n <= 0)
+    {
+        ClientFree (client);
+        return;
+    }
+    g_byte_array_append (client->in, client->buffer, n);
+    ProcessInput (client);
+}
+
+static void ReadMore (UserdbClient *client)
+{
+    GInputStream *input;
+
+    if (client->reading)
+    {
+        return;
+    }
+    client->reading = TRUE;
+    input = g_io_stream_get_input_stream (G_IO_STREAM (client->connection));
+    g_input_stream_read_async (input,
+                               client->buffer,
+                               sizeof (client->buffer),
+                               G_PRIORITY_DEFAULT,
+                               client->cancellable,
+                               ReadDone,
+                               client);
+}
+
+static gboolean Incoming (GSocketService    *service,
+                          GSocketConnection *connection,
+                          GObject           *source,
+                          gpointer           data)
+{
+    UserdbServer *server = data;
+    UserdbClient *client;
+
+    client = g_new0 (UserdbClient, 1);
+    client->server = server;
+    client->connection = g_object_ref (connection);
+    client->cancellable = g_cancellable_new ();
+    client->in = g_byte_array_new ();
+    client->out = g_string_new (NULL);
+    server->clients = g_list_prepend (server->clients, client);
+    ReadMore (client);
+
+    return TRUE;
+}
+
+UserdbServer *userdb_server_new (Manage *manage, const gchar *path, GError **error)
+{
+    g_autoptr(GSocketAddress) address = NULL;
+    g_autofree gchar *dir = NULL;
+    UserdbServer *server;
+    struct stat st;
+
+    dir = g_path_get_dirname (path);
+    if (g_mkdir_with_parents (dir, 0755) < 0)
+    {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Unable to create %s: %s", dir, g_strerror (errno));
+        return NULL;
+    }
+    /* Left behind by an instance that did not get to clean up */
+    if (g_lstat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+    {
+        g_unlink (path);
+    }
+
+    server = g_new0 (UserdbServer, 1);
+    server->manage = manage;
+    server->path = g_strdup (path);
+    server->service = g_socket_service_new ();
+    address = g_unix_socket_address_new (path);
+    if (!g_socket_listener_add_address (G_SOCKET_LISTENER (server->service),
+                                        address,
+                                        G_SOCKET_TYPE_STREAM,
+                                        G_SOCKET_PROTOCOL_DEFAULT,
+                                        NULL,
+                                        NULL,
+                                        error))
+    {
+        g_object_unref (server->service);
+        g_free (server->path);
+        g_free (server);
+        return NULL;
+    }
+    /* Group records are public, like /etc/group */
+    g_chmod (path, 0666);
+    g_signal_connect (server->service, "incoming", G_CALLBACK (Incoming), server);
+    g_socket_service_start (server->service);
+
+    return server;
+}
+
+/* Open connections, including ones in the middle of a "more" reply */
+guint userdb_server_get_n_clients (UserdbServer *server)
+{
+    return g_list_length (server->clients);
+}
+
+void userdb_server_free (UserdbServer *server)
+{
+    GList *l;
+
+    g_socket_service_stop (server->service);
+    g_socket_listener_close (G_SOCKET_LISTENER (server->service));
+    g_object_unref (server->service);
+    /* Each client has a read or a write outstanding, whose cancelled
+     * callback frees it */
+    for (l = server->clients; l != NULL; l = l->next)
+    {
+        UserdbClient *client = l->data;
+
+        client->server = NULL;
+        g_cancellable_cancel (client->cancellable);
+    }
+    g_list_free (server->clients);
+    if (server->table != NULL)
+        TableUnref (server->table);
+    g_unlink (server->path);
+    g_free (server->path);
+    g_free (server);
+}
@@ -0,0 +1,36 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef __USERDB_SERVER_H__
+#define __USERDB_SERVER_H__
+
+#include <glib.h>
+#include "group-server.h"
+
+G_BEGIN_DECLS
+
+#define USERDB_SERVICE      "org.group.admin"
+#define USERDB_SOCKET_PATH  "/run/systemd/userdb/" USERDB_SERVICE
+
+typedef struct UserdbServer UserdbServer;
+
+UserdbServer * userdb_server_new  (Manage        *manage,
+                                   const gchar   *path,
+                                   GError       **error);
+void           userdb_server_free (UserdbServer  *server);
+guint          userdb_server_get_n_clients (UserdbServer *server);
+
+G_END_DECLS
+
+#endif /* __USERDB_SERVER_H__ */
@@ -26,6 +26,8 @@
 #include <polkit/polkit.h>
 
 #include "util.h"
+#include "probes.h"
+#include "stats.h"
 
 static gchar *
 get_cmdline_of_pid (GPid pid)
@@ -225,6 +227,25 @@ compat_check_exit_status (int      estatus,
 #endif
 }
 
+static gchar *helper_dir = NULL;
+
+void
+set_helper_dir (const gchar *dir)
+{
+    g_free (helper_dir);
+    helper_dir = g_strdup (dir);
+}
+
+/* Paths are interned so callers can keep them in const argv arrays */
+const gchar *
+get_helper_path (const gchar *name)
+{
+    g_autofree gchar *path = NULL;
+
+    path = g_build_filename (helper_dir ? helper_dir : "/usr/sbin", name, NULL);
+    return g_intern_string (path);
+}
+
 static void
 setup_loginuid (gpointer data)
 {
@@ -248,6 +269,10 @@ spawn_with_login_uid (GDBusMethodInvocation  *context,
     gboolean ret = FALSE;
     gchar loginuid[20];
     gint status;
+    gint64 start;
+
+    start = g_get_monotonic_time ();
+    GS_PROBE1 (spawn__start, argv[0]);
     g_usleep(2000);
     get_caller_loginuid (context, loginuid, G_N_ELEMENTS (loginuid)-1);
 
@@ -258,6 +283,9 @@ spawn_with_login_uid (GDBusMethodInvocation  *context,
 
     ret = TRUE;
 out:
+    stats_method_phase (context, STATS_PHASE_SUBPROCESS,
+                        g_get_monotonic_time () - start);
+    GS_PROBE3 (spawn__done, argv[0], ret, g_get_monotonic_time () - start);
     return ret;
 }
 
@@ -25,6 +25,9 @@ void sys_log (GDBusMethodInvocation *context,
 
 gboolean get_caller_uid (GDBusMethodInvocation *context, gint *uid);
 
+void     set_helper_dir  (const gchar *dir);
+const gchar *get_helper_path (const gchar *name);
+
 gboolean spawn_with_login_uid (GDBusMethodInvocation  *context,
                                const gchar            *argv[],
                                GError                **error);
@@ -0,0 +1,120 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <glib.h>
+
+#include "gid-map.h"
+
+/* GID_PAGE_BITS in gid-map.c; the cases below straddle its pages */
+#define PAGE 4096
+
+static void test_empty (void)
+{
+    GidMap *map = gid_map_new ();
+    gid_t gid = 0;
+
+    g_assert_true (gid_map_find_free (map, 1000, 60000, &gid));
+    g_assert_cmpuint (gid, ==, 1000);
+    g_assert_cmpuint (gid_map_size (map), ==, 0);
+    gid_map_free (map);
+}
+
+/* The rest of a page is taken, the next page does not exist yet */
+static void test_cross_into_missing_page (void)
+{
+    GidMap *map = gid_map_new ();
+    gid_t gid = 0;
+    guint i;
+
+    for (i = PAGE - 10; i < PAGE; i++)
+    {
+        gid_map_set (map, i);
+    }
+    g_assert_true (gid_map_find_free (map, PAGE - 10, 3 * PAGE, &gid));
+    g_assert_cmpuint (gid, ==, PAGE);
+    gid_map_free (map);
+}
+
+/* A full page is skipped by its count and the search goes on into the
+ * partly used page after it */
+static void test_skip_full_page (void)
+{
+    GidMap *map = gid_map_new ();
+    gid_t gid = 0;
+    guint i;
+
+    for (i = PAGE; i < 2 * PAGE + 70; i++)
+    {
+        gid_map_set (map, i);
+    }
+    g_assert_cmpuint (gid_map_size (map), ==, PAGE + 70);
+    g_assert_true (gid_map_find_free (map, PAGE, 3 * PAGE, &gid));
+    g_assert_cmpuint (gid, ==, 2 * PAGE + 70);
+
+    /* Freeing the last bit of a page makes it the answer again */
+    gid_map_clear (map, 2 * PAGE - 1);
+    g_assert_true (gid_map_find_free (map, PAGE, 3 * PAGE, &gid));
+    g_assert_cmpuint (gid, ==, 2 * PAGE - 1);
+    gid_map_free (map);
+}
+
+/* The free gid is past last, in the next page */
+static void test_range_end (void)
+{
+    GidMap *map = gid_map_new ();
+    gid_t gid = 0;
+    guint i;
+
+    for (i = PAGE - 64; i < PAGE; i++)
+    {
+        gid_map_set (map, i);
+    }
+    g_assert_false (gid_map_find_free (map, PAGE - 64, PAGE - 1, &gid));
+    g_assert_false (gid_map_find_free (map, PAGE - 64, PAGE - 20, &gid));
+    g_assert_true (gid_map_find_free (map, PAGE - 64, PAGE, &gid));
+    g_assert_cmpuint (gid, ==, PAGE);
+    gid_map_free (map);
+}
+
+/* Emptying a page drops it, and the top of the gid space does not wrap */
+static void test_clear_and_top (void)
+{
+    GidMap *map = gid_map_new ();
+    gid_t gid = 0;
+
+    gid_map_set (map, PAGE + 5);
+    g_assert_true (gid_map_test (map, PAGE + 5));
+    gid_map_clear (map, PAGE + 5);
+    g_assert_false (gid_map_test (map, PAGE + 5));
+    g_assert_cmpuint (gid_map_size (map), ==, 0);
+
+    gid_map_set (map, G_MAXUINT32);
+    g_assert_false (gid_map_find_free (map, G_MAXUINT32, G_MAXUINT32, &gid));
+    g_assert_true (gid_map_find_free (map, G_MAXUINT32 - 1, G_MAXUINT32, &gid));
+    g_assert_cmpuint (gid, ==, G_MAXUINT32 - 1);
+    gid_map_free (map);
+}
+
+int main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/gid-map/empty", test_empty);
+    g_test_add_func ("/gid-map/cross-into-missing-page", test_cross_into_missing_page);
+    g_test_add_func ("/gid-map/skip-full-page", test_skip_full_page);
+    g_test_add_func ("/gid-map/range-end", test_range_end);
+    g_test_add_func ("/gid-map/clear-and-top", test_clear_and_top);
+
+    return g_test_run ();
+}
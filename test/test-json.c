@@ -0,0 +1,134 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "json-variant.h"
+
+/* JSON_MAX_DEPTH in json-variant.c */
+#define MAX_DEPTH 32
+
+static GVariant *parse (const gchar *text, GError **error)
+{
+    return json_variant_parse (text, strlen (text), error);
+}
+
+static void assert_invalid (const gchar *text)
+{
+    g_autoptr(GError) error = NULL;
+    GVariant *value;
+
+    value = parse (text, &error);
+    g_assert_null (value);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+}
+
+static void test_object (void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) value = NULL;
+    const gchar *name = NULL;
+    gint64 gid = 0;
+
+    value = parse ("{ \"name\": \"wheel\", \"gid\": 10, \"gone\": null }", &error);
+    g_assert_no_error (error);
+    g_assert_true (g_variant_is_of_type (value, G_VARIANT_TYPE_VARDICT));
+    g_assert_true (g_variant_lookup (value, "name", "&s", &name));
+    g_assert_cmpstr (name, ==, "wheel");
+    g_assert_true (g_variant_lookup (value, "gid", "x", &gid));
+    g_assert_cmpint (gid, ==, 10);
+    g_assert_false (g_variant_lookup (value, "gone", "v", NULL));
+}
+
+static void test_unterminated_string (void)
+{
+    assert_invalid ("\"wheel");
+    assert_invalid ("{\"name\": \"wheel}");
+    assert_invalid ("\"trailing backslash\\");
+    assert_invalid ("\"\\u00");
+}
+
+static void test_surrogates (void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) value = NULL;
+
+    /* U+1F600 as a pair, and U+00E9 as a single unit */
+    value = parse ("\"\\ud83d\\ude00 caf\\u00e9\"", &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (g_variant_get_string (value, NULL), ==, "\xf0\x9f\x98\x80 caf\xc3\xa9");
+
+    assert_invalid ("\"\\ud83d\"");
+    assert_invalid ("\"\\ud83dx\"");
+    assert_invalid ("\"\\ud83d\\u0041\"");
+    assert_invalid ("\"\\ude00\"");
+    assert_invalid ("\"\\u0000\"");
+    assert_invalid ("\"\\uzzzz\"");
+}
+
+static gchar *nested_arrays (guint depth)
+{
+    GString *text = g_string_new (NULL);
+    guint i;
+
+    for (i = 0; i < depth; i++)
+    {
+        g_string_append_c (text, '[');
+    }
+    for (i = 0; i < depth; i++)
+    {
+        g_string_append_c (text, ']');
+    }
+
+    return g_string_free (text, FALSE);
+}
+
+/* The outermost value is depth 0, so MAX_DEPTH + 1 arrays still parse */
+static void test_max_depth (void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) value = NULL;
+    g_autofree gchar *deepest = nested_arrays (MAX_DEPTH + 1);
+    g_autofree gchar *too_deep = nested_arrays (MAX_DEPTH + 2);
+    g_autofree gchar *hostile = nested_arrays (100000);
+
+    value = parse (deepest, &error);
+    g_assert_no_error (error);
+    g_assert_nonnull (value);
+
+    assert_invalid (too_deep);
+    assert_invalid (hostile);
+}
+
+static void test_trailing_data (void)
+{
+    assert_invalid ("{} {}");
+    assert_invalid ("[1,]");
+    assert_invalid ("");
+}
+
+int main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/json/object", test_object);
+    g_test_add_func ("/json/unterminated-string", test_unterminated_string);
+    g_test_add_func ("/json/surrogates", test_surrogates);
+    g_test_add_func ("/json/max-depth", test_max_depth);
+    g_test_add_func ("/json/trailing-data", test_trailing_data);
+
+    return g_test_run ();
+}
@@ -0,0 +1,333 @@
+/*  group-service
+*   Copyright (C) 2018  zhuyaliang https://github.com/zhuyaliang/
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "group-cache.h"
+#include "group-snapshot.h"
+#include "snapshot-file.h"
+#include "snapshot-reader.h"
+
+typedef struct
+{
+    NamePool      *names;
+    GroupSnapshot *groups;
+    GPtrArray     *records;
+    SnapshotFile  *file;
+    GsSnapshot     table;
+} Fixture;
+
+static void add_group (Fixture            *fixture,
+                       const gchar        *name,
+                       gid_t               gid,
+                       const gchar *const *members)
+{
+    g_ptr_array_add (fixture->records,
+                     (gpointer) group_snapshot_add (fixture->groups, name, gid, FALSE, members));
+}
+
+/* Added out of order, with two groups sharing a gid, a group without
+ * members and a primary group whose only member is the stand-in */
+static void fixture_set_up (Fixture *fixture, gconstpointer data)
+{
+    const gchar *const alpha_members[] = { "carol", "erin", NULL };
+    const gchar *const beta_members[] = { "dave", NULL };
+    const gchar *const gamma_members[] = { "carol", NULL };
+    struct group grent = { (gchar *) "frank", NULL, 1000, NULL };
+    const gchar *const *sources = data;
+    g_autoptr(GVariant) stamps = NULL;
+    g_autoptr(GError) error = NULL;
+
+    fixture->names = name_pool_new ();
+    fixture->groups = group_snapshot_new (fixture->names);
+    fixture->records = g_ptr_array_new ();
+    add_group (fixture, "gamma", 200, gamma_members);
+    add_group (fixture, "beta", 100, beta_members);
+    add_group (fixture, "alpha", 100, alpha_members);
+    add_group (fixture, "empty", 300, NULL);
+    g_ptr_array_add (fixture->records,
+                     (gpointer) group_snapshot_add_grent (fixture->groups, &grent, "frank"));
+
+    if (sources != NULL)
+    {
+        stamps = g_variant_ref_sink (group_cache_stamp (sources));
+    }
+    fixture->file = snapshot_file_new (fixture->records, fixture->names, 7,
+                                       sources, stamps, &error);
+    g_assert_no_error (error);
+    g_assert_cmpint (gs_snapshot_map (snapshot_file_get_fd (fixture->file), &fixture->table), ==, 0);
+}
+
+static void fixture_tear_down (Fixture *fixture, gconstpointer data)
+{
+    gs_snapshot_unmap (&fixture->table);
+    snapshot_file_free (fixture->file);
+    g_ptr_array_free (fixture->records, TRUE);
+    group_snapshot_unref (fixture->groups);
+    name_pool_free (fixture->names);
+}
+
+static void test_round_trip (Fixture *fixture, gconstpointer data)
+{
+    const GsSnapshot *table = &fixture->table;
+    const GsSnapshotGroup *group;
+    const gchar *const names[] = { "alpha", "beta", "gamma", "empty", "frank" };
+    guint i;
+
+    g_assert_cmpuint (table->header->n_groups, ==, 5);
+    g_assert_cmpuint (table->header->generation, ==, 7);
+    g_assert_true (gs_snapshot_is_current (table));
+    g_assert_null (gs_snapshot_find_name (table, "delta"));
+
+    /* Sorted by gid, then name */
+    for (i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+        group = gs_snapshot_get_group (table, i);
+        g_assert_nonnull (group);
+        g_assert_cmpstr (gs_snapshot_group_name (table, group), ==, names[i]);
+        g_assert_true (gs_snapshot_find_name (table, names[i]) == group);
+    }
+    g_assert_null (gs_snapshot_get_group (table, G_N_ELEMENTS (names)));
+
+    group = gs_snapshot_find_name (table, "alpha");
+    g_assert_nonnull (group);
+    g_assert_cmpstr (gs_snapshot_group_name (table, group), ==, "alpha");
+    g_assert_cmpuint (group->gid, ==, 100);
+    g_assert_cmpuint (group->n_members, ==, 2);
+    g_assert_cmpstr (gs_snapshot_group_member (table, group, 0), ==, "carol");
+    g_assert_cmpstr (gs_snapshot_group_member (table, group, 1), ==, "erin");
+    g_assert_null (gs_snapshot_group_member (table, group, 2));
+
+    group = gs_snapshot_find_gid (table, 200);
+    g_assert_nonnull (group);
+    g_assert_cmpstr (gs_snapshot_group_name (table, group), ==, "gamma");
+    g_assert_true (gs_snapshot_find_name (table, "gamma") == group);
+    g_assert_cmpuint (group->n_members, ==, 1);
+    g_assert_null (gs_snapshot_find_gid (table, 150));
+    g_assert_null (gs_snapshot_find_gid (table, 5000));
+}
+
+/* getgrgid sees the first group by name */
+static void test_duplicate_gids (Fixture *fixture, gconstpointer data)
+{
+    const GsSnapshot *table = &fixture->table;
+    const GsSnapshotGroup *beta;
+
+    g_assert_cmpstr (gs_snapshot_group_name (table, gs_snapshot_find_gid (table, 100)), ==, "alpha");
+    beta = gs_snapshot_find_name (table, "beta");
+    g_assert_nonnull (beta);
+    g_assert_cmpuint (beta->gid, ==, 100);
+    g_assert_cmpuint (beta->n_members, ==, 1);
+    g_assert_cmpstr (gs_snapshot_group_member (table, beta, 0), ==, "dave");
+}
+
+/* Neither an empty list nor the primary user standing in for one gives
+ * the group members, or the stand-in a group */
+static void test_empty_members (Fixture *fixture, gconstpointer data)
+{
+    const GsSnapshot *table = &fixture->table;
+    const GsSnapshotGroup *group;
+
+    group = gs_snapshot_find_name (table, "empty");
+    g_assert_nonnull (group);
+    g_assert_true (gs_snapshot_find_gid (table, 300) == group);
+    g_assert_cmpuint (group->n_members, ==, 0);
+    g_assert_null (gs_snapshot_group_member (table, group, 0));
+
+    group = gs_snapshot_find_gid (table, 1000);
+    g_assert_nonnull (group);
+    g_assert_cmpstr (gs_snapshot_group_name (table, group), ==, "frank");
+    g_assert_cmpuint (group->flags & GS_SNAPSHOT_GROUP_PRIMARY, !=, 0);
+    g_assert_cmpuint (group->n_members, ==, 0);
+    g_assert_null (gs_snapshot_find_user (table, "frank"));
+}
+
+static void test_reverse_membership (Fixture *fixture, gconstpointer data)
+{
+    const GsSnapshot *table = &fixture->table;
+    const GsSnapshotUser *user;
+
+    g_assert_cmpuint (table->header->n_users, ==, 3);
+    user = gs_snapshot_find_user (table, "carol");
+    g_assert_nonnull (user);
+    g_assert_cmpuint (user->n_groups, ==, 2);
+    g_assert_cmpuint (gs_snapshot_user_group (table, user, 0)->gid, ==, 100);
+    g_assert_cmpuint (gs_snapshot_user_group (table, user, 1)->gid, ==, 200);
+    g_assert_null (gs_snapshot_user_group (table, user, 2));
+    g_assert_null (gs_snapshot_find_user (table, "mallory"));
+}
+
+static void test_retire (Fixture *fixture, gconstpointer data)
+{
+    const GsSnapshot *table = &fixture->table;
+
+    snapshot_file_retire (fixture->file, 8);
+    if ((table->header->flags & GS_SNAPSHOT_FLAG_STATIC) == 0)
+    {
+        g_assert_false (gs_snapshot_is_current (table));
+    }
+    else
+    {
+        g_assert_true (gs_snapshot_is_current (table));
+    }
+}
+
+/* Writes data to a file and maps it the way a client would */
+static gint map_bytes (const guint8 *data, gsize size)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *path = NULL;
+    GsSnapshot table;
+    gint fd, ret;
+
+    fd = g_file_open_tmp ("test-snapshot-XXXXXX", &path, &error);
+    g_assert_no_error (error);
+    close (fd);
+    g_file_set_contents (path, (const gchar *) data, size, &error);
+    g_assert_no_error (error);
+
+    fd = open (path, O_RDONLY | O_CLOEXEC);
+    g_assert_cmpint (fd, >=, 0);
+    ret = gs_snapshot_map (fd, &table);
+    close (fd);
+    g_unlink (path);
+    if (ret == 0)
+    {
+        gs_snapshot_unmap (&table);
+    }
+
+    return ret;
+}
+
+static void test_corrupt (Fixture *fixture, gconstpointer data)
+{
+    gsize size = fixture->table.size;
+    g_autofree guint8 *copy = g_new (guint8, size);
+    GsSnapshotHeader *header = (GsSnapshotHeader *) copy;
+
+    memcpy (copy, fixture->table.base, size);
+    g_assert_cmpint (map_bytes (copy, size), ==, 0);
+
+    g_assert_cmpint (map_bytes (copy, 0), ==, -EBADMSG);
+    g_assert_cmpint (map_bytes (copy, sizeof (GsSnapshotHeader) - 1), ==, -EBADMSG);
+    g_assert_cmpint (map_bytes (copy, size / 2), ==, -EBADMSG);
+
+    header->magic ^= 1;
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->version++;
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->n_buckets = 3;      /* not a power of two */
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->n_buckets = 4;      /* no empty slot for five groups */
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->groups_offset = 0;
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->members_offset++;   /* misaligned */
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->n_members = G_MAXUINT32 / 2;
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->n_users = G_MAXUINT32 / 2;
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    memcpy (copy, fixture->table.base, size);
+    header->strings_offset = header->size;
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+
+    /* The strings are last, so this is the final NUL */
+    memcpy (copy, fixture->table.base, size);
+    copy[size - 1] = 'x';
+    g_assert_cmpint (map_bytes (copy, size), ==, -EBADMSG);
+}
+
+static void test_no_sources (Fixture *fixture, gconstpointer data)
+{
+    g_assert_false (gs_snapshot_sources_current (&fixture->table));
+}
+
+/* The table only stands for the files as they were stamped */
+static void test_sources (void)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *dir = NULL;
+    g_autofree gchar *group = NULL;
+    g_autofree gchar *passwd = NULL;
+    const gchar *sources[3];
+    Fixture fixture;
+
+    dir = g_dir_make_tmp ("test-snapshot-XXXXXX", &error);
+    g_assert_no_error (error);
+    group = g_build_filename (dir, "group", NULL);
+    passwd = g_build_filename (dir, "passwd", NULL);
+    g_file_set_contents (group, "alpha:x:100:carol,erin\n", -1, &error);
+    g_assert_no_error (error);
+    g_file_set_contents (passwd, "carol:x:1001:1001::/home/carol:/bin/sh\n", -1, &error);
+    g_assert_no_error (error);
+    sources[0] = group;
+    sources[1] = passwd;
+    sources[2] = NULL;
+
+    fixture_set_up (&fixture, sources);
+    g_assert_true (gs_snapshot_sources_current (&fixture.table));
+
+    g_file_set_contents (group, "alpha:x:100:carol\n", -1, &error);
+    g_assert_no_error (error);
+    g_assert_false (gs_snapshot_sources_current (&fixture.table));
+
+    g_unlink (group);
+    g_assert_false (gs_snapshot_sources_current (&fixture.table));
+    fixture_tear_down (&fixture, sources);
+
+    g_unlink (passwd);
+    g_rmdir (dir);
+}
+
+int main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+#define ADD(path, func) \
+    g_test_add (path, Fixture, NULL, fixture_set_up, func, fixture_tear_down)
+
+    ADD ("/snapshot/round-trip", test_round_trip);
+    ADD ("/snapshot/duplicate-gids", test_duplicate_gids);
+    ADD ("/snapshot/empty-members", test_empty_members);
+    ADD ("/snapshot/reverse-membership", test_reverse_membership);
+    ADD ("/snapshot/retire", test_retire);
+    ADD ("/snapshot/corrupt", test_corrupt);
+    ADD ("/snapshot/no-sources", test_no_sources);
+    g_test_add_func ("/snapshot/sources", test_sources);
+
+#undef ADD
+
+    return g_test_run ();
+}